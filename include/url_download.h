@@ -63,6 +63,8 @@ typedef enum
 	URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS = TIZEN_ERROR_WEB_CLASS | 0x26, /**< Full of available downloading items */
 	URL_DOWNLOAD_ERROR_ALREADY_COMPLETED = TIZEN_ERROR_WEB_CLASS | 0x27, /**< The download is already completed */
 	URL_DOWNLOAD_ERROR_NO_DATA = TIZEN_ERROR_NO_DATA, /**< No data */
+	URL_DOWNLOAD_ERROR_DIGEST_MISMATCH = TIZEN_ERROR_WEB_CLASS | 0x28, /**< The digest of the file is not the expected one */
+	URL_DOWNLOAD_ERROR_INVALID_ARCHIVE = TIZEN_ERROR_WEB_CLASS | 0x29, /**< The archive to extract is invalid or truncated */
 } url_download_error_e;
 
 
@@ -76,9 +78,55 @@ typedef enum
 	URL_DOWNLOAD_STATE_PAUSED, /**< The download is waiting to resume or stop */
 	URL_DOWNLOAD_STATE_COMPLETED, /**< The download is completed. */
 	URL_DOWNLOAD_STATE_FAILED, /**< The download failed. */
+	URL_DOWNLOAD_STATE_QUEUED, /**< The download is waiting for the scheduler to start it. */
 } url_download_state_e;
 
 
+/**
+ * @brief Enumerations of the order in which the waiting downloads are started.
+ */
+typedef enum
+{
+	URL_DOWNLOAD_SCHEDULING_FIFO, /**< In the order they were started, round-robin across the hosts */
+	URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST, /**< The download with the fewest remaining bytes first */
+} url_download_scheduling_policy_e;
+
+
+/**
+ * @brief Enumerations of the backend transferring the content.
+ */
+typedef enum
+{
+	URL_DOWNLOAD_BACKEND_PROVIDER, /**< The download-provider daemon (default) */
+	URL_DOWNLOAD_BACKEND_IN_PROCESS, /**< The HTTP engine running in the process of the application */
+	URL_DOWNLOAD_BACKEND_AUTO, /**< The download-provider daemon if it is available, otherwise the HTTP engine */
+} url_download_backend_e;
+
+
+/**
+ * @brief Enumerations of the digest algorithms verifying the downloaded file.
+ */
+typedef enum
+{
+	URL_DOWNLOAD_DIGEST_NONE, /**< No digest (default) */
+	URL_DOWNLOAD_DIGEST_SHA256, /**< SHA-256 */
+	URL_DOWNLOAD_DIGEST_SHA1, /**< SHA-1 */
+	URL_DOWNLOAD_DIGEST_CRC32C, /**< CRC-32C (Castagnoli), as a big endian value */
+	URL_DOWNLOAD_DIGEST_XXH64, /**< xxHash XXH64 with the seed 0, as a big endian value */
+} url_download_digest_e;
+
+
+/**
+ * @brief Enumerations of the destinations of the downloaded content.
+ */
+typedef enum
+{
+	URL_DOWNLOAD_DESTINATION_FILE, /**< A file in the destination directory (default) */
+	URL_DOWNLOAD_DESTINATION_MEMORY, /**< A buffer of the library, see url_download_get_memory() */
+	URL_DOWNLOAD_DESTINATION_MEMFD, /**< An anonymous file in memory, see url_download_get_memory_fd() */
+} url_download_destination_type_e;
+
+
 /**
  * @brief Called when the download is started.
  *
@@ -112,7 +160,7 @@ typedef void (*url_download_paused_cb) (url_download_h download, void *user_data
  * @brief Called when the download is completed.
  *
  * @param [in] download The download handle
- * @param [in] installed_path The absolute path to the downloaded file
+ * @param [in] installed_path The absolute path to the downloaded file, NULL if the content is in memory (see url_download_set_destination_type())
  * @param [in] user_data The user data passed from url_download_set_completed_cb()
  * @pre This callback function will be invoked when the download is completed if you register this callback using url_download_set_paused_cb()
  * @see url_download_set_completed_cb()
@@ -154,6 +202,23 @@ typedef void (*url_download_stopped_cb) (url_download_h download, url_download_e
 typedef void (*url_download_progress_cb) (url_download_h download, unsigned long long received, unsigned long long total, void *user_data);
 
 
+/**
+ * @brief Called when a file of the archive is extracted.
+ *
+ * @remarks This callback function is only invoked in the downloading state, before url_download_completed_cb(). \n
+ * The @a path must not be deallocated by an application.
+ * @param [in] download The download handle
+ * @param [in] path The absolute path of the file extracted under the destination
+ * @param [in] size The size of the file in bytes
+ * @param [in] user_data The user data passed from url_download_set_extracted_cb()
+ * @pre This callback function is invoked if you register this callback using url_download_set_extracted_cb().
+ * @see url_download_set_archive_extraction()
+ * @see url_download_set_extracted_cb()
+ * @see url_download_unset_extracted_cb()
+ */
+typedef void (*url_download_extracted_cb) (url_download_h download, const char *path, unsigned long long size, void *user_data);
+
+
 /**
 * @brief Called to retrieve the HTTP header field to be included with the download
 *
@@ -168,6 +233,29 @@ typedef void (*url_download_progress_cb) (url_download_h download, unsigned long
 typedef bool (*url_download_http_header_field_cb)(url_download_h download, const char *field, void *user_data);
 
 
+/**
+ * @brief Called with the metadata of a remote file when its probe is done.
+ *
+ * @remarks The strings must not be deallocated by an application, they are valid only in the callback.
+ *
+ * A string is NULL if the server did not send it.
+ * @param [in] download The download handle
+ * @param [in] url The URL probed
+ * @param [in] error The error code, #URL_DOWNLOAD_ERROR_NONE if the metadata were received
+ * @param [in] content_length The size of the file in bytes, -1 if it is unknown
+ * @param [in] mime_type The MIME type
+ * @param [in] etag The entity tag (ETag)
+ * @param [in] last_modified The date of the last modification (Last-Modified)
+ * @param [in] accept_ranges @c true if the server supports the byte ranges
+ * @param [in] user_data The user data passed from url_download_probe()
+ * @pre url_download_probe() will invoke this callback.
+ * @see url_download_probe()
+ */
+typedef void (*url_download_probed_cb) (url_download_h download, const char *url, url_download_error_e error,
+	long long content_length, const char *mime_type, const char *etag, const char *last_modified,
+	bool accept_ranges, void *user_data);
+
+
 /**
  * @brief Creates a download handle.
  *
@@ -180,6 +268,7 @@ typedef bool (*url_download_http_header_field_cb)(url_download_h download, const
  * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
  * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
  * @retval #URL_DOWNLOAD_ERROR_IO_ERROR Internal I/O error
+ * @retval #URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS Too many handles, up to 1024 handles can exist at the same time
  * @post The download state will be #URL_DOWNLOAD_STATE_READY
  * @see url_download_destroy()
  */
@@ -630,12 +719,55 @@ int url_download_set_progress_cb(url_download_h download, url_download_progress_
 int url_download_unset_progress_cb(url_download_h download);
 
 
+/**
+ * @brief Registers a callback function to be invoked when a file of the archive is extracted
+ *
+ * @remarks This function should be called before downloading (see url_download_start())
+ * @param [in] download The download handle
+ * @param [in] callback The callback function to register
+ * @param [in] user_data The user data to be passed to the callback function
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @post url_download_extracted_cb() will be invoked.
+ * @see url_download_unset_extracted_cb()
+ * @see url_download_extracted_cb()
+ * @see url_download_set_archive_extraction()
+*/
+int url_download_set_extracted_cb(url_download_h download, url_download_extracted_cb callback, void *user_data);
+
+
+/**
+ * @brief Unregisters the callback function.
+ *
+ * @remarks This function should be called before downloading (see url_download_start())
+ * @param [in] download The download handle
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_set_extracted_cb()
+ * @see url_download_extracted_cb()
+*/
+int url_download_unset_extracted_cb(url_download_h download);
+
+
 /**
  * @brief Starts or resumes the download, asynchronously.
  *
  * @details This function starts to download the current URL, or resumes the download if paused.
  *
- * @remarks The URL is the mandatory information to start the download.
+ * @remarks The URL is the mandatory information to start the download. \n
+ * If the limits set by url_download_set_max_active_downloads() or url_download_set_max_downloads_per_host() are reached,
+ * the download is queued with #URL_DOWNLOAD_STATE_QUEUED and it is started later. Then @a id is not assigned yet. \n
+ * The file:// and data: URLs are copied by the library itself, whatever the backend set by url_download_set_backend(). \n
+ * The space of the file is reserved on the file system of the destination when its size is known, from the size expected
+ * by url_download_set_expected_size() or else from the response. The download fails with #URL_DOWNLOAD_ERROR_NO_SPACE
+ * if the file system cannot hold it, and it is queued while the space is reserved by the other downloads. \n
+ * The in-process backend allocates the blocks of the file before writing it.
  * @param [in] download The download handle
  * @param [out] id The identifier for the download unique within the application.
  * @return 0 on success, otherwise a negative error value.
@@ -646,6 +778,8 @@ int url_download_unset_progress_cb(url_download_h download);
  * @retval #URL_DOWNLOAD_ERROR_IO_ERROR Internal I/O error
  * @retval #URL_DOWNLOAD_ERROR_URL Invalid URL
  * @retval #URL_DOWNLOAD_ERROR_DESTINATION Invalid destination
+ * @retval #URL_DOWNLOAD_ERROR_NO_SPACE No space left on device
+ * @retval #URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS Too many downloads running at the same time
  * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_PAUSED or #URL_DOWNLOAD_STATE_COMPLETED.
  * @post The download state will be #URL_DOWNLOAD_STATE_DOWNLOADING
  * @see url_download_set_url()
@@ -691,7 +825,7 @@ int url_download_pause(url_download_h download);
  * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
  * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
  * @retval #URL_DOWNLOAD_ERROR_IO_ERROR Internal I/O error
- * @pre The download state must be #URL_DOWNLOAD_STATE_DOWNLOADING.
+ * @pre The download state must be #URL_DOWNLOAD_STATE_DOWNLOADING, #URL_DOWNLOAD_STATE_PAUSED or #URL_DOWNLOAD_STATE_QUEUED.
  * @post url_download_stopped_cb() will be invoked if it is registered with url_download_set_stopped_cb()
  * @post The download state will be #URL_DOWNLOAD_STATE_READY.
  * @see url_download_start()
@@ -730,6 +864,854 @@ int url_download_get_state(url_download_h download, url_download_state_e *state)
  */
 int url_download_foreach_http_header_field(url_download_h download, url_download_http_header_field_cb callback, void *user_data);
 
+
+/**
+ * @brief Sets the maximum transfer rate of the download.
+ *
+ * @details The rate is enforced with a token bucket which allows a burst of one second worth of data.
+ * When the download gets ahead of its budget, it is paused internally and resumed when the budget is refilled. \n
+ * The internal pause does not change the state of the download and does not invoke url_download_paused_cb().
+ * @param [in] download The download handle
+ * @param [in] bytes_per_sec The maximum rate in bytes per second, not greater than LLONG_MAX \n
+ *  If the @a bytes_per_sec is 0, the download is not limited.
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_rate_limit()
+ * @see url_download_set_global_rate_limit()
+ */
+int url_download_set_rate_limit(url_download_h download, unsigned long long bytes_per_sec);
+
+
+/**
+ * @brief Gets the maximum transfer rate of the download.
+ *
+ * @param [in] download The download handle
+ * @param [out] bytes_per_sec The maximum rate in bytes per second, 0 if the download is not limited
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_rate_limit()
+ */
+int url_download_get_rate_limit(url_download_h download, unsigned long long *bytes_per_sec);
+
+
+/**
+ * @brief Sets the maximum transfer rate shared by all downloads of the application.
+ *
+ * @details All running downloads consume the same budget, in addition to their own limit set by url_download_set_rate_limit().
+ * @param [in] bytes_per_sec The maximum aggregate rate in bytes per second, not greater than LLONG_MAX \n
+ *  If the @a bytes_per_sec is 0, the aggregate rate is not limited.
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_get_global_rate_limit()
+ * @see url_download_set_rate_limit()
+ */
+int url_download_set_global_rate_limit(unsigned long long bytes_per_sec);
+
+
+/**
+ * @brief Gets the maximum transfer rate shared by all downloads of the application.
+ *
+ * @param [out] bytes_per_sec The maximum aggregate rate in bytes per second, 0 if it is not limited
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_global_rate_limit()
+ */
+int url_download_get_global_rate_limit(unsigned long long *bytes_per_sec);
+
+
+/**
+ * @brief Sets the maximum number of downloads running at the same time in the application.
+ *
+ * @details The downloads started beyond the limit are queued with #URL_DOWNLOAD_STATE_QUEUED.
+ * When a running download finishes, the queued downloads are started round-robin across their hosts.
+ * @param [in] count The maximum number of running downloads \n
+ *  If the @a count is 0, the number is not limited.
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_get_max_active_downloads()
+ * @see url_download_set_max_downloads_per_host()
+ */
+int url_download_set_max_active_downloads(int count);
+
+
+/**
+ * @brief Gets the maximum number of downloads running at the same time in the application.
+ *
+ * @param [out] count The maximum number of running downloads, 0 if it is not limited
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_max_active_downloads()
+ */
+int url_download_get_max_active_downloads(int *count);
+
+
+/**
+ * @brief Sets the maximum number of downloads running at the same time from one host.
+ *
+ * @details The host is taken from the URL of the download. The downloads started beyond the limit are queued with #URL_DOWNLOAD_STATE_QUEUED,
+ * so the downloads from a host with a long backlog do not hold back the downloads from the other hosts. \n
+ * A queued download holds no connection, the application can queue hundreds of them.
+ * @param [in] count The maximum number of running downloads per host \n
+ *  If the @a count is 0, the number is not limited.
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_get_max_downloads_per_host()
+ * @see url_download_set_max_active_downloads()
+ */
+int url_download_set_max_downloads_per_host(int count);
+
+
+/**
+ * @brief Gets the maximum number of downloads running at the same time from one host.
+ *
+ * @param [out] count The maximum number of running downloads per host, 0 if it is not limited
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_max_downloads_per_host()
+ */
+int url_download_get_max_downloads_per_host(int *count);
+
+
+/**
+ * @brief Enables or disables the adaptive limit of the downloads running at the same time.
+ *
+ * @details When enabled, the aggregate throughput of the running downloads is sampled from their progress
+ * and the number of running downloads is raised while it increases the throughput, and lowered when it does not. \n
+ * The limit set by url_download_set_max_active_downloads() is used as the upper bound, 64 downloads if it is 0.
+ * @param [in] enable @c true to enable the adaptive limit, \n @c false to use the fixed limit
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @see url_download_get_adaptive_concurrency()
+ * @see url_download_set_max_active_downloads()
+ */
+int url_download_set_adaptive_concurrency(bool enable);
+
+
+/**
+ * @brief Gets whether the adaptive limit is enabled and the limit currently in effect.
+ *
+ * @param [out] enable @c true if the adaptive limit is enabled
+ * @param [out] count The maximum number of running downloads in effect, 0 if it is not limited
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_adaptive_concurrency()
+ */
+int url_download_get_adaptive_concurrency(bool *enable, int *count);
+
+
+/**
+ * @brief Enables or disables the coalescing of identical downloads.
+ *
+ * @details When enabled, url_download_start() does not create a new transfer for a download which has the same URL,
+ * destination, file name and HTTP header fields as a download in progress. The download is attached to the transfer in progress
+ * and its callbacks are invoked with the events of that transfer. \n
+ * url_download_pause() and url_download_start() on an attached download apply to the shared transfer.
+ * url_download_stop() detaches the download only, the transfer goes on for the other downloads attached to it.
+ * @remarks If the transfer has already started, url_download_started_cb() of the attached download is invoked from url_download_start().
+ * @param [in] enable @c true to coalesce identical downloads, \n @c false to start a transfer for each download
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @see url_download_get_coalescing()
+ */
+int url_download_set_coalescing(bool enable);
+
+
+/**
+ * @brief Gets whether identical downloads are coalesced.
+ *
+ * @param [out] enable @c true if identical downloads are coalesced
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_coalescing()
+ */
+int url_download_get_coalescing(bool *enable);
+
+
+/**
+ * @brief Sets the directory of the content store shared by the downloads.
+ *
+ * @details The files downloaded by the in-process backend are added to the content store when they complete,
+ * under their digest (see url_download_set_expected_digest(), SHA-256 if no digest is set) and under their URL and strong ETag. \n
+ * url_download_start() of a download whose expected digest is in the store completes without transfer.
+ * A download whose response has the URL and the ETag of a file in the store completes without receiving the body. \n
+ * The file is then a copy of the blocks of the stored file if the file system supports it, else a hard link to the stored file,
+ * else a copy.
+ * @remarks The store is used by the downloads run by the in-process backend only (see url_download_set_backend()),
+ * setting it does not move the other downloads out of download-provider. \n
+ * The files added to the store or linked from it are read-only. Removing a file of the store does not affect the downloaded files. \n
+ * The files are shared only if the store is on the same file system as the destinations, they are copied otherwise.
+ * @param [in] directory The absolute path of the directory of the store, created if it does not exist, @c NULL to disable the store
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_DESTINATION The directory is not writable
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @see url_download_get_content_store()
+ */
+int url_download_set_content_store(const char *directory);
+
+
+/**
+ * @brief Gets the directory of the content store.
+ *
+ * @remarks The @a directory must be released with free() by you.
+ * @param [out] directory The absolute path of the directory of the store
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_NO_DATA The content store is not set
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @see url_download_set_content_store()
+ */
+int url_download_get_content_store(char **directory);
+
+
+/**
+ * @brief Sets the file of the revalidation index shared by the downloads.
+ *
+ * @details The ETag and the Last-Modified date of the files downloaded by the in-process backend are kept in the index,
+ * for each URL and destination. \n
+ * url_download_start() of a download whose URL and destination are in the index asks the server for the file
+ * with the If-None-Match and If-Modified-Since header fields. If the server answers that the file was not modified,
+ * the download completes with the file of the previous download, without transfer, and url_download_is_not_modified()
+ * gives @c true.
+ * @remarks The index is used by the downloads run by the in-process backend only (see url_download_set_backend()),
+ * setting it does not move the other downloads out of download-provider. \n
+ * A file which was changed or removed since its download is downloaded again. \n
+ * The downloads of a range, with an expected digest, or with a file name different from the one of the previous download
+ * are not revalidated. \n
+ * The index keeps the last 1024 files.
+ * @param [in] path The absolute path of the index file, @c NULL to disable the revalidation
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @see url_download_get_revalidation_index()
+ * @see url_download_is_not_modified()
+ */
+int url_download_set_revalidation_index(const char *path);
+
+
+/**
+ * @brief Gets the file of the revalidation index.
+ *
+ * @remarks The @a path must be released with free() by you.
+ * @param [out] path The absolute path of the index file
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_NO_DATA The revalidation index is not set
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @see url_download_set_revalidation_index()
+ */
+int url_download_get_revalidation_index(char **path);
+
+
+/**
+ * @brief Sets the order in which the waiting downloads are started.
+ *
+ * @details With #URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST, the download with the fewest remaining bytes is started first.
+ * The size of a download is the size set by url_download_set_expected_size(), or else the size reported by the last download of the same URL. \n
+ * The longer a download waits, the smaller it is considered: its remaining bytes count half after each 5 seconds of waiting.
+ * A download which waited 60 seconds is started before any shorter one, after the downloads which waited longer,
+ * so a large download is never postponed for more than about 60 seconds by shorter ones.
+ * @param [in] policy The scheduling policy, #URL_DOWNLOAD_SCHEDULING_FIFO by default
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_get_scheduling_policy()
+ * @see url_download_set_max_active_downloads()
+ */
+int url_download_set_scheduling_policy(url_download_scheduling_policy_e policy);
+
+
+/**
+ * @brief Gets the order in which the waiting downloads are started.
+ *
+ * @param [out] policy The scheduling policy
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_scheduling_policy()
+ */
+int url_download_get_scheduling_policy(url_download_scheduling_policy_e *policy);
+
+
+/**
+ * @brief Sets the expected size of the content to download.
+ *
+ * @details The size is used by #URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST to order the waiting downloads,
+ * for instance the size known from a previous HEAD request.
+ * @param [in] download The download handle
+ * @param [in] size The expected size in bytes, 0 if it is unknown
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_get_expected_size()
+ * @see url_download_set_scheduling_policy()
+ */
+int url_download_set_expected_size(url_download_h download, unsigned long long size);
+
+
+/**
+ * @brief Gets the expected size of the content to download.
+ *
+ * @param [in] download The download handle
+ * @param [out] size The expected size in bytes, 0 if it is unknown
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_expected_size()
+ */
+int url_download_get_expected_size(url_download_h download, unsigned long long *size);
+
+
+/**
+ * @brief Sets the backend transferring the content of the download.
+ *
+ * @details #URL_DOWNLOAD_BACKEND_IN_PROCESS downloads with an HTTP/1.1 engine running in a thread of the application,
+ * without the download-provider daemon. It supports the http and https schemes. \n
+ * The certificates of the https servers are verified with the certificate authorities of the system.
+ * The TLS sessions are kept per host for a few minutes, the next downloads from the same host resume them. \n
+ * The callbacks are invoked the same way with both backends.
+ * @remarks The notification set by url_download_set_notification() is not supported by the in-process backend.
+ * @param [in] download The download handle
+ * @param [in] backend The backend, #URL_DOWNLOAD_BACKEND_PROVIDER by default
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must not be #URL_DOWNLOAD_STATE_DOWNLOADING, #URL_DOWNLOAD_STATE_PAUSED or #URL_DOWNLOAD_STATE_QUEUED.
+ * @see url_download_get_backend()
+ */
+int url_download_set_backend(url_download_h download, url_download_backend_e backend);
+
+
+/**
+ * @brief Gets the backend transferring the content of the download.
+ *
+ * @param [in] download The download handle
+ * @param [out] backend The backend
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_backend()
+ */
+int url_download_get_backend(url_download_h download, url_download_backend_e *backend);
+
+
+/**
+ * @brief Sets the number of connections fetching the content of the download at the same time.
+ *
+ * @details When the server accepts byte ranges, the content is split into ranges fetched in parallel
+ * and written at their offset in the downloaded file. A connection which finishes its range early takes over
+ * a half of the largest remaining range. \n
+ * The content is not split into ranges smaller than 1 MB.
+ * @remarks It is supported by #URL_DOWNLOAD_BACKEND_IN_PROCESS only.
+ * @param [in] download The download handle
+ * @param [in] count The number of connections, up to 8, 0 or 1 for a single connection
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_segment_count()
+ * @see url_download_set_backend()
+ */
+int url_download_set_segment_count(url_download_h download, int count);
+
+
+/**
+ * @brief Gets the number of connections fetching the content of the download at the same time.
+ *
+ * @param [in] download The download handle
+ * @param [out] count The number of connections, 0 or 1 for a single connection
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_segment_count()
+ */
+int url_download_get_segment_count(url_download_h download, int *count);
+
+
+/**
+ * @brief Sets whether the coded content is decoded while it is downloaded.
+ *
+ * @details When it is enabled, the supported content codings (gzip and deflate, and zstd if the library is built
+ * with it) are advertised to the server, and a content sent with one of them is decoded to the downloaded file. \n
+ * The size of the decoded file is not known until the download is completed, the @a total of the progress
+ * callback is 0 meanwhile. url_download_get_wire_size() gives the progress of the coded content. \n
+ * A paused download with a coded content starts again from the beginning when it is resumed,
+ * and the content is not split into ranges.
+ * @remarks It is supported by #URL_DOWNLOAD_BACKEND_IN_PROCESS only.
+ * @param [in] download The download handle
+ * @param [in] enable @c true to decode the content, @c false to download it as it is sent (default)
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_content_decoding()
+ * @see url_download_get_wire_size()
+ */
+int url_download_set_content_decoding(url_download_h download, bool enable);
+
+
+/**
+ * @brief Gets whether the coded content is decoded while it is downloaded.
+ *
+ * @param [in] download The download handle
+ * @param [out] enable @c true if the content is decoded
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_content_decoding()
+ */
+int url_download_get_content_decoding(url_download_h download, bool *enable);
+
+
+/**
+ * @brief Gets the bytes of the content received from the network, before it is decoded.
+ *
+ * @details It can be called from url_download_progress_cb(), which reports the decoded bytes.
+ * With content decoding, they are the coded bytes of the response and its length, the response is received
+ * again from its beginning when the download is resumed. \n
+ * Without content decoding, they are the bytes reported by the progress callback, those of all the segments
+ * and of the resumed ranges, and the blocks copied by a delta download included.
+ * @param [in] download The download handle
+ * @param [out] received The bytes received
+ * @param [out] total The length of the content, 0 if it is unknown
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_content_decoding()
+ */
+int url_download_get_wire_size(url_download_h download, unsigned long long *received, unsigned long long *total);
+
+
+/**
+ * @brief Sets the byte range of the remote file to download.
+ *
+ * @details The bytes from @a offset, @a length of them, are downloaded. \n
+ * With a @a length of 0, the bytes from @a offset until the end of the file are downloaded. \n
+ * With a negative @a offset and a @a length of 0, the last -@a offset bytes of the file are downloaded. \n
+ * An @a offset and a @a length of 0 download the whole file (default). \n
+ * The file size and the progress are the ones of the range. A range past the end of the file is shortened,
+ * a range starting after the end fails with #URL_DOWNLOAD_ERROR_NO_DATA. When the server ignores the range,
+ * the bytes before it are received and dropped. \n
+ * The range is written at the beginning of a new file, or at its offset of the file with the same name
+ * with url_download_set_range_at_offset().
+ * @remarks The download is done by the in-process backend whatever the backend set.
+ * The range of a file:// or data: URL is not supported.
+ * @param [in] download The download handle
+ * @param [in] offset The offset of the first byte, negative for the last bytes of the file
+ * @param [in] length The number of bytes, 0 until the end of the file
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_range()
+ * @see url_download_set_range_at_offset()
+ */
+int url_download_set_range(url_download_h download, long long offset, long long length);
+
+
+/**
+ * @brief Gets the byte range of the remote file to download.
+ *
+ * @param [in] download The download handle
+ * @param [out] offset The offset of the first byte, negative for the last bytes of the file
+ * @param [out] length The number of bytes, 0 until the end of the file
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_range()
+ */
+int url_download_get_range(url_download_h download, long long *offset, long long *length);
+
+
+/**
+ * @brief Sets whether the range is written at its offset of the downloaded file.
+ *
+ * @details When it is enabled, the file with the name of the download in the destination is opened
+ * without being truncated, or created, and the range is written at its offset of the remote file.
+ * The other bytes of the file are kept. The file is not removed if the download fails or is stopped. \n
+ * Otherwise the range is written at the beginning of a new file (default).
+ * @param [in] download The download handle
+ * @param [in] enable @c true to write the range at its offset
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_set_range()
+ * @see url_download_set_file_name()
+ */
+int url_download_set_range_at_offset(url_download_h download, bool enable);
+
+
+/**
+ * @brief Gets whether the range is written at its offset of the downloaded file.
+ *
+ * @param [in] download The download handle
+ * @param [out] enable @c true if the range is written at its offset
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_range_at_offset()
+ */
+int url_download_get_range_at_offset(url_download_h download, bool *enable);
+
+
+/**
+ * @brief Requests the metadata of the file at the current URL, without downloading it.
+ *
+ * @details A HEAD request is sent with the HTTP header fields of the download, the redirections are followed.
+ * If the server refuses it, the first byte of the file is requested instead. The metadata are passed
+ * to @a callback. \n
+ * The probe is done by the in-process backend whatever the backend set, no download-provider job is created
+ * and the state of the download does not change. The size of the file is kept to order the next downloads
+ * (see url_download_set_scheduling_policy()).
+ * @remarks Several probes may be in progress at the same time, with the same handle and other URLs, up to 16. \n
+ * The callback is invoked from the thread of the in-process backend. The probes in progress are cancelled
+ * without callback when the handle is destroyed. \n
+ * The file:// and data: URLs are not supported. \n
+ * The host is resolved without blocking the caller, a host which cannot be resolved is reported to
+ * @a callback with #URL_DOWNLOAD_ERROR_NETWORK_UNREACHABLE.
+ * @param [in] download The download handle
+ * @param [in] callback The callback function to invoke with the metadata
+ * @param [in] user_data The user data to be passed to the callback function
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_URL Invalid URL
+ * @retval #URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS Too many probes in progress
+ * @see url_download_set_url()
+ * @see url_download_probed_cb()
+ */
+int url_download_probe(url_download_h download, url_download_probed_cb callback, void *user_data);
+
+
+/**
+ * @brief Sets the digest algorithm of the downloaded file and the expected digest.
+ *
+ * @details The digest is computed while the data is written, without reading the file again after the download
+ * when it is received in order. The bytes received out of order by the other connections of a segmented download
+ * (see url_download_set_segment_count()) are read from the file when the download completes. \n
+ * If @a expected is not NULL and the digest differs, the download fails with #URL_DOWNLOAD_ERROR_DIGEST_MISMATCH
+ * and the file is removed. Otherwise the digest is given by url_download_get_digest() once the download is completed.
+ * @remarks The download is done by the in-process backend whatever the backend set. \n
+ * The digest of a range (see url_download_set_range()) is the one of the bytes of the range. \n
+ * With the content decoding, the digest is the one of the decoded file.
+ * @param [in] download The download handle
+ * @param [in] type The digest algorithm, #URL_DOWNLOAD_DIGEST_NONE to disable the digest
+ * @param [in] expected The expected digest in hexadecimal, NULL to compute the digest only
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_digest()
+ */
+int url_download_set_expected_digest(url_download_h download, url_download_digest_e type, const char *expected);
+
+
+/**
+ * @brief Gets the digest of the downloaded file.
+ *
+ * @remarks The @a digest must be released with free() by you.
+ * @param [in] download The download handle
+ * @param [out] type The digest algorithm
+ * @param [out] digest The digest in lowercase hexadecimal
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE The digest is not computed yet
+ * @pre The download state must be #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_set_expected_digest()
+ */
+int url_download_get_digest(url_download_h download, url_download_digest_e *type, char **digest);
+
+
+/**
+ * @brief Checks whether the download completed with the file of a previous download, which was not modified on the server.
+ *
+ * @param [in] download The download handle
+ * @param [out] not_modified @c true if the server answered that the file was not modified, \n
+ * @c false if the file was downloaded
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_set_revalidation_index()
+ */
+int url_download_is_not_modified(url_download_h download, bool *not_modified);
+
+
+/**
+ * @brief Sets the old version of the file, whose blocks are reused instead of being downloaded again.
+ *
+ * @details The block manifest of the new file is downloaded first, then the old file is scanned for its blocks,
+ * which are copied to the new file. Only the other ranges of the new file are requested. The manifest is a text file :
+ * @code
+ * url-download-blocks 1
+ * length <size of the file>
+ * block-size <size of the blocks, 512 to 16777216>
+ * sha256 <SHA-256 of the file>
+ * <weak checksum> <strong checksum>
+ * @endcode
+ * with one line per block of the file, the last one may be shorter. The weak checksum is the rsync rolling checksum
+ * of the block in 8 hexadecimal digits, the strong checksum the first 32 hexadecimal digits of its SHA-256. 
+
+ * The whole file is downloaded if the manifest or the old file cannot be read. The downloaded file is checked
+ * against the SHA-256 of the manifest, the download fails with #URL_DOWNLOAD_ERROR_DIGEST_MISMATCH otherwise.
+ * @remarks The old file is not modified, the new file is another file of the destination. 
+
+ * The delta downloads are done by the in-process backend and are not used for the ranges nor for the local URLs.
+ * @param [in] download The download handle
+ * @param [in] path The absolute path of the old file, @c NULL to download the whole file (default)
+ * @param [in] manifest_url The URL of the manifest, @c NULL for the URL of the download followed by ".blocks"
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_delta_source()
+ * @see url_download_get_wire_size()
+ */
+int url_download_set_delta_source(url_download_h download, const char *path, const char *manifest_url);
+
+
+/**
+ * @brief Gets the old version of the file and the URL of its block manifest.
+ *
+ * @remarks The @a path and the @a manifest_url must be released with free() by you.
+ * @param [in] download The download handle
+ * @param [out] path The path of the old file
+ * @param [out] manifest_url The URL of the manifest, @c NULL for the URL of the download followed by ".blocks"
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_OUT_OF_MEMORY Out of memory
+ * @retval #URL_DOWNLOAD_ERROR_NO_DATA No old file is set
+ * @see url_download_set_delta_source()
+ */
+int url_download_get_delta_source(url_download_h download, char **path, char **manifest_url);
+
+
+/**
+ * @brief Sets whether the partial file of the download is kept and resumed by the next start.
+ *
+ * @details When it is enabled, the data received is flushed to the storage at intervals, and the ranges of
+ * the file still to download are recorded with the ETag or the Last-Modified of the remote file in a checkpoint,
+ * a file next to the partial file with ".checkpoint" appended to its name. \n
+ * When the download is stopped, fails or its process ends, the partial file and its checkpoint are kept.
+ * The next start of a download of the same URL to the same destination requests the ranges of the checkpoint
+ * with If-Range. The file is downloaded again from its start if the remote file changed since the checkpoint. \n
+ * The checkpoint is removed when the download completes. A file whose digest does not match, or whose server
+ * sends neither a strong ETag nor a Last-Modified or does not accept the ranges, is removed as without checkpoint.
+ * @remarks The checkpoints are written by the in-process backend. They are not used for the ranges, the delta
+ * downloads, the decoded contents nor the local URLs.
+ * @param [in] download The download handle
+ * @param [in] enable @c true to keep and resume the partial file, @c false to remove it (default)
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_checkpoint()
+ * @see url_download_stop()
+ */
+int url_download_set_checkpoint(url_download_h download, bool enable);
+
+
+/**
+ * @brief Gets whether the partial file of the download is kept and resumed by the next start.
+ *
+ * @param [in] download The download handle
+ * @param [out] enable @c true if the partial file is kept and resumed
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_checkpoint()
+ */
+int url_download_get_checkpoint(url_download_h download, bool *enable);
+
+
+/**
+ * @brief Sets whether the completed file of the download is on the storage when it gets its name.
+ *
+ * @details When it is enabled, the file is written with ".part" appended to its name. When the download
+ * completes, its data is flushed to the storage, it is renamed and its directory is flushed, then the
+ * completed callback is invoked : a file with its name is complete after a crash or a power loss. \n
+ * The files completed at the same time are flushed together, once for each file system and each directory,
+ * which costs less than a flush of each file by the application.
+ * @remarks The name is chosen free when the download starts, a file created with the same name before the
+ * completion is replaced. \n
+ * The atomic completions are done by the in-process backend. They are not used for the ranges written at their
+ * offset of an existing file.
+ * @param [in] download The download handle
+ * @param [in] enable @c true to flush and rename the completed file, @c false to write the file with its name (default)
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_atomic_completion()
+ * @see url_download_set_checkpoint()
+ */
+int url_download_set_atomic_completion(url_download_h download, bool enable);
+
+
+/**
+ * @brief Gets whether the completed file of the download is on the storage when it gets its name.
+ *
+ * @param [in] download The download handle
+ * @param [out] enable @c true if the completed file is flushed and renamed
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_atomic_completion()
+ */
+int url_download_get_atomic_completion(url_download_h download, bool *enable);
+
+
+/**
+ * @brief Sets whether the downloaded tar archive is extracted to the destination while it is received.
+ *
+ * @details When it is enabled, the body of the URL is a tar archive, compressed with gzip or not, whose regular
+ * files and directories are created under the destination directory as their data arrives. The archive itself is
+ * not stored. url_download_extracted_cb() is invoked for each file once its data is written, so the first files
+ * can be used before the end of the download. The completed callback gets the destination directory. \n
+ * The ustar, GNU and pax formats are read. The links, the special files, and the entries whose name goes out of
+ * the destination are not extracted. The files of the destination with the name of an entry are replaced. \n
+ * An archive which is truncated or invalid fails the download with #URL_DOWNLOAD_ERROR_INVALID_ARCHIVE. The files
+ * already extracted are kept when the download fails or is stopped, the file being extracted is removed. \n
+ * The digest set by url_download_set_expected_digest() is the one of the archive.
+ * @remarks The archives are extracted by the in-process backend. The extraction is not used with the ranges, the
+ * delta downloads, the content store, the revalidation, the checkpoints, the atomic completions nor the local URLs,
+ * url_download_start() fails with #URL_DOWNLOAD_ERROR_INVALID_PARAMETER for the ranges and the local URLs.
+ * @param [in] download The download handle
+ * @param [in] enable @c true to extract the archive, @c false to store the file as it is received (default)
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_archive_extraction()
+ * @see url_download_set_extracted_cb()
+ */
+int url_download_set_archive_extraction(url_download_h download, bool enable);
+
+
+/**
+ * @brief Gets whether the downloaded tar archive is extracted to the destination.
+ *
+ * @param [in] download The download handle
+ * @param [out] enable @c true if the archive is extracted
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_archive_extraction()
+ */
+int url_download_get_archive_extraction(url_download_h download, bool *enable);
+
+
+/**
+ * @brief Sets where the content of the download is written.
+ *
+ * @details With #URL_DOWNLOAD_DESTINATION_MEMORY, the content is received in a buffer of the library, which the
+ * application reads with url_download_get_memory() from the completed callback, without a file nor a copy. \n
+ * With #URL_DOWNLOAD_DESTINATION_MEMFD, the content is written to an anonymous file in memory, see memfd_create().
+ * Its descriptor is given by url_download_get_memory_fd(). It is sealed against writes and size changes once
+ * the download is completed, so it can be passed to another process. \n
+ * In both cases, the destination directory is not used and the completed callback gets a NULL path. The content
+ * belongs to the handle until its next start or url_download_destroy().
+ * @remarks The memory destinations are meant for small contents. A buffer larger than 64 MB fails the download
+ * with #URL_DOWNLOAD_ERROR_NO_SPACE. \n
+ * The contents in memory are received by the in-process backend. The content store, the revalidation, the delta
+ * downloads, the checkpoints and the atomic completions are not used with them. url_download_start() fails with
+ * #URL_DOWNLOAD_ERROR_INVALID_PARAMETER for the local URLs, the ranges written at their offset and the archive
+ * extraction.
+ * @param [in] download The download handle
+ * @param [in] type The destination of the content, #URL_DOWNLOAD_DESTINATION_FILE by default
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_READY, #URL_DOWNLOAD_STATE_FAILED or #URL_DOWNLOAD_STATE_COMPLETED.
+ * @see url_download_get_destination_type()
+ * @see url_download_get_memory()
+ * @see url_download_get_memory_fd()
+ */
+int url_download_set_destination_type(url_download_h download, url_download_destination_type_e type);
+
+
+/**
+ * @brief Gets where the content of the download is written.
+ *
+ * @param [in] download The download handle
+ * @param [out] type The destination of the content
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @see url_download_set_destination_type()
+ */
+int url_download_get_destination_type(url_download_h download, url_download_destination_type_e *type);
+
+
+/**
+ * @brief Gets the content of a download completed in memory.
+ *
+ * @remarks The @a data belongs to the handle, it must not be released nor modified by you. It remains valid until
+ * the next start of the download or url_download_destroy(). It is NULL for an empty content.
+ * @param [in] download The download handle
+ * @param [out] data The content
+ * @param [out] length The size of the content in bytes
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_COMPLETED, with #URL_DOWNLOAD_DESTINATION_MEMORY.
+ * @see url_download_set_destination_type()
+ */
+int url_download_get_memory(url_download_h download, const void **data, size_t *length);
+
+
+/**
+ * @brief Gets the anonymous file of a download completed in memory.
+ *
+ * @remarks The @a fd belongs to the handle, it must not be closed by you. It remains valid until the next start
+ * of the download or url_download_destroy(), duplicate it with dup() to keep it. Its file offset is 0.
+ * @param [in] download The download handle
+ * @param [out] fd The file descriptor of the content
+ * @return 0 on success, otherwise a negative error value.
+ * @retval #URL_DOWNLOAD_ERROR_NONE Successful
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_PARAMETER Invalid parameter
+ * @retval #URL_DOWNLOAD_ERROR_INVALID_STATE Invalid state
+ * @pre The download state must be #URL_DOWNLOAD_STATE_COMPLETED, with #URL_DOWNLOAD_DESTINATION_MEMFD.
+ * @see url_download_set_destination_type()
+ */
+int url_download_get_memory_fd(url_download_h download, int *fd);
+
 /**
  * @}
  */
@@ -18,6 +18,8 @@
 #ifndef __TIZEN_WEB_URL_DOWNLOAD_PRIVATE_H__
 #define __TIZEN_WEB_URL_DOWNLOAD_PRIVATE_H__
 
+#include <time.h>
+#include <sys/types.h>
 #include <bundle.h>
 
 #ifdef __cplusplus
@@ -43,6 +45,87 @@ struct url_download_cb_s {
 
 	url_download_progress_cb progress;
 	void *progress_user_data;
+
+	url_download_extracted_cb extracted;
+	void *extracted_user_data;
+};
+
+/**
+ * url_download_token_bucket_s
+ */
+struct url_download_token_bucket_s {
+	unsigned long long rate; /* bytes per second, 0 means unlimited */
+	long long tokens;
+	long long fill_remainder; /* the part of a token not credited yet, in bytes * ns */
+	struct timespec last_fill;
+};
+
+/**
+ * url_download_url_s
+ */
+struct url_download_url_s {
+	char *scheme;
+	char *host;
+	int port;
+	char *path; /* path and query */
+};
+
+struct url_download_http_s;
+struct url_download_tls_s;
+struct url_download_decoder_s;
+struct url_download_digest_s;
+struct url_download_commit_s;
+struct url_download_archive_s;
+
+/**
+ * url_download_base64_s
+ * The characters of an incomplete base64 quantum.
+ */
+struct url_download_base64_s {
+	unsigned int bits;
+	int count;
+};
+
+/**
+ * url_download_writer_stream_s
+ * The writes in flight to one file.
+ */
+struct url_download_writer_stream_s {
+	int pending;
+	int error; /* first write error */
+	int buffered; /* the file does not support splice() */
+};
+
+/**
+ * url_download_writer_buffer_s
+ * The data of one write, in memory or in a pipe filled by splice().
+ */
+struct url_download_writer_buffer_s {
+	int index;
+	char *data; /* URL_DOWNLOAD_HTTP_BUFFER_SIZE bytes */
+	int pipe[2];
+	int use_pipe;
+	int spliced; /* cleared if the file does not support splice() */
+	int fd;
+	long long offset;
+	size_t length;
+	size_t written;
+	int error;
+	struct url_download_writer_stream_s *stream;
+	struct url_download_writer_buffer_s *next;
+};
+
+/**
+ * The transfer backend of a download.
+ * The state checks common to the backends are done by the callers.
+ */
+struct url_download_backend_s {
+	int (*start)(url_download_h download, int *id);
+	int (*pause)(url_download_h download);
+	int (*resume)(url_download_h download);
+	int (*stop)(url_download_h download);
+	int (*get_state)(url_download_h download); /* updates download->state */
+	void (*destroy)(url_download_h download);
 };
 
 struct url_download_s {
@@ -56,15 +139,311 @@ struct url_download_s {
 	bundle *http_header;
 	char *completed_path;
 	char *content_name;
+	char *file_name; /* set by url_download_set_file_name(), content_name is the name of the file */
 	char *mime_type;
 	bundle_raw *service_data;
 	int service_data_len;
-	uint file_size;
+	unsigned long long file_size;
 	int sockfd;
 	int slot_index;
+	struct url_download_token_bucket_s rate_bucket;
+	unsigned long long received_size;
+	int throttled;
+	struct timespec resume_time;
+	char *host;
+	unsigned long queue_sequence;
+	unsigned long admit_sequence;
+	struct timespec queue_time;
+	struct url_download_s *scheduler_next; /* the next download of the active or the pending list */
+	unsigned long long expected_size;
+	struct url_download_s *coalesce_leader;
+	struct url_download_s *followers;
+	struct url_download_s *next_follower;
+	int provider_events; /* URL_DOWNLOAD_EVENT_* requested from download-provider at the start */
+	int started_notified; /* the started event of the transfer, for the handles attaching later */
+	unsigned long long started_file_size;
+	char *started_mime_type;
+	char *started_content_name;
+	url_download_backend_e backend_type;
+	const struct url_download_backend_s *backend;
+	struct url_download_http_s *http;
+	int segment_count;
+	int content_decoding;
+	unsigned long long wire_received; /* bytes of the body received, before the content decoding */
+	unsigned long long wire_size;
+	long long range_offset; /* negative : the last bytes of the file */
+	long long range_length; /* 0 : until the end of the file */
+	int range_at_offset;
+	url_download_digest_e digest_type;
+	char *expected_digest; /* lowercase hexadecimal */
+	char *digest; /* of the completed file */
+	int not_modified; /* completed with the file of the revalidation index */
+	unsigned long long reserved_size; /* space reserved on the file system of the destination */
+	dev_t reserved_dev;
+	char *delta_source; /* the old file of a delta download */
+	char *delta_manifest; /* the url of its block manifest, NULL next to the url */
+	int checkpoint; /* the partial file is kept and resumed */
+	int atomic_completion; /* the file gets its name once it is on the storage */
+	int archive_extraction; /* the tar archive is extracted to the destination */
+	url_download_destination_type_e destination_type;
+	char *memory; /* the content of a download completed to URL_DOWNLOAD_DESTINATION_MEMORY */
+	size_t memory_length;
+	int memory_fd; /* the memfd of a download completed to URL_DOWNLOAD_DESTINATION_MEMFD */
 };
 
-#define MAX_DOWNLOAD_HANDLE_COUNT 5
+/* coalescing : the events of a transfer */
+#define URL_DOWNLOAD_EVENT_STARTED 0x01
+#define URL_DOWNLOAD_EVENT_PAUSED 0x02
+#define URL_DOWNLOAD_EVENT_COMPLETED 0x04
+#define URL_DOWNLOAD_EVENT_STOPPED 0x08
+#define URL_DOWNLOAD_EVENT_PROGRESS 0x10
+#define URL_DOWNLOAD_EVENT_ALL 0x1f
+
+/* setters : the options of a started download do not change */
+#define STATE_IS_RUNNING(_download_) \
+	 (_download_->state == URL_DOWNLOAD_STATE_DOWNLOADING \
+	 || _download_->state == URL_DOWNLOAD_STATE_PAUSED \
+	 || _download_->state == URL_DOWNLOAD_STATE_QUEUED)
+
+/* handles of the application, the queued ones included */
+#define MAX_DOWNLOAD_HANDLE_COUNT 1024
+
+/* adaptive concurrency : length of a throughput sample */
+#define URL_DOWNLOAD_ADAPTIVE_WINDOW_MS 2000
+/* adaptive concurrency : relative change of throughput treated as significant, in percent */
+#define URL_DOWNLOAD_ADAPTIVE_GAIN 10
+#define URL_DOWNLOAD_ADAPTIVE_LOSS 25
+/* adaptive concurrency : stable samples before probing one more download */
+#define URL_DOWNLOAD_ADAPTIVE_PROBE_WINDOWS 5
+/* adaptive concurrency : upper bound of the limit when the number of running downloads is not limited */
+#define URL_DOWNLOAD_ADAPTIVE_MAX_LIMIT 64
+
+/* space reservations : destination directories whose free space is kept during a pass over the pending list */
+#define URL_DOWNLOAD_SPACE_CACHE_COUNT 8
+/* shortest first : entries of the cache of the sizes seen per URL */
+#define URL_DOWNLOAD_SIZE_CACHE_COUNT 32
+/* shortest first : size assumed for a download of unknown size */
+#define URL_DOWNLOAD_UNKNOWN_SIZE_ESTIMATE (4 * 1024 * 1024)
+/* shortest first : the remaining bytes of a pending download count half after each period of waiting */
+#define URL_DOWNLOAD_AGING_PERIOD_MS 5000
+/* shortest first : a pending download waiting this long goes before the shorter ones, the oldest first */
+#define URL_DOWNLOAD_AGING_MAX_WAIT_MS 60000
+
+/* default storage of the in-process backend */
+#define URL_DOWNLOAD_DEFAULT_DESTINATION "/opt/media/Downloads"
+/* in-process backend : no connection or no data for this time fails the download */
+#define URL_DOWNLOAD_HTTP_TIMEOUT_MS 30000
+#define URL_DOWNLOAD_HTTP_MAX_REDIRECTS 10
+#define URL_DOWNLOAD_HTTP_MAX_HEADER_SIZE (64 * 1024)
+#define URL_DOWNLOAD_HTTP_BUFFER_SIZE (64 * 1024)
+#define URL_DOWNLOAD_HTTP_PROGRESS_INTERVAL_MS 200
+/* in-process backend : connections of a segmented download, and the smallest range fetched by one */
+#define URL_DOWNLOAD_HTTP_MAX_SEGMENTS 8
+#define URL_DOWNLOAD_HTTP_MIN_SEGMENT_SIZE (1024 * 1024)
+/* in-process backend : the numbers appended to the name of a file which already exists */
+#define URL_DOWNLOAD_HTTP_MAX_FILE_NUMBER 100
+/* in-process backend : connections kept open for the next requests */
+#define URL_DOWNLOAD_HTTP_MAX_IDLE 16
+#define URL_DOWNLOAD_HTTP_MAX_IDLE_PER_HOST 4
+#define URL_DOWNLOAD_HTTP_IDLE_TIMEOUT_MS 15000
+/* in-process backend : probes of url_download_probe() in progress */
+#define URL_DOWNLOAD_HTTP_MAX_PROBES 16
+/* in-process backend : TLS sessions kept to resume the next handshakes with the hosts */
+#define URL_DOWNLOAD_TLS_SESSION_CACHE_COUNT 16
+#define URL_DOWNLOAD_TLS_SESSION_LIFETIME_MS (10 * 60 * 1000)
+
+/* do not pause for a shorter time than this to keep up with the budget */
+#define URL_DOWNLOAD_THROTTLE_MIN_MS 100
+
+/* the downloaded data not yet written to the files, the network reads wait above it */
+#define URL_DOWNLOAD_WRITER_MAX_IN_FLIGHT (1024 * 1024)
+/* writer threads used when io_uring is not available */
+#define URL_DOWNLOAD_WRITER_THREAD_COUNT 2
+
+/* bytes of the file read back for its digest at each turn of the engine */
+#define URL_DOWNLOAD_DIGEST_SLICE_SIZE (4 * 1024 * 1024)
+
+/* entries of the revalidation index, the oldest ones are dropped */
+#define URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES 1024
+
+/* bytes of a file:// or data: url copied at each turn of the engine */
+#define URL_DOWNLOAD_LOCAL_SLICE_SIZE (4 * 1024 * 1024)
+
+/* delta downloads : bytes of the old file scanned, or copied, at each turn of the engine */
+#define URL_DOWNLOAD_DELTA_SLICE_SIZE (4 * 1024 * 1024)
+/* delta downloads : the blocks found between two ranges to fetch are fetched with them below this size */
+#define URL_DOWNLOAD_DELTA_MERGE_GAP (16 * 1024)
+/* delta downloads : the manifest next to the url */
+#define URL_DOWNLOAD_DELTA_MANIFEST_SUFFIX ".blocks"
+/* delta downloads : larger block manifests are not used */
+#define URL_DOWNLOAD_DELTA_MAX_MANIFEST_SIZE (16 * 1024 * 1024)
+
+/* checkpoints : the checkpoint next to the partial file */
+#define URL_DOWNLOAD_CHECKPOINT_SUFFIX ".checkpoint"
+/* checkpoints : the data received is flushed to the storage and recorded at this interval */
+#define URL_DOWNLOAD_CHECKPOINT_INTERVAL_MS 5000
+
+/* atomic completions : the name of the file until it is on the storage */
+#define URL_DOWNLOAD_ATOMIC_SUFFIX ".part"
+/* atomic completions : a group of this many files is flushed with one syncfs(), the other files of the file system with it */
+#define URL_DOWNLOAD_COMMIT_SYNCFS_COUNT 2
+
+/* archive extraction : larger long names and pax headers are invalid */
+#define URL_DOWNLOAD_ARCHIVE_MAX_EXTENDED_SIZE (64 * 1024)
+
+/* memory destinations : a larger content fails the download */
+#define URL_DOWNLOAD_MEMORY_MAX_SIZE (64 * 1024 * 1024)
+
+/**
+ * url_download_checkpoint_s
+ * The ranges of a partial file still to download, and the validators of the remote file.
+ */
+struct url_download_checkpoint_s {
+	char *url;
+	char *etag;
+	char *last_modified;
+	char *mime_type;
+	long long length;
+	int range_count;
+	long long ranges[URL_DOWNLOAD_HTTP_MAX_SEGMENTS][2]; /* [offset, end) */
+};
+
+void url_download_token_bucket_init(struct url_download_token_bucket_s *bucket, unsigned long long rate);
+long url_download_token_bucket_consume(struct url_download_token_bucket_s *bucket, unsigned long long bytes);
+int url_download_rate_limit_enabled(url_download_h download);
+void url_download_rate_limit_reset(url_download_h download);
+long url_download_rate_limit_consume(url_download_h download, unsigned long long bytes);
+unsigned long long url_download_update_received_size(url_download_h download, unsigned long long received);
+int url_download_error(const char *function, int error_code, const char *description);
+
+int url_download_url_parse(const char *url, struct url_download_url_s *parsed);
+void url_download_url_clear(struct url_download_url_s *parsed);
+char *url_download_url_get_host(const char *url);
+int url_download_url_is_local(const char *url);
+int url_download_url_get_file_path(const char *url, char **path);
+int url_download_url_parse_data(const char *url, char **mime_type, int *base64,
+		char **data, size_t *length);
+
+long long url_download_base64_length(const char *data, size_t length);
+size_t url_download_base64_decode(struct url_download_base64_s *state,
+		const char *data, size_t length, unsigned char *out);
+size_t url_download_base64_finish(struct url_download_base64_s *state, unsigned char *out);
+int url_download_local_clone(int in, int out);
+int url_download_local_copy(int in, int out, long long offset, size_t length, size_t *copied);
+int url_download_local_copy_range(int in, long long in_offset, int out, long long out_offset,
+		size_t length, size_t *copied);
+
+struct url_download_tls_s *url_download_tls_new(int sockfd, const char *host, int port);
+void url_download_tls_free(struct url_download_tls_s *tls);
+int url_download_tls_handshake(struct url_download_tls_s *tls, int *done);
+short url_download_tls_events(struct url_download_tls_s *tls);
+ssize_t url_download_tls_read(struct url_download_tls_s *tls, char *buffer, size_t length);
+ssize_t url_download_tls_write(struct url_download_tls_s *tls, const char *buffer, size_t length);
+size_t url_download_tls_pending(struct url_download_tls_s *tls);
+
+const char *url_download_decoder_accept();
+struct url_download_decoder_s *url_download_decoder_new(const char *content_encoding);
+void url_download_decoder_free(struct url_download_decoder_s *decoder);
+int url_download_decoder_run(struct url_download_decoder_s *decoder, const char **data, size_t *length,
+		char *out, size_t size, size_t *produced, int *finished);
+
+struct url_download_digest_s *url_download_digest_new(url_download_digest_e type);
+void url_download_digest_free(struct url_download_digest_s *digest);
+void url_download_digest_update(struct url_download_digest_s *digest, const void *data, size_t length);
+char *url_download_digest_final(struct url_download_digest_s *digest);
+
+int url_download_store_enabled();
+char *url_download_store_find(url_download_digest_e type, const char *digest);
+char *url_download_store_find_etag(const char *url, const char *etag);
+int url_download_store_link(const char *object, const char *path);
+void url_download_store_add(const char *path, url_download_digest_e type, const char *digest,
+		const char *url, const char *etag);
+
+int url_download_revalidation_enabled();
+int url_download_revalidation_find(const char *url, const char *destination,
+		char **path, char **etag, char **last_modified);
+void url_download_revalidation_record(const char *url, const char *destination,
+		const char *path, const char *etag, const char *last_modified);
+
+struct url_download_delta_s *url_download_delta_new(char *manifest, size_t length);
+void url_download_delta_free(struct url_download_delta_s *delta);
+long long url_download_delta_length(struct url_download_delta_s *delta);
+const char *url_download_delta_digest(struct url_download_delta_s *delta);
+long long url_download_delta_matched(struct url_download_delta_s *delta);
+int url_download_delta_scan(struct url_download_delta_s *delta, int fd, int *done);
+int url_download_delta_copy(struct url_download_delta_s *delta, int in, int out, size_t *copied, int *done);
+int url_download_delta_next_range(struct url_download_delta_s *delta, long long *start, long long *end);
+
+void url_download_checkpoint_clear(struct url_download_checkpoint_s *checkpoint);
+int url_download_checkpoint_read(const char *path, struct url_download_checkpoint_s *checkpoint);
+int url_download_checkpoint_write(const char *path, struct url_download_checkpoint_s *checkpoint);
+void url_download_checkpoint_remove(const char *path);
+
+int url_download_scheduler_admit(url_download_h download);
+void url_download_scheduler_release(url_download_h download);
+void url_download_scheduler_dispatch();
+int url_download_scheduler_adaptive_enabled();
+void url_download_scheduler_report_progress(unsigned long long bytes);
+void url_download_scheduler_record_size(const char *url, unsigned long long size);
+void url_download_scheduler_replace(url_download_h download, url_download_h heir);
+int url_download_scheduler_reserve(url_download_h download, unsigned long long size);
+url_download_h url_download_scheduler_find(
+		int (*match)(url_download_h candidate, url_download_h download),
+		url_download_h download);
+
+extern const struct url_download_backend_s url_download_provider_backend;
+extern const struct url_download_backend_s url_download_http_backend;
+
+int url_download_provider_start(url_download_h download, int *id);
+int url_download_provider_stop(url_download_h download);
+void url_download_http_rebind(url_download_h download);
+void url_download_http_cancel_probes(url_download_h download);
+int url_download_error_invalid_state(const char *function, url_download_h download);
+const char *url_download_destination_directory(url_download_h download);
+int url_download_get_all_http_header_fields(url_download_h download, char ***fields, int *fields_length);
+
+int url_download_coalesce_attach(url_download_h download);
+void url_download_coalesce_detach(url_download_h download);
+url_download_h url_download_coalesce_handover(url_download_h leader);
+int url_download_coalesce_events(url_download_h download);
+void url_download_coalesce_record_started(url_download_h download);
+void url_download_coalesce_clear_started(url_download_h download);
+
+int url_download_writer_init();
+int url_download_writer_fd();
+int url_download_writer_available();
+struct url_download_writer_buffer_s *url_download_writer_get(int use_pipe);
+void url_download_writer_release(struct url_download_writer_buffer_s *buffer);
+void url_download_writer_submit(struct url_download_writer_buffer_s *buffer,
+		struct url_download_writer_stream_s *stream, int fd, long long offset, size_t length);
+void url_download_writer_flush();
+void url_download_writer_reap();
+void url_download_writer_wait_any();
+void url_download_writer_wait(struct url_download_writer_stream_s *stream);
+
+int url_download_commit_fd();
+struct url_download_commit_s *url_download_commit_submit(int fd, const char *temporary, const char *path);
+void url_download_commit_reap();
+int url_download_commit_done(struct url_download_commit_s *commit, int *error);
+void url_download_commit_free(struct url_download_commit_s *commit);
+void url_download_commit_abandon(struct url_download_commit_s *commit);
+
+struct url_download_archive_s *url_download_archive_new(const char *directory);
+void url_download_archive_free(struct url_download_archive_s *archive);
+int url_download_archive_write(struct url_download_archive_s *archive, const char *data, size_t length);
+int url_download_archive_finish(struct url_download_archive_s *archive);
+int url_download_archive_retire(struct url_download_archive_s *archive);
+int url_download_archive_pending(struct url_download_archive_s *archive);
+int url_download_archive_extracted(struct url_download_archive_s *archive);
+int url_download_archive_next(struct url_download_archive_s *archive, char **path, unsigned long long *size);
+
+void url_download_notify_started(url_download_h download);
+void url_download_notify_paused(url_download_h download);
+void url_download_notify_progress(url_download_h download,
+		unsigned long long received, unsigned long long total);
+void url_download_notify_completed(url_download_h download);
+void url_download_notify_stopped(url_download_h download, url_download_error_e error);
+void url_download_notify_extracted(url_download_h download, const char *path, unsigned long long size);
 
 #ifdef __cplusplus
 }
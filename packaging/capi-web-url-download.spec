@@ -7,12 +7,19 @@ Group:		Development/Libraries
 License:	TO_BE_FILLED_IN
 URL:		Apache
 Source0:	%{name}-%{version}.tar.gz
+%bcond_with zstd
+%bcond_with io_uring
 BuildRequires: pkgconfig(capi-base-common)
 BuildRequires: pkgconfig(bundle)
 BuildRequires: pkgconfig(dlog)
 BuildRequires: pkgconfig(capi-appfw-app-manager)
 BuildRequires: pkgconfig(capi-appfw-application)
 BuildRequires: pkgconfig(download-provider)
+BuildRequires: pkgconfig(openssl)
+BuildRequires: pkgconfig(zlib)
+%if %{with zstd}
+BuildRequires: pkgconfig(libzstd)
+%endif
 BuildRequires: cmake
 BuildRequires: expat-devel
 
@@ -31,7 +38,8 @@ CAPI for content downloading with web url (developement files)
 %setup -q
 
 %build
-cmake . -DCMAKE_INSTALL_PREFIX="/"
+cmake . -DCMAKE_INSTALL_PREFIX="/" -DUSE_ZSTD=%{?with_zstd:ON}%{!?with_zstd:OFF} \
+	-DUSE_IO_URING=%{?with_io_uring:ON}%{!?with_io_uring:OFF}
 
 make %{?jobs:-j%jobs}
 
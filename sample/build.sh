@@ -1,5 +1,7 @@
 #!/bin/sh
 
 gcc -o url_download_test test.c -I./ `pkg-config --cflags --libs capi-web-url-download ecore gobject-2.0` -g
+gcc -o url_download_rate_limit_test rate_limit_test.c -I./ `pkg-config --cflags --libs capi-web-url-download` -g
+gcc -o url_download_large_file_test large_file_test.c -I./ `pkg-config --cflags --libs capi-web-url-download` -g
 
 
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the downloads over 4 GB against the local server :
+ *   python3 test_server.py 8080 &
+ *   ./url_download_large_file_test [http://127.0.0.1:8080] [destination] [size]
+ * The destination needs <size> bytes free, 5000000000 by default.
+ * The byte at offset p of the body is p % 251.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <url_download.h>
+
+#define LOGD(fmt, ...) \
+	do { printf("[D][L:%3d] " fmt, __LINE__, ##__VA_ARGS__); \
+	   printf("\n"); \
+	} while(0);
+#define LOGE(fmt, ...) \
+	do { printf("[E][L:%3d] " fmt, __LINE__, ##__VA_ARGS__); \
+	   printf("\n"); \
+	} while(0);
+
+#define TEST_SIZE 5000000000ULL
+#define TEST_RANGE_OFFSET (4294967296LL + 100)
+#define TEST_RANGE_LENGTH 1000
+#define TEST_CHECK_LENGTH 4096
+#define TEST_TIMEOUT_SEC 600
+
+struct test_download_s {
+	url_download_h handle;
+	volatile int done;
+	int error;
+	char *path;
+	unsigned long long received;
+	unsigned long long total;
+	int backwards;
+};
+
+static const char *base_url = "http://127.0.0.1:8080";
+static const char *destination = "/tmp";
+static unsigned long long size = TEST_SIZE;
+
+static double now_sec()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void completed_cb(url_download_h download, const char *path, void *user_data)
+{
+	struct test_download_s *test = user_data;
+	test->path = strdup(path);
+	test->done = 1;
+}
+
+static void stopped_cb(url_download_h download, url_download_error_e error, void *user_data)
+{
+	struct test_download_s *test = user_data;
+	test->error = error;
+	test->done = 1;
+}
+
+static void progress_cb(url_download_h download, unsigned long long received, unsigned long long total, void *user_data)
+{
+	struct test_download_s *test = user_data;
+	if (received < test->received)
+		test->backwards = 1;
+	test->received = received;
+	test->total = total;
+}
+
+static int create_download(struct test_download_s *test)
+{
+	char url[256];
+
+	memset(test, 0x00, sizeof(struct test_download_s));
+	snprintf(url, sizeof(url), "%s/%llu", base_url, size);
+	if (url_download_create(&test->handle) != URL_DOWNLOAD_ERROR_NONE)
+		return -1;
+	url_download_set_url(test->handle, url);
+	url_download_set_destination(test->handle, destination);
+	// download-provider when it runs, the in-process backend otherwise
+	url_download_set_backend(test->handle, URL_DOWNLOAD_BACKEND_AUTO);
+	url_download_set_completed_cb(test->handle, completed_cb, test);
+	url_download_set_stopped_cb(test->handle, stopped_cb, test);
+	url_download_set_progress_cb(test->handle, progress_cb, test);
+	return 0;
+}
+
+static int run_download(const char *name, struct test_download_s *test)
+{
+	double deadline = now_sec() + TEST_TIMEOUT_SEC;
+	double start = now_sec();
+
+	if (url_download_start(test->handle, NULL) != URL_DOWNLOAD_ERROR_NONE) {
+		LOGE("%s : FAIL, the download did not start", name);
+		return -1;
+	}
+	while (!test->done && now_sec() < deadline)
+		usleep(100000);
+	if (!test->done) {
+		LOGE("%s : FAIL, timed out at %llu/%llu", name, test->received, test->total);
+		return -1;
+	}
+	if (test->error != URL_DOWNLOAD_ERROR_NONE) {
+		LOGE("%s : FAIL, stopped [%d]", name, test->error);
+		return -1;
+	}
+	LOGD("%s : %llu/%llu in %.1f s", name, test->received, test->total, now_sec() - start);
+	return 0;
+}
+
+// the bytes of the file at <position> are the ones of the body at <offset>
+static int check_content(const char *path, long long position, long long offset, int length)
+{
+	unsigned char buffer[TEST_CHECK_LENGTH];
+	int fd = -1;
+	int i = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (pread(fd, buffer, length, position) != length) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	for (i = 0; i < length; i++) {
+		if (buffer[i] != (offset + i) % 251)
+			return -1;
+	}
+	return 0;
+}
+
+static int check_file(const char *name, struct test_download_s *test, unsigned long long expected, long long offset)
+{
+	struct stat st;
+	int length = (expected < TEST_CHECK_LENGTH ? (int)expected : TEST_CHECK_LENGTH);
+
+	if (test->backwards) {
+		LOGE("%s : FAIL, the progress went backwards", name);
+		return -1;
+	}
+	if (test->received != expected || test->total != expected) {
+		LOGE("%s : FAIL, progress %llu/%llu, expected %llu", name, test->received, test->total, expected);
+		return -1;
+	}
+	if (stat(test->path, &st) < 0 || (unsigned long long)st.st_size != expected) {
+		LOGE("%s : FAIL, the file is not %llu bytes", name, expected);
+		return -1;
+	}
+	if (check_content(test->path, 0, offset, length) < 0
+		|| check_content(test->path, expected - length, offset + expected - length, length) < 0) {
+		LOGE("%s : FAIL, the content is wrong", name);
+		return -1;
+	}
+	LOGD("%s : PASS", name);
+	return 0;
+}
+
+static void destroy_download(struct test_download_s *test)
+{
+	if (test->path) {
+		unlink(test->path);
+		free(test->path);
+	}
+	if (test->handle)
+		url_download_destroy(test->handle);
+}
+
+static int test_large_file()
+{
+	struct test_download_s test;
+	int ret = -1;
+
+	if (create_download(&test) == 0) {
+		// download-provider reports the sizes in 32 bits on the 32-bit targets
+		url_download_set_expected_size(test.handle, size);
+		if (run_download("large file", &test) == 0)
+			ret = check_file("large file", &test, size, 0);
+	}
+	destroy_download(&test);
+	return ret;
+}
+
+static int test_range_over_4gb()
+{
+	struct test_download_s test;
+	int ret = -1;
+
+	if (create_download(&test) == 0) {
+		url_download_set_range(test.handle, TEST_RANGE_OFFSET, TEST_RANGE_LENGTH);
+		if (run_download("range over 4 GB", &test) == 0)
+			ret = check_file("range over 4 GB", &test, TEST_RANGE_LENGTH, TEST_RANGE_OFFSET);
+	}
+	destroy_download(&test);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+
+	if (argc > 1)
+		base_url = argv[1];
+	if (argc > 2)
+		destination = argv[2];
+	if (argc > 3)
+		size = strtoull(argv[3], NULL, 10);
+
+	if (size <= TEST_RANGE_OFFSET + TEST_RANGE_LENGTH) {
+		LOGE("the size must be over %lld bytes", TEST_RANGE_OFFSET + TEST_RANGE_LENGTH);
+		return EXIT_FAILURE;
+	}
+
+	if (test_range_over_4gb() < 0)
+		failed++;
+	if (test_large_file() < 0)
+		failed++;
+
+	LOGD("%d failed", failed);
+	return (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the throttled rate of the downloads against the local server :
+ *   python3 test_server.py 8080 &
+ *   ./url_download_rate_limit_test [http://127.0.0.1:8080] [destination]
+ * The bucket allows a burst of one second worth of data, a download of
+ * <size> bytes at <rate> bytes per second takes (size - rate) / rate seconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <url_download.h>
+
+#define LOGD(fmt, ...) \
+	do { printf("[D][L:%3d] " fmt, __LINE__, ##__VA_ARGS__); \
+	   printf("\n"); \
+	} while(0);
+#define LOGE(fmt, ...) \
+	do { printf("[E][L:%3d] " fmt, __LINE__, ##__VA_ARGS__); \
+	   printf("\n"); \
+	} while(0);
+
+#define TEST_SIZE 3000000ULL
+#define TEST_RATE 500000ULL
+#define TEST_TIMEOUT_SEC 30
+
+struct test_download_s {
+	url_download_h handle;
+	volatile int done;
+	int error;
+};
+
+static const char *base_url = "http://127.0.0.1:8080";
+static const char *destination = "/tmp";
+
+static double now_sec()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void completed_cb(url_download_h download, const char *path, void *user_data)
+{
+	struct test_download_s *test = user_data;
+	unlink(path);
+	test->done = 1;
+}
+
+static void stopped_cb(url_download_h download, url_download_error_e error, void *user_data)
+{
+	struct test_download_s *test = user_data;
+	test->error = error;
+	test->done = 1;
+}
+
+static int start_download(struct test_download_s *test, unsigned long long size, unsigned long long rate)
+{
+	char url[256];
+
+	memset(test, 0x00, sizeof(struct test_download_s));
+	snprintf(url, sizeof(url), "%s/%llu", base_url, size);
+	if (url_download_create(&test->handle) != URL_DOWNLOAD_ERROR_NONE)
+		return -1;
+	url_download_set_url(test->handle, url);
+	url_download_set_destination(test->handle, destination);
+	// download-provider when it runs, the in-process backend otherwise
+	url_download_set_backend(test->handle, URL_DOWNLOAD_BACKEND_AUTO);
+	url_download_set_completed_cb(test->handle, completed_cb, test);
+	url_download_set_stopped_cb(test->handle, stopped_cb, test);
+	if (url_download_set_rate_limit(test->handle, rate) != URL_DOWNLOAD_ERROR_NONE)
+		return -1;
+	return url_download_start(test->handle, NULL);
+}
+
+static int wait_downloads(struct test_download_s *tests, int count)
+{
+	double deadline = now_sec() + TEST_TIMEOUT_SEC;
+	int i = 0;
+
+	for (i = 0; i < count; i++) {
+		while (!tests[i].done && now_sec() < deadline)
+			usleep(10000);
+		if (!tests[i].done) {
+			LOGE("download %d timed out", i);
+			return -1;
+		}
+		if (tests[i].error != URL_DOWNLOAD_ERROR_NONE) {
+			LOGE("download %d stopped [%d]", i, tests[i].error);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// the elapsed time of <bytes> at <rate>, within 10% and the latency of the progress reports
+static int check_elapsed(const char *name, double elapsed, unsigned long long bytes, unsigned long long rate)
+{
+	double expected = (double)(bytes - rate) / rate;
+
+	LOGD("%s : %llu bytes in %.2f s, expected %.2f s", name, bytes, elapsed, expected);
+	if (elapsed < expected * 0.9 || elapsed > expected * 1.1 + 0.5) {
+		LOGE("%s : FAIL", name);
+		return -1;
+	}
+	LOGD("%s : PASS", name);
+	return 0;
+}
+
+static int test_invalid_rates()
+{
+	struct test_download_s test;
+	int ret = 0;
+
+	if (url_download_create(&test.handle) != URL_DOWNLOAD_ERROR_NONE)
+		return -1;
+	if (url_download_set_rate_limit(test.handle, (unsigned long long)LLONG_MAX + 1)
+		!= URL_DOWNLOAD_ERROR_INVALID_PARAMETER
+		|| url_download_set_global_rate_limit((unsigned long long)LLONG_MAX + 1)
+		!= URL_DOWNLOAD_ERROR_INVALID_PARAMETER) {
+		LOGE("invalid rates : FAIL, a rate above LLONG_MAX is accepted");
+		ret = -1;
+	} else {
+		LOGD("invalid rates : PASS");
+	}
+	url_download_destroy(test.handle);
+	return ret;
+}
+
+static int test_download_rate()
+{
+	struct test_download_s test;
+	double start = now_sec();
+	int ret = 0;
+
+	if (start_download(&test, TEST_SIZE, TEST_RATE) != URL_DOWNLOAD_ERROR_NONE) {
+		LOGE("download rate : FAIL, the download did not start");
+		if (test.handle)
+			url_download_destroy(test.handle);
+		return -1;
+	}
+	if (url_download_set_rate_limit(test.handle, TEST_RATE * 2) != URL_DOWNLOAD_ERROR_INVALID_STATE) {
+		LOGE("download rate : FAIL, the rate of a running download is changed");
+		ret = -1;
+	}
+	if (wait_downloads(&test, 1) < 0)
+		ret = -1;
+	else if (check_elapsed("download rate", now_sec() - start, TEST_SIZE, TEST_RATE) < 0)
+		ret = -1;
+	url_download_destroy(test.handle);
+	return ret;
+}
+
+// two downloads share the global budget
+static int test_global_rate()
+{
+	struct test_download_s tests[2];
+	double start = now_sec();
+	int ret = 0;
+	int i = 0;
+
+	url_download_set_global_rate_limit(TEST_RATE);
+	for (i = 0; i < 2; i++) {
+		if (start_download(&tests[i], TEST_SIZE / 2, 0) != URL_DOWNLOAD_ERROR_NONE) {
+			LOGE("global rate : FAIL, the download did not start");
+			ret = -1;
+		}
+	}
+	if (ret == 0 && wait_downloads(tests, 2) < 0)
+		ret = -1;
+	else if (ret == 0 && check_elapsed("global rate", now_sec() - start, TEST_SIZE, TEST_RATE) < 0)
+		ret = -1;
+	for (i = 0; i < 2; i++) {
+		if (tests[i].handle)
+			url_download_destroy(tests[i].handle);
+	}
+	url_download_set_global_rate_limit(0);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+
+	if (argc > 1)
+		base_url = argv[1];
+	if (argc > 2)
+		destination = argv[2];
+
+	if (test_invalid_rates() < 0)
+		failed++;
+	if (test_download_rate() < 0)
+		failed++;
+	if (test_global_rate() < 0)
+		failed++;
+
+	LOGD("%d failed", failed);
+	return (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
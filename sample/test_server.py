@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+# Local HTTP server for the sample tests.
+#
+# GET /<size> answers a body of <size> bytes, the byte at offset p is p % 251,
+# so any part of the body can be checked without storing it.
+# A "Range: bytes=<first>-[<last>]" header is answered with 206.
+#
+# usage : test_server.py [port]
+
+import re
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CHUNK = 1024 * 1024
+PATTERN = bytes(i % 251 for i in range(CHUNK + 251))
+
+
+class Handler(BaseHTTPRequestHandler):
+	protocol_version = 'HTTP/1.1'
+
+	def _parse(self):
+		try:
+			size = int(self.path.strip('/').split('?')[0])
+		except ValueError:
+			self.send_error(404)
+			return None
+		first, last = 0, size - 1
+		status = 200
+		match = re.match(r'bytes=(\d+)-(\d*)$', self.headers.get('Range', ''))
+		if match:
+			first = int(match.group(1))
+			if match.group(2):
+				last = min(int(match.group(2)), size - 1)
+			if first >= size or first > last:
+				self.send_response(416)
+				self.send_header('Content-Range', 'bytes */%d' % size)
+				self.send_header('Content-Length', '0')
+				self.end_headers()
+				return None
+			status = 206
+		self.send_response(status)
+		self.send_header('Content-Type', 'application/octet-stream')
+		self.send_header('Content-Length', str(last - first + 1))
+		self.send_header('Accept-Ranges', 'bytes')
+		self.send_header('ETag', '"%d"' % size)
+		if status == 206:
+			self.send_header('Content-Range', 'bytes %d-%d/%d' % (first, last, size))
+		self.end_headers()
+		return first, last
+
+	def do_HEAD(self):
+		self._parse()
+
+	def do_GET(self):
+		span = self._parse()
+		if span is None:
+			return
+		position, last = span
+		try:
+			while position <= last:
+				length = min(CHUNK, last - position + 1)
+				offset = position % 251
+				self.wfile.write(PATTERN[offset:offset + length])
+				position += length
+		except (BrokenPipeError, ConnectionResetError):
+			pass
+
+	def log_message(self, format, *args):
+		pass
+
+
+if __name__ == '__main__':
+	port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+	ThreadingHTTPServer(('127.0.0.1', port), Handler).serve_forever()
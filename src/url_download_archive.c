@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The extraction of a tar archive (see url_download_set_archive_extraction())
+// while its body is received : a gzip archive is inflated first, then the
+// header blocks are parsed and the data of the regular files is written
+// under the destination through the writer. A file is reported once its
+// writes are done : the engine retires the files whose writes are done at
+// each of its turns (see url_download_archive_retire()), it does not wait
+// for them. The ustar and GNU formats are read, with the long names
+// of GNU and the path and size records of the pax headers. The links and
+// the special files are not extracted.
+// REF : https://pubs.opengroup.org/onlinepubs/9699919799/utilities/pax.html
+
+#define ARCHIVE_BLOCK_SIZE 512
+
+typedef enum {
+	ENTRY_NONE,
+	ENTRY_FILE,
+	ENTRY_SKIP,
+	ENTRY_LONG_NAME, /* GNU 'L' */
+	ENTRY_PAX, /* pax 'x' */
+} entry_kind_e;
+
+// a file extracted, with the writes of its data
+struct url_download_archive_entry_s {
+	char *path;
+	unsigned long long size;
+	int fd; /* 0 once the file is closed */
+	time_t mtime;
+	struct url_download_writer_stream_s stream;
+	struct url_download_archive_entry_s *next;
+};
+
+struct url_download_archive_s {
+	char *directory;
+	struct url_download_decoder_s *gzip;
+	int inflated_all; /* the end of the gzip stream was inflated */
+	char *inflated; /* URL_DOWNLOAD_HTTP_BUFFER_SIZE bytes */
+	unsigned char magic[2];
+	int magic_length;
+	char header[ARCHIVE_BLOCK_SIZE];
+	size_t header_length;
+	entry_kind_e kind;
+	long long remaining; /* bytes of the entry still to read */
+	long long padding; /* bytes up to the next header */
+	struct url_download_archive_entry_s *entry; /* the file being extracted */
+	long long size;
+	long long written;
+	time_t mtime;
+	char *extended; /* the body of a long name or of a pax header */
+	size_t extended_length;
+	char *next_name; /* the name of the next entry, from a long name or a pax header */
+	long long next_size; /* -1, or the size of the next entry from a pax header */
+	int zero_blocks;
+	int finished; /* the end of the archive was read */
+	struct url_download_archive_entry_s *closing; /* with writes in flight, the oldest first */
+	struct url_download_archive_entry_s *closing_last;
+	struct url_download_archive_entry_s *extracted; /* not reported yet, the oldest first */
+	struct url_download_archive_entry_s *last;
+};
+
+static int _invalid(const char *function, const char *reason)
+{
+	LOGE("[%s] invalid archive : %s",function, reason);
+	return URL_DOWNLOAD_ERROR_INVALID_ARCHIVE;
+}
+
+// an octal number padded with spaces or NULs, or a base-256 number for the large sizes
+static int _number(const char *field, size_t size, long long *value)
+{
+	const unsigned char *bytes = (const unsigned char *)field;
+	size_t i = 0;
+
+	*value = 0;
+	if (bytes[0] & 0x80) {
+		for (i = 1; i < size; i++) {
+			if (*value > (0x7fffffffffffffffLL >> 8))
+				return -1;
+			*value = (*value << 8) | bytes[i];
+		}
+		return ((bytes[0] & 0x7f) == 0 ? 0 : -1);
+	}
+	for (i = 0; i < size && bytes[i] == ' '; i++)
+		;
+	for (; i < size && bytes[i] >= '0' && bytes[i] <= '7'; i++)
+		*value = (*value << 3) | (bytes[i] - '0');
+	for (; i < size; i++) {
+		if (bytes[i] != ' ' && bytes[i] != '\0')
+			return -1;
+	}
+	return 0;
+}
+
+static int _valid_checksum(const char *header)
+{
+	const unsigned char *bytes = (const unsigned char *)header;
+	long long checksum = 0;
+	long long sum = 0;
+	int i = 0;
+
+	if (_number(header + 148, 8, &checksum) < 0)
+		return 0;
+	for (i = 0; i < ARCHIVE_BLOCK_SIZE; i++)
+		sum += (i >= 148 && i < 156) ? ' ' : bytes[i];
+	return (sum == checksum);
+}
+
+// the name of the entry : a long name before it, or the prefix and the name of a ustar header
+static char *_entry_name(struct url_download_archive_s *archive)
+{
+	const char *header = archive->header;
+	char *name = NULL;
+	size_t size = 0;
+
+	if (archive->next_name != NULL) {
+		name = archive->next_name;
+		archive->next_name = NULL;
+		return name;
+	}
+	if (memcmp(header + 257, "ustar\0", 6) != 0 || header[345] == '\0')
+		return strndup(header, 100);
+	size = strnlen(header + 345, 155) + strnlen(header, 100) + 2;
+	name = calloc(size, sizeof(char));
+	if (name != NULL)
+		snprintf(name, size, "%.155s/%.100s", header + 345, header);
+	return name;
+}
+
+// the name relative to the destination, NULL if it goes out of it
+static const char *_relative_name(const char *name)
+{
+	const char *component = NULL;
+	size_t length = 0;
+
+	while (*name == '/' || (name[0] == '.' && name[1] == '/'))
+		name += (*name == '/' ? 1 : 2);
+	for (component = name; *component; component += length + (component[length] == '/')) {
+		length = strcspn(component, "/");
+		if (length == 2 && component[0] == '.' && component[1] == '.')
+			return NULL;
+	}
+	return (*name ? name : NULL);
+}
+
+// the directories of the path under the destination
+static int _make_parents(struct url_download_archive_s *archive, char *path)
+{
+	char *slash = path + strlen(archive->directory) + 1;
+
+	while ((slash = strchr(slash, '/')) != NULL) {
+		*slash = '\0';
+		if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+			LOGE("[%s] mkdir [%s] : %s",__FUNCTION__, path, strerror(errno));
+			*slash = '/';
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+		*slash = '/';
+		slash++;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static char *_entry_path(struct url_download_archive_s *archive, const char *relative)
+{
+	size_t size = strlen(archive->directory) + strlen(relative) + 2;
+	char *path = calloc(size, sizeof(char));
+
+	if (path != NULL)
+		snprintf(path, size, "%s/%s", archive->directory, relative);
+	return path;
+}
+
+// a regular file or a directory, the other entries are skipped
+static int _open_entry(struct url_download_archive_s *archive, char type, mode_t mode)
+{
+	struct url_download_archive_entry_s *entry = NULL;
+	const char *relative = NULL;
+	char *name = NULL;
+	char *path = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	name = _entry_name(archive);
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	relative = _relative_name(name);
+	if (relative == NULL || (type != '0' && type != '\0' && type != '7' && type != '5')) {
+		LOGI("[%s] [%s] type [%c] not extracted",__FUNCTION__, name, type ? type : '0');
+		free(name);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	path = _entry_path(archive, relative);
+	free(name);
+	if (path == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	errorcode = _make_parents(archive, path);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE && type == '5') {
+		if (mkdir(path, (mode & 0777) | 0700) < 0 && errno != EEXIST) {
+			LOGE("[%s] mkdir [%s] : %s",__FUNCTION__, path, strerror(errno));
+			errorcode = URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+	} else if (errorcode == URL_DOWNLOAD_ERROR_NONE) {
+		entry = calloc(1, sizeof(struct url_download_archive_entry_s));
+		if (entry == NULL) {
+			free(path);
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		}
+		// a file of the destination is replaced, a link is not followed
+		entry->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+			(mode & 0777) ? (mode & 0777) : 0644);
+		if (entry->fd < 0) {
+			LOGE("[%s] open [%s] : %s",__FUNCTION__, path, strerror(errno));
+			errorcode = (errno == ENOSPC ? URL_DOWNLOAD_ERROR_NO_SPACE : URL_DOWNLOAD_ERROR_IO_ERROR);
+			free(entry);
+		} else {
+			entry->path = path;
+			entry->size = archive->size;
+			entry->mtime = archive->mtime;
+			archive->kind = ENTRY_FILE;
+			archive->entry = entry;
+			archive->written = 0;
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+	}
+	free(path);
+	return errorcode;
+}
+
+static int _write_entry(struct url_download_archive_s *archive, const char *data, size_t length)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	size_t count = 0;
+
+	while (length > 0) {
+		buffer = url_download_writer_get(0);
+		if (buffer == NULL) {
+			url_download_writer_wait_any();
+			continue;
+		}
+		count = (length < URL_DOWNLOAD_HTTP_BUFFER_SIZE ? length : URL_DOWNLOAD_HTTP_BUFFER_SIZE);
+		memcpy(buffer->data, data, count);
+		url_download_writer_submit(buffer, &archive->entry->stream, archive->entry->fd,
+			archive->written, count);
+		data += count;
+		length -= count;
+		archive->written += count;
+	}
+	return archive->entry->stream.error;
+}
+
+// the records "<length> <key>=<value>\n" of a pax header, for the next entry
+static int _read_pax(struct url_download_archive_s *archive)
+{
+	char *record = archive->extended;
+	char *end = archive->extended + archive->extended_length;
+	char *key = NULL;
+	char *value = NULL;
+	long length = 0;
+
+	while (record < end) {
+		length = strtol(record, &key, 10);
+		if (length <= 0 || length > end - record || *key != ' ' || record[length - 1] != '\n')
+			return _invalid(__FUNCTION__, "pax record");
+		key++;
+		value = memchr(key, '=', record + length - key);
+		if (value == NULL)
+			return _invalid(__FUNCTION__, "pax record");
+		value++;
+		if (value - key == 5 && strncmp(key, "path", 4) == 0) {
+			if (archive->next_name)
+				free(archive->next_name);
+			archive->next_name = strndup(value, record + length - 1 - value);
+			if (archive->next_name == NULL)
+				return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		} else if (value - key == 5 && strncmp(key, "size", 4) == 0) {
+			archive->next_size = strtoll(value, NULL, 10);
+		}
+		record += length;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static void _close_entry(struct url_download_archive_entry_s *entry)
+{
+	struct timespec times[2];
+
+	times[0].tv_sec = 0;
+	times[0].tv_nsec = UTIME_OMIT;
+	times[1].tv_sec = entry->mtime;
+	times[1].tv_nsec = 0;
+	futimens(entry->fd, times);
+	close(entry->fd);
+	entry->fd = 0;
+}
+
+static void _free_entry(struct url_download_archive_entry_s *entry)
+{
+	free(entry->path);
+	free(entry);
+}
+
+// the data of the entry was read
+static int _entry_done(struct url_download_archive_s *archive)
+{
+	struct url_download_archive_entry_s *entry = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	switch (archive->kind) {
+	case ENTRY_FILE:
+		// the file is reported once its writes are done
+		entry = archive->entry;
+		archive->entry = NULL;
+		if (archive->closing_last)
+			archive->closing_last->next = entry;
+		else
+			archive->closing = entry;
+		archive->closing_last = entry;
+		break;
+	case ENTRY_LONG_NAME:
+		if (archive->next_name)
+			free(archive->next_name);
+		archive->next_name = strndup(archive->extended, archive->extended_length);
+		if (archive->next_name == NULL)
+			errorcode = URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		break;
+	case ENTRY_PAX:
+		// the length of the last record is not read past the header
+		archive->extended[archive->extended_length] = '\0';
+		errorcode = _read_pax(archive);
+		break;
+	default:
+		break;
+	}
+	if (archive->extended)
+		free(archive->extended);
+	archive->extended = NULL;
+	archive->extended_length = 0;
+	archive->kind = ENTRY_NONE;
+	return errorcode;
+}
+
+static int _read_header(struct url_download_archive_s *archive)
+{
+	const char *header = archive->header;
+	long long size = 0;
+	long long mode = 0;
+	long long mtime = 0;
+	char type = header[156];
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	// the end of the archive is two zero blocks
+	for (i = 0; i < ARCHIVE_BLOCK_SIZE && header[i] == '\0'; i++)
+		;
+	if (i == ARCHIVE_BLOCK_SIZE) {
+		archive->finished = (++archive->zero_blocks >= 2);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	archive->zero_blocks = 0;
+	if (!_valid_checksum(header) || _number(header + 124, 12, &size) < 0 || size < 0)
+		return _invalid(__FUNCTION__, "header");
+	_number(header + 100, 8, &mode);
+	_number(header + 136, 12, &mtime);
+	if (archive->next_size >= 0 && type != 'x' && type != 'L' && type != 'g' && type != 'K')
+		size = archive->next_size;
+
+	archive->kind = ENTRY_SKIP;
+	archive->size = size;
+	archive->mtime = (time_t)mtime;
+	archive->remaining = size;
+	archive->padding = (ARCHIVE_BLOCK_SIZE - size % ARCHIVE_BLOCK_SIZE) % ARCHIVE_BLOCK_SIZE;
+	if (type == 'L' || type == 'x') {
+		if (size > URL_DOWNLOAD_ARCHIVE_MAX_EXTENDED_SIZE)
+			return _invalid(__FUNCTION__, "extended header size");
+		archive->kind = (type == 'L' ? ENTRY_LONG_NAME : ENTRY_PAX);
+		archive->extended = malloc(size + 1);
+		if (archive->extended == NULL)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		archive->extended_length = 0;
+	} else if (type != 'g' && type != 'K') {
+		archive->next_size = -1;
+		errorcode = _open_entry(archive, type, (mode_t)mode);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		// the name is the one of this entry only
+		if (archive->next_name)
+			free(archive->next_name);
+		archive->next_name = NULL;
+	}
+	if (archive->remaining == 0)
+		return _entry_done(archive);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the tar stream
+static int _parse(struct url_download_archive_s *archive, const char *data, size_t length)
+{
+	size_t count = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	while (length > 0 && !archive->finished && errorcode == URL_DOWNLOAD_ERROR_NONE) {
+		if (archive->remaining > 0) {
+			count = (archive->remaining < (long long)length ? archive->remaining : length);
+			if (archive->kind == ENTRY_FILE) {
+				errorcode = _write_entry(archive, data, count);
+			} else if (archive->kind == ENTRY_LONG_NAME || archive->kind == ENTRY_PAX) {
+				memcpy(archive->extended + archive->extended_length, data, count);
+				archive->extended_length += count;
+			}
+			archive->remaining -= count;
+			if (archive->remaining == 0 && errorcode == URL_DOWNLOAD_ERROR_NONE)
+				errorcode = _entry_done(archive);
+		} else if (archive->padding > 0) {
+			count = (archive->padding < (long long)length ? archive->padding : length);
+			archive->padding -= count;
+		} else {
+			count = ARCHIVE_BLOCK_SIZE - archive->header_length;
+			if (count > length)
+				count = length;
+			memcpy(archive->header + archive->header_length, data, count);
+			archive->header_length += count;
+			if (archive->header_length == ARCHIVE_BLOCK_SIZE) {
+				archive->header_length = 0;
+				errorcode = _read_header(archive);
+			}
+		}
+		data += count;
+		length -= count;
+	}
+	return errorcode;
+}
+
+// the body, inflated first if it is a gzip archive
+static int _feed(struct url_download_archive_s *archive, const char *data, size_t length)
+{
+	size_t produced = 0;
+	size_t remaining = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (archive->gzip == NULL)
+		return _parse(archive, data, length);
+	// the inflater may have more output for the same input
+	while ((length > 0 || produced == URL_DOWNLOAD_HTTP_BUFFER_SIZE) && !archive->inflated_all) {
+		remaining = length;
+		errorcode = url_download_decoder_run(archive->gzip, &data, &length,
+			archive->inflated, URL_DOWNLOAD_HTTP_BUFFER_SIZE, &produced, &archive->inflated_all);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return _invalid(__FUNCTION__, "gzip data");
+		if (produced > 0)
+			errorcode = _parse(archive, archive->inflated, produced);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		if (produced == 0 && length == remaining)
+			break;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the files are extracted under the directory, their data is written with the stream
+struct url_download_archive_s *url_download_archive_new(const char *directory)
+{
+	struct url_download_archive_s *archive = NULL;
+
+	archive = calloc(1, sizeof(struct url_download_archive_s));
+	if (archive == NULL)
+		return NULL;
+	archive->directory = strdup(directory);
+	if (archive->directory == NULL) {
+		free(archive);
+		return NULL;
+	}
+	archive->next_size = -1;
+	return archive;
+}
+
+int url_download_archive_write(struct url_download_archive_s *archive, const char *data, size_t length)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	// the first bytes tell a gzip archive from a tar archive
+	if (archive->magic_length < 2) {
+		while (length > 0 && archive->magic_length < 2) {
+			archive->magic[archive->magic_length++] = *data++;
+			length--;
+		}
+		if (archive->magic_length < 2)
+			return URL_DOWNLOAD_ERROR_NONE;
+		if (archive->magic[0] == 0x1f && archive->magic[1] == 0x8b) {
+			archive->gzip = url_download_decoder_new("gzip");
+			archive->inflated = malloc(URL_DOWNLOAD_HTTP_BUFFER_SIZE);
+			if (archive->gzip == NULL || archive->inflated == NULL)
+				return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		}
+		errorcode = _feed(archive, (const char *)archive->magic, 2);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	return _feed(archive, data, length);
+}
+
+// the body ended, the archive must be complete
+int url_download_archive_finish(struct url_download_archive_s *archive)
+{
+	// some writers end the archive without its zero blocks
+	if (archive->gzip != NULL && !archive->inflated_all)
+		return _invalid(__FUNCTION__, "truncated gzip data");
+	if (archive->finished || (archive->kind == ENTRY_NONE && archive->header_length == 0
+		&& archive->padding == 0 && archive->magic_length == 2 && archive->next_name == NULL))
+		return URL_DOWNLOAD_ERROR_NONE;
+	return _invalid(__FUNCTION__, "truncated");
+}
+
+// the files whose writes are done are closed and become extracted, in the order of the archive.
+// returns the first write error of a file.
+int url_download_archive_retire(struct url_download_archive_s *archive)
+{
+	struct url_download_archive_entry_s *entry = NULL;
+
+	while ((entry = archive->closing) != NULL && entry->stream.pending == 0) {
+		if (entry->stream.error != URL_DOWNLOAD_ERROR_NONE)
+			return entry->stream.error;
+		archive->closing = entry->next;
+		if (archive->closing == NULL)
+			archive->closing_last = NULL;
+		_close_entry(entry);
+		entry->next = NULL;
+		if (archive->last)
+			archive->last->next = entry;
+		else
+			archive->extracted = entry;
+		archive->last = entry;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the files with writes in flight
+int url_download_archive_pending(struct url_download_archive_s *archive)
+{
+	return (archive->closing != NULL);
+}
+
+int url_download_archive_extracted(struct url_download_archive_s *archive)
+{
+	return (archive->extracted != NULL);
+}
+
+// the oldest file extracted and not reported yet, NO_DATA if there is none
+int url_download_archive_next(struct url_download_archive_s *archive, char **path, unsigned long long *size)
+{
+	struct url_download_archive_entry_s *entry = archive->extracted;
+
+	if (entry == NULL)
+		return URL_DOWNLOAD_ERROR_NO_DATA;
+	archive->extracted = entry->next;
+	if (archive->extracted == NULL)
+		archive->last = NULL;
+	*path = entry->path;
+	*size = entry->size;
+	free(entry);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the file being extracted is removed, the files extracted are kept
+void url_download_archive_free(struct url_download_archive_s *archive)
+{
+	struct url_download_archive_entry_s *entry = NULL;
+
+	if (archive == NULL)
+		return;
+	if (archive->entry != NULL) {
+		url_download_writer_wait(&archive->entry->stream);
+		close(archive->entry->fd);
+		unlink(archive->entry->path);
+		_free_entry(archive->entry);
+	}
+	// the writes in flight use the streams of the files
+	while ((entry = archive->closing) != NULL) {
+		archive->closing = entry->next;
+		url_download_writer_wait(&entry->stream);
+		_close_entry(entry);
+		_free_entry(entry);
+	}
+	while ((entry = archive->extracted) != NULL) {
+		archive->extracted = entry->next;
+		_free_entry(entry);
+	}
+	url_download_decoder_free(archive->gzip);
+	if (archive->inflated)
+		free(archive->inflated);
+	if (archive->extended)
+		free(archive->extended);
+	if (archive->next_name)
+		free(archive->next_name);
+	free(archive->directory);
+	free(archive);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The events of a download are delivered to the handle itself and to the
+// handles attached to the same transfer (see url_download_coalesce_attach()).
+// The attached handles are notified first, the callback of the owner
+// may destroy it.
+
+static void _copy_string(char **dest, const char *src)
+{
+	if (src == NULL || *dest == src)
+		return;
+	if (*dest)
+		free(*dest);
+	*dest = strdup(src);
+}
+
+void url_download_notify_started(url_download_h download)
+{
+	url_download_h follower = NULL;
+	url_download_h next = NULL;
+
+	url_download_coalesce_record_started(download);
+	follower = download->followers;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		follower->state = download->state;
+		follower->file_size = download->file_size;
+		_copy_string(&follower->mime_type, download->mime_type);
+		if (follower->callback.started)
+			follower->callback.started(follower, download->content_name,
+				download->mime_type, follower->callback.started_user_data);
+	}
+	if (download->callback.started)
+		download->callback.started(download, download->content_name,
+			download->mime_type, download->callback.started_user_data);
+}
+
+void url_download_notify_paused(url_download_h download)
+{
+	url_download_h follower = download->followers;
+	url_download_h next = NULL;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		follower->state = download->state;
+		if (follower->callback.paused)
+			follower->callback.paused(follower, follower->callback.paused_user_data);
+	}
+	if (download->callback.paused)
+		download->callback.paused(download, download->callback.paused_user_data);
+}
+
+void url_download_notify_progress(url_download_h download,
+		unsigned long long received, unsigned long long total)
+{
+	url_download_h follower = download->followers;
+	url_download_h next = NULL;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		if (follower->callback.progress)
+			follower->callback.progress(follower, received, total,
+				follower->callback.progress_user_data);
+	}
+	if (download->callback.progress)
+		download->callback.progress(download, received, total,
+			download->callback.progress_user_data);
+}
+
+// the transfer is over, the attached handles are released after their callback
+void url_download_notify_completed(url_download_h download)
+{
+	url_download_h follower = download->followers;
+	url_download_h next = NULL;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		url_download_coalesce_detach(follower);
+		follower->state = download->state;
+		_copy_string(&follower->completed_path, download->completed_path);
+		if (follower->callback.completed)
+			follower->callback.completed(follower, follower->completed_path,
+				follower->callback.completed_user_data);
+	}
+	if (download->callback.completed)
+		download->callback.completed(download, download->completed_path,
+			download->callback.completed_user_data);
+}
+
+void url_download_notify_stopped(url_download_h download, url_download_error_e error)
+{
+	url_download_h follower = download->followers;
+	url_download_h next = NULL;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		url_download_coalesce_detach(follower);
+		follower->state = download->state;
+		if (follower->callback.stopped)
+			follower->callback.stopped(follower, error,
+				follower->callback.stopped_user_data);
+	}
+	if (download->callback.stopped)
+		download->callback.stopped(download, error,
+			download->callback.stopped_user_data);
+}
+
+void url_download_notify_extracted(url_download_h download, const char *path, unsigned long long size)
+{
+	url_download_h follower = download->followers;
+	url_download_h next = NULL;
+
+	for (; follower != NULL; follower = next) {
+		next = follower->next_follower;
+		if (follower->callback.extracted)
+			follower->callback.extracted(follower, path, size,
+				follower->callback.extracted_user_data);
+	}
+	if (download->callback.extracted)
+		download->callback.extracted(download, path, size,
+			download->callback.extracted_user_data);
+}
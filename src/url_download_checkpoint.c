@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The checkpoint of a partial file, <file>.checkpoint next to it :
+//
+// url-download-checkpoint 1
+// url <url>
+// length <bytes of the file>
+// etag <ETag>                       if the server sent one
+// last-modified <Last-Modified>     if the server sent one
+// mime-type <type>                  if the server sent one
+// range <offset> <end>              one line per range still to download
+//
+// The data before the ranges is on the storage when the checkpoint is
+// written, it replaces the previous one through a temporary file.
+
+#define CHECKPOINT_MAGIC "url-download-checkpoint 1"
+
+static char *_checkpoint_path(const char *path, const char *suffix)
+{
+	char *checkpoint = NULL;
+	size_t size = strlen(path) + strlen(URL_DOWNLOAD_CHECKPOINT_SUFFIX) + 32;
+
+	checkpoint = calloc(size, sizeof(char));
+	if (checkpoint != NULL)
+		snprintf(checkpoint, size, "%s%s%s", path, URL_DOWNLOAD_CHECKPOINT_SUFFIX, suffix);
+	return checkpoint;
+}
+
+// a value of the checkpoint is on one line
+static int _valid_value(const char *value)
+{
+	return (value == NULL || strpbrk(value, "\r\n") == NULL);
+}
+
+static int _read_value(char **field, const char *value)
+{
+	if (*field)
+		free(*field);
+	*field = strdup(value);
+	return (*field ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+void url_download_checkpoint_clear(struct url_download_checkpoint_s *checkpoint)
+{
+	if (checkpoint->url)
+		free(checkpoint->url);
+	if (checkpoint->etag)
+		free(checkpoint->etag);
+	if (checkpoint->last_modified)
+		free(checkpoint->last_modified);
+	if (checkpoint->mime_type)
+		free(checkpoint->mime_type);
+	memset(checkpoint, 0x00, sizeof(struct url_download_checkpoint_s));
+}
+
+// reads the checkpoint of the partial file at path
+int url_download_checkpoint_read(const char *path, struct url_download_checkpoint_s *checkpoint)
+{
+	FILE *file = NULL;
+	char *name = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	long long offset = 0;
+	long long end = 0;
+	int valid = 0;
+	int i = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	memset(checkpoint, 0x00, sizeof(struct url_download_checkpoint_s));
+	name = _checkpoint_path(path, "");
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	file = fopen(name, "re");
+	free(name);
+	if (file == NULL)
+		return URL_DOWNLOAD_ERROR_NO_DATA;
+
+	checkpoint->length = -1;
+	while (errorcode == URL_DOWNLOAD_ERROR_NONE && getline(&line, &size, file) >= 0) {
+		line[strcspn(line, "\n")] = '\0';
+		if (!valid) {
+			valid = (strcmp(line, CHECKPOINT_MAGIC) == 0);
+			if (!valid)
+				break;
+		} else if (strncmp(line, "url ", 4) == 0) {
+			errorcode = _read_value(&checkpoint->url, line + 4);
+		} else if (strncmp(line, "etag ", 5) == 0) {
+			errorcode = _read_value(&checkpoint->etag, line + 5);
+		} else if (strncmp(line, "last-modified ", 14) == 0) {
+			errorcode = _read_value(&checkpoint->last_modified, line + 14);
+		} else if (strncmp(line, "mime-type ", 10) == 0) {
+			errorcode = _read_value(&checkpoint->mime_type, line + 10);
+		} else if (sscanf(line, "length %lld", &checkpoint->length) == 1) {
+			continue;
+		} else if (sscanf(line, "range %lld %lld", &offset, &end) == 2) {
+			if (checkpoint->range_count >= URL_DOWNLOAD_HTTP_MAX_SEGMENTS || offset < 0 || end <= offset) {
+				valid = 0;
+				break;
+			}
+			checkpoint->ranges[checkpoint->range_count][0] = offset;
+			checkpoint->ranges[checkpoint->range_count][1] = end;
+			checkpoint->range_count++;
+		}
+	}
+	if (line)
+		free(line);
+	fclose(file);
+	for (i = 0; i < checkpoint->range_count && valid; i++)
+		valid = (checkpoint->ranges[i][1] <= checkpoint->length);
+
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE && (!valid || checkpoint->url == NULL
+		|| checkpoint->length <= 0 || checkpoint->range_count == 0
+		|| (checkpoint->etag == NULL && checkpoint->last_modified == NULL))) {
+		LOGE("[%s] [%s%s] invalid",__FUNCTION__, path, URL_DOWNLOAD_CHECKPOINT_SUFFIX);
+		errorcode = URL_DOWNLOAD_ERROR_NO_DATA;
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		url_download_checkpoint_clear(checkpoint);
+	return errorcode;
+}
+
+// the checkpoint of the partial file at path replaces the previous one
+int url_download_checkpoint_write(const char *path, struct url_download_checkpoint_s *checkpoint)
+{
+	FILE *file = NULL;
+	char *name = NULL;
+	char *temporary = NULL;
+	char suffix[32] = {0,};
+	int written = 0;
+	int i = 0;
+
+	if (!_valid_value(checkpoint->url) || !_valid_value(checkpoint->etag)
+		|| !_valid_value(checkpoint->last_modified) || !_valid_value(checkpoint->mime_type))
+		return URL_DOWNLOAD_ERROR_INVALID_PARAMETER;
+
+	snprintf(suffix, sizeof(suffix), ".%d.tmp", getpid());
+	name = _checkpoint_path(path, "");
+	temporary = _checkpoint_path(path, suffix);
+	if (name == NULL || temporary == NULL) {
+		if (name)
+			free(name);
+		if (temporary)
+			free(temporary);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	file = fopen(temporary, "we");
+	if (file == NULL) {
+		LOGE("[%s] open [%s] : %s",__FUNCTION__, temporary, strerror(errno));
+	} else {
+		fprintf(file, "%s\nurl %s\nlength %lld\n", CHECKPOINT_MAGIC, checkpoint->url, checkpoint->length);
+		if (checkpoint->etag)
+			fprintf(file, "etag %s\n", checkpoint->etag);
+		if (checkpoint->last_modified)
+			fprintf(file, "last-modified %s\n", checkpoint->last_modified);
+		if (checkpoint->mime_type)
+			fprintf(file, "mime-type %s\n", checkpoint->mime_type);
+		for (i = 0; i < checkpoint->range_count; i++)
+			fprintf(file, "range %lld %lld\n", checkpoint->ranges[i][0], checkpoint->ranges[i][1]);
+		// the checkpoint is not renamed before its data is on the storage
+		written = (fflush(file) == 0 && fdatasync(fileno(file)) == 0);
+		written = (fclose(file) == 0 && written && rename(temporary, name) == 0);
+		if (!written) {
+			LOGE("[%s] write [%s] : %s",__FUNCTION__, name, strerror(errno));
+			unlink(temporary);
+		}
+	}
+	free(name);
+	free(temporary);
+	return (written ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_IO_ERROR);
+}
+
+void url_download_checkpoint_remove(const char *path)
+{
+	char *name = _checkpoint_path(path, "");
+
+	if (name == NULL)
+		return;
+	if (unlink(name) < 0 && errno != ENOENT)
+		LOGE("[%s] unlink [%s] : %s",__FUNCTION__, name, strerror(errno));
+	free(name);
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// A download started with the same URL, destination, file name and
+// HTTP headers as a download in flight does not create a new transfer.
+// It is attached to the running one as a follower and gets its events.
+static int g_download_coalescing = 0;
+static pthread_mutex_t g_download_coalesce_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int _string_equals(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a == b);
+	return (strcmp(a, b) == 0);
+}
+
+static int _compare_field(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void _free_fields(char **fields, int length)
+{
+	int i = 0;
+	if (fields == NULL)
+		return;
+	for (i = 0; i < length; i++) {
+		if (fields[i])
+			free(fields[i]);
+	}
+	free(fields);
+}
+
+static int _headers_equal(url_download_h a, url_download_h b)
+{
+	char **a_fields = NULL;
+	char **b_fields = NULL;
+	int a_length = 0;
+	int b_length = 0;
+	int equal = 0;
+	int i = 0;
+
+	if (url_download_get_all_http_header_fields(a, &a_fields, &a_length) != URL_DOWNLOAD_ERROR_NONE)
+		return 0;
+	if (url_download_get_all_http_header_fields(b, &b_fields, &b_length) != URL_DOWNLOAD_ERROR_NONE) {
+		_free_fields(a_fields, a_length);
+		return 0;
+	}
+
+	if (a_length == b_length) {
+		qsort(a_fields, a_length, sizeof(char *), _compare_field);
+		qsort(b_fields, b_length, sizeof(char *), _compare_field);
+		equal = 1;
+		for (i = 0; i < a_length && equal; i++)
+			equal = _string_equals(a_fields[i], b_fields[i]);
+	}
+
+	_free_fields(a_fields, a_length);
+	_free_fields(b_fields, b_length);
+	return equal;
+}
+
+static int _callback_events(url_download_h download)
+{
+	return (download->callback.started ? URL_DOWNLOAD_EVENT_STARTED : 0)
+		| (download->callback.paused ? URL_DOWNLOAD_EVENT_PAUSED : 0)
+		| (download->callback.completed ? URL_DOWNLOAD_EVENT_COMPLETED : 0)
+		| (download->callback.stopped ? URL_DOWNLOAD_EVENT_STOPPED : 0)
+		| (download->callback.progress ? URL_DOWNLOAD_EVENT_PROGRESS : 0);
+}
+
+static int _same_transfer(url_download_h candidate, url_download_h download)
+{
+	// the content in memory belongs to one handle
+	if (candidate == download || candidate->coalesce_leader != NULL
+		|| download->destination_type != URL_DOWNLOAD_DESTINATION_FILE)
+		return 0;
+	// download-provider does not send the events the transfer did not request
+	if (candidate->sockfd > 0 && (_callback_events(download) & ~candidate->provider_events))
+		return 0;
+	return (_string_equals(candidate->url, download->url)
+		&& candidate->range_offset == download->range_offset
+		&& candidate->range_length == download->range_length
+		&& candidate->range_at_offset == download->range_at_offset
+		&& candidate->digest_type == download->digest_type
+		&& _string_equals(candidate->expected_digest, download->expected_digest)
+		&& _string_equals(candidate->destination, download->destination)
+		&& _string_equals(candidate->file_name, download->file_name)
+		&& _string_equals(candidate->delta_source, download->delta_source)
+		&& _string_equals(candidate->delta_manifest, download->delta_manifest)
+		&& candidate->checkpoint == download->checkpoint
+		&& candidate->atomic_completion == download->atomic_completion
+		&& candidate->archive_extraction == download->archive_extraction
+		&& _headers_equal(candidate, download));
+}
+
+// returns 1 if the download was attached to a transfer in flight.
+int url_download_coalesce_attach(url_download_h download)
+{
+	url_download_h leader = NULL;
+	char *content_name = NULL;
+	char *mime_type = NULL;
+	int started = 0;
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	if (!g_download_coalescing) {
+		pthread_mutex_unlock(&g_download_coalesce_mutex);
+		return 0;
+	}
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+
+	leader = url_download_scheduler_find(_same_transfer, download);
+	if (leader == NULL)
+		return 0;
+
+	LOGI("[%s] slot[%d] attached to slot[%d]",__FUNCTION__, download->slot_index, leader->slot_index);
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	download->coalesce_leader = leader;
+	download->next_follower = leader->followers;
+	leader->followers = download;
+	download->requestid = leader->requestid;
+	download->backend = leader->backend;
+	if (leader->state == URL_DOWNLOAD_STATE_READY)
+		download->state = URL_DOWNLOAD_STATE_DOWNLOADING;
+	else
+		download->state = leader->state;
+	// the started event of the transfer already passed
+	started = leader->started_notified;
+	if (started) {
+		download->file_size = leader->started_file_size;
+		if (leader->started_mime_type)
+			mime_type = strdup(leader->started_mime_type);
+		if (leader->started_content_name)
+			content_name = strdup(leader->started_content_name);
+	}
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+
+	if (started) {
+		if (download->mime_type)
+			free(download->mime_type);
+		download->mime_type = mime_type;
+		if (download->callback.started)
+			download->callback.started(download, content_name,
+				mime_type, download->callback.started_user_data);
+		if (content_name)
+			free(content_name);
+	}
+	return 1;
+}
+
+// the events wanted by the handle and by the handles attached to it, all of
+// them while the coalescing is enabled as handles may attach to it later
+int url_download_coalesce_events(url_download_h download)
+{
+	url_download_h follower = NULL;
+	int events = _callback_events(download);
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	if (g_download_coalescing)
+		events = URL_DOWNLOAD_EVENT_ALL;
+	for (follower = download->followers; follower != NULL; follower = follower->next_follower)
+		events |= _callback_events(follower);
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+	return events;
+}
+
+// called on the event thread of the transfer, which writes the fields of the download
+void url_download_coalesce_record_started(url_download_h download)
+{
+	char *mime_type = (download->mime_type ? strdup(download->mime_type) : NULL);
+	char *content_name = (download->content_name ? strdup(download->content_name) : NULL);
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	if (download->started_mime_type)
+		free(download->started_mime_type);
+	if (download->started_content_name)
+		free(download->started_content_name);
+	download->started_mime_type = mime_type;
+	download->started_content_name = content_name;
+	download->started_file_size = download->file_size;
+	download->started_notified = 1;
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+}
+
+void url_download_coalesce_clear_started(url_download_h download)
+{
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	if (download->started_mime_type)
+		free(download->started_mime_type);
+	if (download->started_content_name)
+		free(download->started_content_name);
+	download->started_mime_type = NULL;
+	download->started_content_name = NULL;
+	download->started_file_size = 0;
+	download->started_notified = 0;
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+}
+
+void url_download_coalesce_detach(url_download_h download)
+{
+	url_download_h *link = NULL;
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	if (download->coalesce_leader != NULL) {
+		for (link = &download->coalesce_leader->followers; *link != NULL;
+				link = &(*link)->next_follower) {
+			if (*link == download) {
+				*link = download->next_follower;
+				break;
+			}
+		}
+		download->coalesce_leader = NULL;
+		download->next_follower = NULL;
+		// the request belongs to the leader
+		download->requestid = 0;
+	}
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+}
+
+// the leader leaves the transfer, the first follower takes it over.
+url_download_h url_download_coalesce_handover(url_download_h leader)
+{
+	url_download_h heir = NULL;
+	url_download_h follower = NULL;
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	heir = leader->followers;
+	if (heir == NULL) {
+		pthread_mutex_unlock(&g_download_coalesce_mutex);
+		return NULL;
+	}
+
+	heir->followers = heir->next_follower;
+	for (follower = heir->followers; follower != NULL; follower = follower->next_follower)
+		follower->coalesce_leader = heir;
+	heir->coalesce_leader = NULL;
+	heir->next_follower = NULL;
+	leader->followers = NULL;
+
+	heir->sockfd = leader->sockfd;
+	heir->provider_events = leader->provider_events;
+	heir->backend = leader->backend;
+	heir->http = leader->http;
+	heir->requestid = leader->requestid;
+	heir->state = leader->state;
+	heir->file_size = leader->file_size;
+	heir->received_size = leader->received_size;
+	heir->throttled = leader->throttled;
+	heir->resume_time = leader->resume_time;
+	if (heir->host)
+		free(heir->host);
+	heir->host = (leader->host ? strdup(leader->host) : NULL);
+	if (heir->started_mime_type)
+		free(heir->started_mime_type);
+	if (heir->started_content_name)
+		free(heir->started_content_name);
+	heir->started_notified = leader->started_notified;
+	heir->started_file_size = leader->started_file_size;
+	heir->started_mime_type = leader->started_mime_type;
+	heir->started_content_name = leader->started_content_name;
+	leader->started_mime_type = NULL;
+	leader->started_content_name = NULL;
+	leader->started_notified = 0;
+	leader->sockfd = 0;
+	leader->http = NULL;
+	leader->requestid = 0;
+	leader->throttled = 0;
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+
+	url_download_scheduler_replace(leader, heir);
+	if (heir->http != NULL)
+		url_download_http_rebind(heir);
+	LOGI("[%s] slot[%d] hands over to slot[%d]",__FUNCTION__, leader->slot_index, heir->slot_index);
+	return heir;
+}
+
+int url_download_set_coalescing(bool enable)
+{
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	g_download_coalescing = (enable ? 1 : 0);
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_coalescing(bool *enable)
+{
+	if (enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_coalesce_mutex);
+	*enable = (g_download_coalescing ? true : false);
+	pthread_mutex_unlock(&g_download_coalesce_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// syncfs()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The atomic completions (see url_download_set_atomic_completion()) : the
+// completed files are flushed to the storage, renamed from their temporary
+// name to their name, then their directories are flushed, by one commit
+// thread. The files completed while a group is committed form the next
+// group : their data is flushed with one syncfs() per file system from
+// URL_DOWNLOAD_COMMIT_SYNCFS_COUNT files, one fdatasync() per file below,
+// and each directory once.
+//
+// Except the commit thread, the functions are called with the lock of the
+// in-process backend held.
+
+struct url_download_commit_s {
+	int fd; /* closed by the commit */
+	char *temporary;
+	char *path;
+	dev_t dev;
+	int error;
+	int renamed;
+	int done;
+	int abandoned; /* the download was stopped, the file is removed */
+	struct url_download_commit_s *next;
+};
+
+static pthread_mutex_t g_commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_commit_cond = PTHREAD_COND_INITIALIZER;
+static struct url_download_commit_s *g_commit_queue = NULL;
+static int g_commit_count = 0;
+static int g_commit_notify[2] = {-1, -1};
+static int g_commit_started = 0;
+
+static int _sync_error(const char *function, const char *path)
+{
+	LOGE("[%s] sync [%s] : %s",function, path, strerror(errno));
+	return (errno == ENOSPC ? URL_DOWNLOAD_ERROR_NO_SPACE : URL_DOWNLOAD_ERROR_IO_ERROR);
+}
+
+// the data of the files, one syncfs() per file system for a large group
+static void _sync_data(struct url_download_commit_s *group, int count)
+{
+	struct url_download_commit_s *commit = NULL;
+	struct url_download_commit_s *other = NULL;
+	int synced = 0;
+
+	for (commit = group; commit != NULL; commit = commit->next) {
+		if (count >= URL_DOWNLOAD_COMMIT_SYNCFS_COUNT) {
+			// the first file of its file system
+			for (other = group; other != commit && other->dev != commit->dev; other = other->next)
+				;
+			if (other != commit) {
+				commit->error = other->error;
+				continue;
+			}
+			synced = (syncfs(commit->fd) == 0);
+		} else {
+			synced = (fdatasync(commit->fd) == 0);
+		}
+		if (!synced)
+			commit->error = _sync_error(__FUNCTION__, commit->temporary);
+	}
+}
+
+// the renames are on the storage when their directories are
+static void _sync_directories(struct url_download_commit_s *group)
+{
+	struct url_download_commit_s *commit = NULL;
+	struct url_download_commit_s *other = NULL;
+	char *directory = NULL;
+	char *other_directory = NULL;
+	int fd = -1;
+	int same = 0;
+
+	for (commit = group; commit != NULL; commit = commit->next) {
+		if (commit->error != URL_DOWNLOAD_ERROR_NONE || (directory = strdup(commit->path)) == NULL)
+			continue;
+		// one fsync() per directory
+		same = 0;
+		for (other = group; other != commit && !same; other = other->next) {
+			if (other->error != URL_DOWNLOAD_ERROR_NONE || (other_directory = strdup(other->path)) == NULL)
+				continue;
+			same = (strcmp(dirname(directory), dirname(other_directory)) == 0);
+			free(other_directory);
+			strcpy(directory, commit->path);
+		}
+		if (!same) {
+			fd = open(dirname(directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (fd < 0 || fsync(fd) < 0)
+				commit->error = _sync_error(__FUNCTION__, directory);
+			if (fd >= 0)
+				close(fd);
+		}
+		free(directory);
+	}
+}
+
+static void _commit_group(struct url_download_commit_s *group, int count)
+{
+	struct url_download_commit_s *commit = NULL;
+
+	_sync_data(group, count);
+	for (commit = group; commit != NULL; commit = commit->next) {
+		if (commit->error != URL_DOWNLOAD_ERROR_NONE)
+			continue;
+		commit->renamed = (rename(commit->temporary, commit->path) == 0);
+		if (!commit->renamed) {
+			LOGE("[%s] rename [%s] : %s",__FUNCTION__, commit->path, strerror(errno));
+			commit->error = URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+	}
+	_sync_directories(group);
+	// the file of a failed commit keeps its temporary name
+	for (commit = group; commit != NULL; commit = commit->next) {
+		if (commit->error != URL_DOWNLOAD_ERROR_NONE && commit->renamed
+			&& rename(commit->path, commit->temporary) == 0)
+			commit->renamed = 0;
+	}
+	LOGI("[%s] [%d] files committed",__FUNCTION__, count);
+}
+
+static void *_run_commit(void *args)
+{
+	struct url_download_commit_s *group = NULL;
+	struct url_download_commit_s *commit = NULL;
+	struct url_download_commit_s *next = NULL;
+	int count = 0;
+
+	pthread_mutex_lock(&g_commit_mutex);
+	while (1) {
+		while (g_commit_queue == NULL)
+			pthread_cond_wait(&g_commit_cond, &g_commit_mutex);
+		group = g_commit_queue;
+		count = g_commit_count;
+		g_commit_queue = NULL;
+		g_commit_count = 0;
+		pthread_mutex_unlock(&g_commit_mutex);
+
+		_commit_group(group, count);
+
+		pthread_mutex_lock(&g_commit_mutex);
+		for (commit = group; commit != NULL; commit = next) {
+			next = commit->next;
+			close(commit->fd);
+			commit->fd = -1;
+			commit->done = 1;
+			if (commit->abandoned) {
+				unlink(commit->renamed ? commit->path : commit->temporary);
+				url_download_commit_free(commit);
+			}
+		}
+		if (write(g_commit_notify[1], "c", 1) < 0 && errno != EAGAIN)
+			LOGE("[%s] notify : %s",__FUNCTION__, strerror(errno));
+	}
+	return 0;
+}
+
+static int _commit_start()
+{
+	pthread_attr_t thread_attr;
+	pthread_t thread_pid;
+
+	if (g_commit_started)
+		return URL_DOWNLOAD_ERROR_NONE;
+	if (pipe(g_commit_notify) < 0) {
+		LOGE("[%s]pipe system error : %s",__FUNCTION__,strerror(errno));
+		g_commit_notify[0] = g_commit_notify[1] = -1;
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	fcntl(g_commit_notify[0], F_SETFL, O_NONBLOCK);
+	fcntl(g_commit_notify[1], F_SETFL, O_NONBLOCK);
+	fcntl(g_commit_notify[0], F_SETFD, FD_CLOEXEC);
+	fcntl(g_commit_notify[1], F_SETFD, FD_CLOEXEC);
+
+	if (pthread_attr_init(&thread_attr) != 0)
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread_pid, &thread_attr, _run_commit, NULL) != 0) {
+		LOGE("[%s][%d] pthread_create : %s",__FUNCTION__, __LINE__,strerror(errno));
+		pthread_attr_destroy(&thread_attr);
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	pthread_attr_destroy(&thread_attr);
+	g_commit_started = 1;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// readable when commits are done, -1 before the first one
+int url_download_commit_fd()
+{
+	return g_commit_notify[0];
+}
+
+// the completed file written to temporary is committed to path, the commit owns fd
+struct url_download_commit_s *url_download_commit_submit(int fd, const char *temporary, const char *path)
+{
+	struct url_download_commit_s *commit = NULL;
+	struct stat st;
+
+	if (_commit_start() != URL_DOWNLOAD_ERROR_NONE)
+		return NULL;
+	commit = calloc(1, sizeof(struct url_download_commit_s));
+	if (commit == NULL)
+		return NULL;
+	commit->temporary = strdup(temporary);
+	commit->path = strdup(path);
+	if (commit->temporary == NULL || commit->path == NULL) {
+		if (commit->temporary)
+			free(commit->temporary);
+		if (commit->path)
+			free(commit->path);
+		free(commit);
+		return NULL;
+	}
+	commit->fd = fd;
+	if (fstat(fd, &st) == 0)
+		commit->dev = st.st_dev;
+
+	pthread_mutex_lock(&g_commit_mutex);
+	commit->next = g_commit_queue;
+	g_commit_queue = commit;
+	g_commit_count++;
+	pthread_cond_signal(&g_commit_cond);
+	pthread_mutex_unlock(&g_commit_mutex);
+	return commit;
+}
+
+void url_download_commit_reap()
+{
+	char drain[64];
+
+	if (g_commit_notify[0] < 0)
+		return;
+	while (read(g_commit_notify[0], drain, sizeof(drain)) > 0)
+		;
+}
+
+// returns 1 when the commit is done, with its error
+int url_download_commit_done(struct url_download_commit_s *commit, int *error)
+{
+	int done = 0;
+
+	pthread_mutex_lock(&g_commit_mutex);
+	done = commit->done;
+	*error = commit->error;
+	pthread_mutex_unlock(&g_commit_mutex);
+	return done;
+}
+
+void url_download_commit_free(struct url_download_commit_s *commit)
+{
+	free(commit->temporary);
+	free(commit->path);
+	free(commit);
+}
+
+// the file of the commit is removed, when it is done for a commit in progress
+void url_download_commit_abandon(struct url_download_commit_s *commit)
+{
+	pthread_mutex_lock(&g_commit_mutex);
+	if (!commit->done) {
+		commit->abandoned = 1;
+		pthread_mutex_unlock(&g_commit_mutex);
+		return;
+	}
+	pthread_mutex_unlock(&g_commit_mutex);
+	unlink(commit->renamed ? commit->path : commit->temporary);
+	url_download_commit_free(commit);
+}
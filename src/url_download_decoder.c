@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+#ifdef URL_DOWNLOAD_ZSTD
+#include <zstd.h>
+#endif
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The content codings of the responses, decoded by the in-process backend
+// while the body streams to the file.
+// REF : http://tools.ietf.org/html/rfc2616#section-3.5
+
+typedef enum {
+	DECODER_GZIP,
+	DECODER_DEFLATE,
+	DECODER_ZSTD,
+} decoder_type_e;
+
+struct url_download_decoder_s {
+	decoder_type_e type;
+	z_stream zlib;
+	int raw; /* a deflate body without the zlib wrapper */
+#ifdef URL_DOWNLOAD_ZSTD
+	ZSTD_DStream *zstd;
+#endif
+};
+
+// the value of Accept-Encoding
+const char *url_download_decoder_accept()
+{
+#ifdef URL_DOWNLOAD_ZSTD
+	return "gzip, deflate, zstd";
+#else
+	return "gzip, deflate";
+#endif
+}
+
+// returns NULL if the coding is not supported
+struct url_download_decoder_s *url_download_decoder_new(const char *content_encoding)
+{
+	struct url_download_decoder_s *decoder = NULL;
+	decoder_type_e type = DECODER_GZIP;
+
+	if (strcasecmp(content_encoding, "gzip") == 0 || strcasecmp(content_encoding, "x-gzip") == 0)
+		type = DECODER_GZIP;
+	else if (strcasecmp(content_encoding, "deflate") == 0)
+		type = DECODER_DEFLATE;
+#ifdef URL_DOWNLOAD_ZSTD
+	else if (strcasecmp(content_encoding, "zstd") == 0)
+		type = DECODER_ZSTD;
+#endif
+	else
+		return NULL;
+
+	decoder = calloc(1, sizeof(struct url_download_decoder_s));
+	if (decoder == NULL)
+		return NULL;
+	decoder->type = type;
+
+#ifdef URL_DOWNLOAD_ZSTD
+	if (type == DECODER_ZSTD) {
+		decoder->zstd = ZSTD_createDStream();
+		if (decoder->zstd == NULL || ZSTD_isError(ZSTD_initDStream(decoder->zstd))) {
+			url_download_decoder_free(decoder);
+			return NULL;
+		}
+		return decoder;
+	}
+#endif
+	// 32 : the gzip or zlib header is detected
+	if (inflateInit2(&decoder->zlib, type == DECODER_GZIP ? 15 + 16 : 15 + 32) != Z_OK) {
+		free(decoder);
+		return NULL;
+	}
+	return decoder;
+}
+
+void url_download_decoder_free(struct url_download_decoder_s *decoder)
+{
+	if (decoder == NULL)
+		return;
+#ifdef URL_DOWNLOAD_ZSTD
+	if (decoder->type == DECODER_ZSTD) {
+		if (decoder->zstd)
+			ZSTD_freeDStream(decoder->zstd);
+		free(decoder);
+		return;
+	}
+#endif
+	inflateEnd(&decoder->zlib);
+	free(decoder);
+}
+
+static int _inflate(struct url_download_decoder_s *decoder, const char **data, size_t *length,
+		char *out, size_t size, size_t *produced, int *finished)
+{
+	uLong consumed = decoder->zlib.total_in;
+	int ret = Z_OK;
+
+	decoder->zlib.next_in = (Bytef *)*data;
+	decoder->zlib.avail_in = *length;
+	decoder->zlib.next_out = (Bytef *)out;
+	decoder->zlib.avail_out = size;
+
+	ret = inflate(&decoder->zlib, Z_NO_FLUSH);
+	if (ret == Z_DATA_ERROR && decoder->type == DECODER_DEFLATE && !decoder->raw && consumed == 0) {
+		// some servers send the deflate data without the zlib header
+		LOGI("[%s] raw deflate body",__FUNCTION__);
+		decoder->raw = 1;
+		inflateEnd(&decoder->zlib);
+		memset(&decoder->zlib, 0x00, sizeof(z_stream));
+		if (inflateInit2(&decoder->zlib, -15) != Z_OK)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		return _inflate(decoder, data, length, out, size, produced, finished);
+	}
+
+	*produced = size - decoder->zlib.avail_out;
+	*data += *length - decoder->zlib.avail_in;
+	*length = decoder->zlib.avail_in;
+
+	switch (ret) {
+	case Z_STREAM_END:
+		// the members of a gzip file follow each other
+		if (decoder->type == DECODER_GZIP && *length > 0 && (unsigned char)**data == 0x1f) {
+			inflateReset(&decoder->zlib);
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+		*finished = 1;
+		*length = 0;
+		return URL_DOWNLOAD_ERROR_NONE;
+	case Z_OK:
+	case Z_BUF_ERROR:
+		return URL_DOWNLOAD_ERROR_NONE;
+	case Z_MEM_ERROR:
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	default:
+		LOGE("[%s] inflate : %s",__FUNCTION__, decoder->zlib.msg ? decoder->zlib.msg : "error");
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+}
+
+#ifdef URL_DOWNLOAD_ZSTD
+static int _zstd_decompress(struct url_download_decoder_s *decoder, const char **data, size_t *length,
+		char *out, size_t size, size_t *produced, int *finished)
+{
+	ZSTD_inBuffer in = { *data, *length, 0 };
+	ZSTD_outBuffer output = { out, size, 0 };
+	size_t ret = 0;
+
+	ret = ZSTD_decompressStream(decoder->zstd, &output, &in);
+	*produced = output.pos;
+	*data += in.pos;
+	*length -= in.pos;
+	if (ZSTD_isError(ret)) {
+		LOGE("[%s] ZSTD_decompressStream : %s",__FUNCTION__, ZSTD_getErrorName(ret));
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	// the end of a frame, another one may follow
+	if (ret == 0 && *length == 0)
+		*finished = 1;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+#endif
+
+// decodes a part of the body into out, the bytes consumed are removed from data.
+// called again with the rest while the output is full. finished is set at the end of the coding.
+int url_download_decoder_run(struct url_download_decoder_s *decoder, const char **data, size_t *length,
+		char *out, size_t size, size_t *produced, int *finished)
+{
+	*produced = 0;
+	*finished = 0;
+#ifdef URL_DOWNLOAD_ZSTD
+	if (decoder->type == DECODER_ZSTD)
+		return _zstd_decompress(decoder, data, length, out, size, produced, finished);
+#endif
+	return _inflate(decoder, data, length, out, size, produced, finished);
+}
@@ -0,0 +1,442 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The delta downloads : the blocks of the new file found in the old file
+// are copied from it, the other ones are fetched with range requests.
+//
+// The block manifest describes the new file (see url_download_set_delta_source()) :
+//
+// url-download-blocks 1
+// length <bytes of the file>
+// block-size <bytes of a block>
+// sha256 <digest of the file>
+// <weak checksum> <strong checksum>     one line per block
+//
+// The weak checksum is the rolling checksum of rsync, in 8 hexadecimal
+// digits : a = sum of the bytes, b = sum of (block-size - i) * byte i, both
+// modulo 65536, weak = a + 65536 * b. The strong checksum is the first 32
+// hexadecimal digits of the SHA-256 of the block. The old file is scanned
+// for the blocks at every offset, the weak checksum rolled byte by byte.
+
+#define DELTA_MAGIC "url-download-blocks 1"
+#define DELTA_STRONG_LENGTH 32
+#define DELTA_MIN_BLOCK_SIZE 512
+#define DELTA_MAX_BLOCK_SIZE (16 * 1024 * 1024)
+
+struct url_download_delta_block_s {
+	uint32_t weak;
+	char strong[DELTA_STRONG_LENGTH + 1];
+	long long source; /* offset of the block in the old file, -1 if it is fetched */
+	int next; /* next block of the same bucket, -1 at the end */
+};
+
+struct url_download_delta_s {
+	long long length;
+	long long block_size;
+	int block_count;
+	char digest[65];
+	struct url_download_delta_block_s *blocks;
+	int *buckets;
+	uint32_t bucket_mask;
+	char *buffer; /* a slice of the old file and the window across its end */
+	long long scan_offset; /* the next window of the old file */
+	long long matched; /* bytes of the new file found in the old file */
+	int copy_block; /* the next block to copy */
+	int fetch_block; /* the next block to fetch */
+};
+
+static uint32_t _weak_checksum(const unsigned char *data, long long length)
+{
+	uint32_t a = 0;
+	uint32_t b = 0;
+	long long i = 0;
+
+	for (i = 0; i < length; i++) {
+		a += data[i];
+		b += (uint32_t)(length - i) * data[i];
+	}
+	return (a & 0xffff) | ((b & 0xffff) << 16);
+}
+
+// the checksum of the window moved by one byte, out leaves it and in enters it
+static uint32_t _roll_checksum(uint32_t weak, long long length, unsigned char out, unsigned char in)
+{
+	uint32_t a = weak & 0xffff;
+	uint32_t b = weak >> 16;
+
+	a = (a - out + in) & 0xffff;
+	b = (b - (uint32_t)length * out + a) & 0xffff;
+	return a | (b << 16);
+}
+
+static long long _block_length(struct url_download_delta_s *delta, int index)
+{
+	long long offset = (long long)index * delta->block_size;
+
+	return (delta->length - offset < delta->block_size ? delta->length - offset : delta->block_size);
+}
+
+static int _strong_checksum(const unsigned char *data, long long length, char *strong)
+{
+	struct url_download_digest_s *digest = NULL;
+	char *hex = NULL;
+
+	digest = url_download_digest_new(URL_DOWNLOAD_DIGEST_SHA256);
+	if (digest == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	url_download_digest_update(digest, data, length);
+	hex = url_download_digest_final(digest);
+	url_download_digest_free(digest);
+	if (hex == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	memcpy(strong, hex, DELTA_STRONG_LENGTH);
+	strong[DELTA_STRONG_LENGTH] = '\0';
+	free(hex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the next line of the manifest, NULL at its end
+static char *_next_line(char **next, char *end)
+{
+	char *line = *next;
+	char *newline = NULL;
+
+	if (line >= end)
+		return NULL;
+	newline = memchr(line, '\n', end - line);
+	if (newline == NULL)
+		newline = end;
+	*newline = '\0';
+	if (newline > line && *(newline - 1) == '\r')
+		*(newline - 1) = '\0';
+	*next = newline + 1;
+	return line;
+}
+
+static int _is_hex(const char *value, size_t length)
+{
+	return (strlen(value) == length && strspn(value, "0123456789abcdef") == length);
+}
+
+static int _parse_header(struct url_download_delta_s *delta, char **next, char *end)
+{
+	char *line = NULL;
+
+	line = _next_line(next, end);
+	if (line == NULL || strcmp(line, DELTA_MAGIC) != 0)
+		return -1;
+	line = _next_line(next, end);
+	if (line == NULL || sscanf(line, "length %lld", &delta->length) != 1 || delta->length < 0)
+		return -1;
+	line = _next_line(next, end);
+	if (line == NULL || sscanf(line, "block-size %lld", &delta->block_size) != 1
+		|| delta->block_size < DELTA_MIN_BLOCK_SIZE || delta->block_size > DELTA_MAX_BLOCK_SIZE)
+		return -1;
+	line = _next_line(next, end);
+	if (line == NULL || strncmp(line, "sha256 ", 7) != 0 || !_is_hex(line + 7, 64))
+		return -1;
+	strcpy(delta->digest, line + 7);
+	if ((delta->length + delta->block_size - 1) / delta->block_size > 0x7fffffff)
+		return -1;
+	delta->block_count = (delta->length + delta->block_size - 1) / delta->block_size;
+	return 0;
+}
+
+static int _parse_blocks(struct url_download_delta_s *delta, char **next, char *end)
+{
+	struct url_download_delta_block_s *block = NULL;
+	char *line = NULL;
+	char weak[16] = {0,};
+	char strong[DELTA_STRONG_LENGTH + 8] = {0,};
+	uint32_t bucket = 0;
+	int i = 0;
+
+	for (i = 0; i < delta->block_count; i++) {
+		line = _next_line(next, end);
+		if (line == NULL || strlen(line) != 8 + 1 + DELTA_STRONG_LENGTH
+			|| sscanf(line, "%15s %39s", weak, strong) != 2
+			|| !_is_hex(weak, 8) || !_is_hex(strong, DELTA_STRONG_LENGTH))
+			return -1;
+		block = &delta->blocks[i];
+		block->weak = strtoul(weak, NULL, 16);
+		strcpy(block->strong, strong);
+		block->source = -1;
+		// the last block, if it is shorter, is always fetched
+		block->next = -1;
+		if (_block_length(delta, i) < delta->block_size)
+			continue;
+		bucket = block->weak & delta->bucket_mask;
+		block->next = delta->buckets[bucket];
+		delta->buckets[bucket] = i;
+	}
+	return 0;
+}
+
+// returns the delta of the manifest, NULL if it is not valid
+struct url_download_delta_s *url_download_delta_new(char *manifest, size_t length)
+{
+	struct url_download_delta_s *delta = NULL;
+	char *next = manifest;
+	char *end = manifest + length;
+	uint32_t size = 1;
+	int i = 0;
+
+	delta = calloc(1, sizeof(struct url_download_delta_s));
+	if (delta == NULL)
+		return NULL;
+	if (_parse_header(delta, &next, end) < 0) {
+		LOGE("[%s] invalid header",__FUNCTION__);
+		free(delta);
+		return NULL;
+	}
+	while (size < 0x40000000 && size < (uint32_t)delta->block_count * 2)
+		size <<= 1;
+	delta->bucket_mask = size - 1;
+	delta->blocks = calloc(delta->block_count + 1, sizeof(struct url_download_delta_block_s));
+	delta->buckets = malloc(size * sizeof(int));
+	delta->buffer = malloc(URL_DOWNLOAD_DELTA_SLICE_SIZE + delta->block_size);
+	if (delta->blocks == NULL || delta->buckets == NULL || delta->buffer == NULL) {
+		url_download_delta_free(delta);
+		return NULL;
+	}
+	for (i = 0; i < (int)size; i++)
+		delta->buckets[i] = -1;
+	if (_parse_blocks(delta, &next, end) < 0) {
+		LOGE("[%s] invalid block",__FUNCTION__);
+		url_download_delta_free(delta);
+		return NULL;
+	}
+	return delta;
+}
+
+void url_download_delta_free(struct url_download_delta_s *delta)
+{
+	if (delta == NULL)
+		return;
+	if (delta->blocks)
+		free(delta->blocks);
+	if (delta->buckets)
+		free(delta->buckets);
+	if (delta->buffer)
+		free(delta->buffer);
+	free(delta);
+}
+
+long long url_download_delta_length(struct url_download_delta_s *delta)
+{
+	return delta->length;
+}
+
+const char *url_download_delta_digest(struct url_download_delta_s *delta)
+{
+	return delta->digest;
+}
+
+long long url_download_delta_matched(struct url_download_delta_s *delta)
+{
+	return delta->matched;
+}
+
+// the blocks of the window at offset of the old file, returns 1 if there is one
+static int _match(struct url_download_delta_s *delta, uint32_t weak,
+		const unsigned char *window, long long offset, int *errorcode)
+{
+	char strong[DELTA_STRONG_LENGTH + 1] = {0,};
+	int computed = 0;
+	int found = 0;
+	int i = 0;
+
+	for (i = delta->buckets[weak & delta->bucket_mask]; i >= 0; i = delta->blocks[i].next) {
+		if (delta->blocks[i].weak != weak)
+			continue;
+		if (!computed) {
+			*errorcode = _strong_checksum(window, delta->block_size, strong);
+			if (*errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return 0;
+			computed = 1;
+		}
+		if (strcmp(delta->blocks[i].strong, strong) != 0)
+			continue;
+		found = 1;
+		// the same content may be at several blocks of the new file
+		if (delta->blocks[i].source < 0) {
+			delta->blocks[i].source = offset;
+			delta->matched += delta->block_size;
+		}
+	}
+	return found;
+}
+
+// the blocks of a run of the new file shorter than this between two fetched
+// ranges are fetched with them, the run is not worth its own request.
+static void _merge_ranges(struct url_download_delta_s *delta)
+{
+	int run = 0;
+	int i = 0;
+	int j = 0;
+
+	for (i = 0; i < delta->block_count; i++) {
+		if (delta->blocks[i].source < 0)
+			continue;
+		for (run = i; run < delta->block_count && delta->blocks[run].source >= 0; run++)
+			;
+		if (i > 0 && run < delta->block_count
+			&& (run - i) * delta->block_size < URL_DOWNLOAD_DELTA_MERGE_GAP) {
+			for (j = i; j < run; j++) {
+				delta->blocks[j].source = -1;
+				delta->matched -= delta->block_size;
+			}
+		}
+		i = run;
+	}
+}
+
+// scans a slice of the old file for the blocks of the new file,
+// done is set once the old file is scanned.
+int url_download_delta_scan(struct url_download_delta_s *delta, int fd, int *done)
+{
+	unsigned char *buffer = (unsigned char *)delta->buffer;
+	long long size = URL_DOWNLOAD_DELTA_SLICE_SIZE + delta->block_size - 1;
+	long long length = 0;
+	long long limit = 0;
+	long long position = 0;
+	ssize_t count = 0;
+	uint32_t weak = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	*done = 0;
+	while (length < size) {
+		count = pread(fd, buffer + length, size - length, delta->scan_offset + length);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0) {
+			LOGE("[%s] pread : %s",__FUNCTION__, strerror(errno));
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+		if (count == 0)
+			break;
+		length += count;
+	}
+
+	// the windows starting in the slice
+	limit = length - delta->block_size + 1;
+	if (limit > URL_DOWNLOAD_DELTA_SLICE_SIZE)
+		limit = URL_DOWNLOAD_DELTA_SLICE_SIZE;
+	if (limit > 0)
+		weak = _weak_checksum(buffer, delta->block_size);
+	while (position < limit) {
+		if (_match(delta, weak, buffer + position, delta->scan_offset + position, &errorcode)) {
+			// the next window after the block found
+			position += delta->block_size;
+			if (position < limit)
+				weak = _weak_checksum(buffer + position, delta->block_size);
+			continue;
+		}
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		if (position + 1 < limit)
+			weak = _roll_checksum(weak, delta->block_size, buffer[position],
+				buffer[position + delta->block_size]);
+		position++;
+	}
+
+	delta->scan_offset += (position > 0 ? position : length);
+	if (length < size) {
+		_merge_ranges(delta);
+		*done = 1;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// copies a slice of the blocks found in the old file to their offset of the new file,
+// done is set once they are all copied.
+int url_download_delta_copy(struct url_download_delta_s *delta, int in, int out, size_t *copied, int *done)
+{
+	long long source = 0;
+	long long target = 0;
+	long long length = 0;
+	size_t count = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	*copied = 0;
+	*done = 0;
+	while (*copied < URL_DOWNLOAD_DELTA_SLICE_SIZE) {
+		while (delta->copy_block < delta->block_count && delta->blocks[delta->copy_block].source < 0)
+			delta->copy_block++;
+		if (delta->copy_block >= delta->block_count) {
+			*done = 1;
+			break;
+		}
+		// the blocks which follow each other in both files are copied at once
+		i = delta->copy_block;
+		source = delta->blocks[i].source;
+		target = (long long)i * delta->block_size;
+		for (length = 0; i < delta->block_count && delta->blocks[i].source == source + length
+			&& *copied + length < URL_DOWNLOAD_DELTA_SLICE_SIZE; i++)
+			length += delta->block_size;
+		while (length > 0) {
+			errorcode = url_download_local_copy_range(in, source, out, target, length, &count);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+			// the old file was truncated in the meantime
+			if (count == 0)
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			source += count;
+			target += count;
+			length -= count;
+			*copied += count;
+		}
+		delta->copy_block = i;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// gets the next range [start, end) of the new file to fetch, returns 0 if there is none left
+int url_download_delta_next_range(struct url_download_delta_s *delta, long long *start, long long *end)
+{
+	int i = delta->fetch_block;
+
+	while (i < delta->block_count && delta->blocks[i].source >= 0)
+		i++;
+	if (i >= delta->block_count) {
+		delta->fetch_block = i;
+		return 0;
+	}
+	*start = (long long)i * delta->block_size;
+	while (i < delta->block_count && delta->blocks[i].source < 0)
+		i++;
+	*end = (i < delta->block_count ? (long long)i * delta->block_size : delta->length);
+	delta->fetch_block = i;
+	return 1;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The digests of the downloaded files, computed while the data goes to
+// the files. SHA-1 and SHA-256 are the ones of OpenSSL, which uses the
+// SHA extensions of the CPU. CRC32C uses the crc32 instructions of SSE4.2
+// or ARMv8 when they are available.
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+struct url_download_digest_s {
+	url_download_digest_e type;
+	EVP_MD_CTX *md; /* SHA-1, SHA-256 */
+	uint32_t crc;
+	uint64_t xxh[4];
+	unsigned char xxh_buffer[32];
+	size_t xxh_buffered;
+	unsigned long long length;
+};
+
+static uint32_t g_crc32c_table[8][256];
+static pthread_once_t g_crc32c_once = PTHREAD_ONCE_INIT;
+static int g_crc32c_hardware = 0;
+
+static void _crc32c_init()
+{
+	uint32_t crc = 0;
+	int i = 0;
+	int j = 0;
+
+	// REF : http://tools.ietf.org/html/rfc3720#appendix-B.4 (reflected 0x1EDC6F41)
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78 : 0);
+		g_crc32c_table[0][i] = crc;
+	}
+	// slicing-by-8 : the tables of the next bytes
+	for (i = 0; i < 256; i++) {
+		for (j = 1; j < 8; j++)
+			g_crc32c_table[j][i] = (g_crc32c_table[j - 1][i] >> 8)
+				^ g_crc32c_table[0][g_crc32c_table[j - 1][i] & 0xff];
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	g_crc32c_hardware = (__builtin_cpu_supports("sse4.2") != 0);
+#elif defined(__ARM_FEATURE_CRC32)
+	g_crc32c_hardware = 1;
+#endif
+	LOGI("[%s] crc32c instructions [%d]",__FUNCTION__, g_crc32c_hardware);
+}
+
+static uint32_t _crc32c_table(uint32_t crc, const unsigned char *data, size_t length)
+{
+	uint32_t low = 0;
+	uint32_t high = 0;
+
+	while (length >= 8) {
+		memcpy(&low, data, 4);
+		memcpy(&high, data + 4, 4);
+		low ^= crc;
+		crc = g_crc32c_table[7][low & 0xff] ^ g_crc32c_table[6][(low >> 8) & 0xff]
+			^ g_crc32c_table[5][(low >> 16) & 0xff] ^ g_crc32c_table[4][low >> 24]
+			^ g_crc32c_table[3][high & 0xff] ^ g_crc32c_table[2][(high >> 8) & 0xff]
+			^ g_crc32c_table[1][(high >> 16) & 0xff] ^ g_crc32c_table[0][high >> 24];
+		data += 8;
+		length -= 8;
+	}
+	while (length-- > 0)
+		crc = (crc >> 8) ^ g_crc32c_table[0][(crc ^ *data++) & 0xff];
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t _crc32c_hardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+	uint64_t crc64 = crc;
+	uint64_t value = 0;
+
+	while (length >= 8) {
+		memcpy(&value, data, 8);
+		crc64 = _mm_crc32_u64(crc64, value);
+		data += 8;
+		length -= 8;
+	}
+	crc = (uint32_t)crc64;
+	while (length-- > 0)
+		crc = _mm_crc32_u8(crc, *data++);
+	return crc;
+}
+#elif defined(__i386__)
+__attribute__((target("sse4.2")))
+static uint32_t _crc32c_hardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+	uint32_t value = 0;
+
+	while (length >= 4) {
+		memcpy(&value, data, 4);
+		crc = _mm_crc32_u32(crc, value);
+		data += 4;
+		length -= 4;
+	}
+	while (length-- > 0)
+		crc = _mm_crc32_u8(crc, *data++);
+	return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t _crc32c_hardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+#if defined(__aarch64__)
+	uint64_t value = 0;
+
+	while (length >= 8) {
+		memcpy(&value, data, 8);
+		crc = __crc32cd(crc, value);
+		data += 8;
+		length -= 8;
+	}
+#endif
+	while (length-- > 0)
+		crc = __crc32cb(crc, *data++);
+	return crc;
+}
+#else
+static uint32_t _crc32c_hardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+	return _crc32c_table(crc, data, length);
+}
+#endif
+
+static uint64_t _rotl64(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// little endian whatever the CPU
+static uint64_t _read64(const unsigned char *data)
+{
+	uint64_t value = 0;
+
+	memcpy(&value, data, sizeof(value));
+	return le64toh(value);
+}
+
+static uint64_t _xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = _rotl64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static uint64_t _xxh64_merge(uint64_t acc, uint64_t value)
+{
+	acc ^= _xxh64_round(0, value);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// REF : https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md (XXH64, seed 0)
+static void _xxh64_update(struct url_download_digest_s *digest, const unsigned char *data, size_t length)
+{
+	uint64_t *v = digest->xxh;
+	size_t count = 0;
+
+	if (digest->xxh_buffered > 0) {
+		count = 32 - digest->xxh_buffered;
+		if (count > length)
+			count = length;
+		memcpy(digest->xxh_buffer + digest->xxh_buffered, data, count);
+		digest->xxh_buffered += count;
+		data += count;
+		length -= count;
+		if (digest->xxh_buffered < 32)
+			return;
+		v[0] = _xxh64_round(v[0], _read64(digest->xxh_buffer));
+		v[1] = _xxh64_round(v[1], _read64(digest->xxh_buffer + 8));
+		v[2] = _xxh64_round(v[2], _read64(digest->xxh_buffer + 16));
+		v[3] = _xxh64_round(v[3], _read64(digest->xxh_buffer + 24));
+		digest->xxh_buffered = 0;
+	}
+	while (length >= 32) {
+		v[0] = _xxh64_round(v[0], _read64(data));
+		v[1] = _xxh64_round(v[1], _read64(data + 8));
+		v[2] = _xxh64_round(v[2], _read64(data + 16));
+		v[3] = _xxh64_round(v[3], _read64(data + 24));
+		data += 32;
+		length -= 32;
+	}
+	memcpy(digest->xxh_buffer, data, length);
+	digest->xxh_buffered = length;
+}
+
+static uint64_t _xxh64_final(struct url_download_digest_s *digest)
+{
+	const unsigned char *data = digest->xxh_buffer;
+	size_t length = digest->xxh_buffered;
+	uint64_t *v = digest->xxh;
+	uint64_t hash = 0;
+	uint32_t value = 0;
+
+	if (digest->length >= 32) {
+		hash = _rotl64(v[0], 1) + _rotl64(v[1], 7) + _rotl64(v[2], 12) + _rotl64(v[3], 18);
+		hash = _xxh64_merge(hash, v[0]);
+		hash = _xxh64_merge(hash, v[1]);
+		hash = _xxh64_merge(hash, v[2]);
+		hash = _xxh64_merge(hash, v[3]);
+	} else {
+		hash = XXH_PRIME64_5;
+	}
+	hash += digest->length;
+
+	while (length >= 8) {
+		hash ^= _xxh64_round(0, _read64(data));
+		hash = _rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		data += 8;
+		length -= 8;
+	}
+	if (length >= 4) {
+		value = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+		hash ^= value * XXH_PRIME64_1;
+		hash = _rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		data += 4;
+		length -= 4;
+	}
+	while (length-- > 0) {
+		hash ^= (*data++) * XXH_PRIME64_5;
+		hash = _rotl64(hash, 11) * XXH_PRIME64_1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= XXH_PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= XXH_PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+struct url_download_digest_s *url_download_digest_new(url_download_digest_e type)
+{
+	struct url_download_digest_s *digest = NULL;
+	const EVP_MD *md = NULL;
+
+	digest = calloc(1, sizeof(struct url_download_digest_s));
+	if (digest == NULL)
+		return NULL;
+	digest->type = type;
+
+	switch (type) {
+	case URL_DOWNLOAD_DIGEST_SHA256:
+	case URL_DOWNLOAD_DIGEST_SHA1:
+		md = (type == URL_DOWNLOAD_DIGEST_SHA256 ? EVP_sha256() : EVP_sha1());
+		digest->md = EVP_MD_CTX_new();
+		if (digest->md == NULL || EVP_DigestInit_ex(digest->md, md, NULL) != 1) {
+			url_download_digest_free(digest);
+			return NULL;
+		}
+		break;
+	case URL_DOWNLOAD_DIGEST_CRC32C:
+		pthread_once(&g_crc32c_once, _crc32c_init);
+		digest->crc = 0xffffffff;
+		break;
+	case URL_DOWNLOAD_DIGEST_XXH64:
+		digest->xxh[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+		digest->xxh[1] = XXH_PRIME64_2;
+		digest->xxh[2] = 0;
+		digest->xxh[3] = -XXH_PRIME64_1;
+		break;
+	default:
+		free(digest);
+		return NULL;
+	}
+	return digest;
+}
+
+void url_download_digest_free(struct url_download_digest_s *digest)
+{
+	if (digest == NULL)
+		return;
+	if (digest->md)
+		EVP_MD_CTX_free(digest->md);
+	free(digest);
+}
+
+void url_download_digest_update(struct url_download_digest_s *digest, const void *data, size_t length)
+{
+	digest->length += length;
+	switch (digest->type) {
+	case URL_DOWNLOAD_DIGEST_SHA256:
+	case URL_DOWNLOAD_DIGEST_SHA1:
+		EVP_DigestUpdate(digest->md, data, length);
+		break;
+	case URL_DOWNLOAD_DIGEST_CRC32C:
+		if (g_crc32c_hardware)
+			digest->crc = _crc32c_hardware(digest->crc, data, length);
+		else
+			digest->crc = _crc32c_table(digest->crc, data, length);
+		break;
+	case URL_DOWNLOAD_DIGEST_XXH64:
+		_xxh64_update(digest, data, length);
+		break;
+	default:
+		break;
+	}
+}
+
+// returns the digest in lowercase hexadecimal, the big endian value for CRC32C and XXH64
+char *url_download_digest_final(struct url_download_digest_s *digest)
+{
+	unsigned char value[EVP_MAX_MD_SIZE];
+	unsigned int length = 0;
+	char *hex = NULL;
+	unsigned int i = 0;
+
+	switch (digest->type) {
+	case URL_DOWNLOAD_DIGEST_SHA256:
+	case URL_DOWNLOAD_DIGEST_SHA1:
+		if (EVP_DigestFinal_ex(digest->md, value, &length) != 1)
+			return NULL;
+		break;
+	case URL_DOWNLOAD_DIGEST_CRC32C:
+		digest->crc ^= 0xffffffff;
+		for (i = 0; i < 4; i++)
+			value[i] = digest->crc >> (24 - 8 * i);
+		length = 4;
+		break;
+	case URL_DOWNLOAD_DIGEST_XXH64:
+		{
+			uint64_t hash = _xxh64_final(digest);
+			for (i = 0; i < 8; i++)
+				value[i] = hash >> (56 - 8 * i);
+			length = 8;
+		}
+		break;
+	default:
+		return NULL;
+	}
+
+	hex = calloc(length * 2 + 1, sizeof(char));
+	if (hex == NULL)
+		return NULL;
+	for (i = 0; i < length; i++)
+		snprintf(hex + i * 2, 3, "%02x", value[i]);
+	return hex;
+}
@@ -0,0 +1,3883 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// splice()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The in-process backend : one engine thread drives the HTTP/1.1 transfers
+// with non-blocking sockets and poll(). The callbacks are invoked from the
+// engine thread, like the callbacks of the download-provider backend are
+// invoked from the event thread. The hosts are resolved on resolver threads,
+// the segments wait for the lookup in HTTP_STATE_RESOLVING.
+
+//
+// A transfer is made of segments : the byte ranges of the file fetched
+// on their own connection and written at their offset. A single stream
+// download is a transfer of one segment.
+
+//
+// A download of a byte range is a transfer of the bytes [offset, end) of
+// the remote file. The offsets of the segments are the ones of the remote
+// file, the bytes are written at their offset minus file_base.
+
+//
+// With the content decoding, the coded body of a response to a whole
+// file request goes through a decoder to the buffers of the writer. It is
+// neither split into ranges nor resumed at its offset.
+
+//
+// The https segments go through a TLS connection of the segment socket
+// (see url_download_tls_new()), their bodies are copied through a buffer.
+
+//
+// A body without transfer coding is moved from the socket to the file
+// with splice() through a pipe, without copy to the user space. The
+// chunked bodies, and the files or sockets splice() does not support,
+// are copied through a buffer. The pipes and the buffers are written to
+// the files asynchronously (see url_download_writer_submit()).
+
+//
+// The digest of the file (see url_download_set_expected_digest()) is
+// updated with the data written at the end of the bytes hashed, which
+// comes in order from the first segment. The splice() path is not taken
+// for these bytes. The other bytes are read back from the file when the
+// transfer completes.
+
+//
+// With the content store (see url_download_set_content_store()), the
+// digest is computed for every file, SHA-256 if none is set, and the
+// completed file is added to the store. A transfer whose expected digest,
+// or whose url and strong ETag, are in the store becomes a local copy of
+// the stored file, after its first response header in the latter case.
+
+//
+// With the revalidation index (see url_download_set_revalidation_index()),
+// the first request of a url downloaded before to the same destination
+// carries the validators of the file. A 304 completes the transfer with
+// that file, before any file is opened.
+
+//
+// A delta download (see url_download_set_delta_source()) requests the block
+// manifest first, then scans the old file for the blocks and copies them by
+// slices at each turn of the engine, like a file:// url. The segments fetch
+// the other ranges of the file, the next one when their range is done.
+
+//
+// With the checkpoints (see url_download_set_checkpoint()), the data of
+// a file which can be resumed is flushed to the storage at intervals, then
+// the ranges still to download are recorded next to the file. A start finds
+// the partial file of the url and resumes its ranges, with If-Range : a 200
+// means that the remote file changed and it is downloaded again.
+
+//
+// With the atomic completions (see url_download_set_atomic_completion()),
+// the file has a temporary name until the commit thread flushed it to the
+// storage and renamed it, the engine reports the completion after the commit.
+
+//
+// With the archive extraction (see url_download_set_archive_extraction()),
+// the body goes to the extraction of the archive (see url_download_archive_write())
+// instead of a file. It is fetched by one segment, the offsets are the ones of
+// the body, and a pause resumes it at its offset.
+
+//
+// With the memory destinations (see url_download_set_destination_type()),
+// the data is copied to a buffer which grows with it, without the writer, or
+// written to a memfd like to a file. The download keeps them once completed.
+
+//
+// A probe (see url_download_probe()) is a transfer of one segment without
+// file : a HEAD request, or a request of the first byte if the server
+// refuses it, whose response header gives the metadata of the file.
+
+//
+// The file:// and data: urls are transfers without segment. A slice of
+// their source is copied at each turn of the engine, so they can be
+// paused, stopped and rate limited like the HTTP transfers.
+
+typedef enum {
+	HTTP_STATE_IDLE,
+	HTTP_STATE_RESOLVING, /* waits for the lookup of the host, without socket */
+	HTTP_STATE_CONNECTING,
+	HTTP_STATE_HANDSHAKE,
+	HTTP_STATE_SENDING,
+	HTTP_STATE_HEADERS,
+	HTTP_STATE_BODY,
+	HTTP_STATE_DONE,
+} http_state_e;
+
+typedef enum {
+	CHUNK_SIZE,
+	CHUNK_DATA,
+	CHUNK_DATA_END,
+	CHUNK_TRAILER,
+} chunk_state_e;
+
+typedef enum {
+	DELTA_NONE,
+	DELTA_MANIFEST,
+	DELTA_SCAN,
+	DELTA_COPY,
+	DELTA_FETCH,
+} delta_state_e;
+
+// the events are delivered when the I/O of the transfer is processed
+#define HTTP_EVENT_STARTED 0x01
+#define HTTP_EVENT_PROGRESS 0x02
+#define HTTP_EVENT_PAUSED 0x04
+#define HTTP_EVENT_COMPLETED 0x08
+#define HTTP_EVENT_FAILED 0x10
+#define HTTP_EVENT_EXTRACTED 0x20
+
+struct url_download_http_segment_s {
+	http_state_e state;
+	int sockfd;
+	struct url_download_tls_s *tls; /* https */
+	struct addrinfo *addr;
+	char *request;
+	size_t request_length;
+	size_t request_sent;
+	char *header;
+	size_t header_length;
+	int status;
+	long long content_length; /* length of the response body, -1 if unknown */
+	long long response_received;
+	int chunked;
+	chunk_state_e chunk_state;
+	long long chunk_remaining;
+	char chunk_line[32];
+	size_t chunk_line_length;
+	int reused; /* the connection was taken from the idle connections */
+	int keep_alive;
+	int response_complete;
+	long long offset; /* next byte of the file to write */
+	long long end; /* end of the range, excluded, -1 until the end of the file */
+	long long skip; /* bytes of the response before the offset, the server ignored the range */
+	struct timespec deadline;
+};
+
+struct url_download_http_s {
+	url_download_h download;
+	unsigned long serial;
+	int paused;
+	int finished;
+	int filefd;
+	char *url; /* the url requested, it changes with the redirections */
+	struct url_download_url_s target;
+	int secure; /* https */
+	struct addrinfo *addrs;
+	struct url_download_http_lookup_s *lookup; /* the host is being resolved */
+	int redirects;
+	int started;
+	int accept_ranges;
+	long long total_size; /* -1 if unknown */
+	long long received; /* bytes written to the file */
+	char *path;
+	char *final_path; /* atomic completion : the name of the file once committed */
+	struct url_download_commit_s *commit; /* the completed file is committed */
+	struct url_download_archive_s *archive; /* the body is extracted, without file */
+	int in_memory; /* URL_DOWNLOAD_DESTINATION_MEMORY, without file */
+	char *memory;
+	size_t memory_length; /* the end of the data written */
+	size_t memory_size;
+	int events;
+	int error;
+	struct timespec last_progress;
+	struct timespec last_checkpoint;
+	int resumed; /* from a checkpoint, the ranges are requested with If-Range */
+	int checkpointed; /* the partial file has a checkpoint */
+	int segment_count;
+	struct url_download_http_segment_s segments[URL_DOWNLOAD_HTTP_MAX_SEGMENTS];
+	int buffered; /* splice() is not supported for the socket */
+	struct url_download_writer_stream_s stream;
+	int completing; /* waits for the writes in flight */
+	int local; /* file:// or data: */
+	int local_done;
+	int source_fd; /* file:// */
+	char *source_data; /* data: */
+	size_t source_length;
+	size_t source_offset;
+	int source_base64;
+	struct url_download_base64_s base64;
+	struct url_download_decoder_s *decoder; /* Content-Encoding of the response */
+	int decoded; /* the end of the coded body was decoded */
+	int ranged; /* url_download_set_range() */
+	long long range_suffix; /* the last bytes of the file, until the first response */
+	long long file_base; /* offset of the remote file written at the beginning of the file */
+	int in_place; /* the range is written at its offset of an existing file */
+	struct url_download_http_probe_s *probe; /* url_download_probe() */
+	struct url_download_digest_s *digest; /* url_download_set_expected_digest() */
+	long long digest_start; /* offset in the file of the first byte of the digest */
+	long long digest_offset; /* next byte of the file to hash */
+	long long digest_read; /* bytes read back from the file */
+	url_download_digest_e digest_type; /* the one of the download, SHA-256 for the content store */
+	char *digest_value; /* of the completed file */
+	char *etag; /* of the response, for the content store and the revalidation index */
+	char *last_modified; /* of the response, for the revalidation index */
+	int stored; /* copied from the content store */
+	char *cached_path; /* the file of the revalidation index, sent with its validators */
+	char *cached_etag;
+	char *cached_last_modified;
+	delta_state_e delta_state; /* url_download_set_delta_source() */
+	struct url_download_delta_s *delta;
+	char *manifest; /* the body of the block manifest */
+	size_t manifest_length;
+};
+
+// a lookup of the host on a resolver thread, getaddrinfo() does not block the engine.
+// the resolver thread frees it if the transfer is gone before the end of the lookup.
+struct url_download_http_lookup_s {
+	char *host;
+	char port[8];
+	struct addrinfo *addrs;
+	int error; /* of getaddrinfo() */
+	int done;
+	int abandoned;
+};
+
+// the request and the metadata of a probe
+struct url_download_http_probe_s {
+	char *url; /* the url probed, before the redirections */
+	int head; /* 0 once the server refused HEAD */
+	url_download_probed_cb callback;
+	void *user_data;
+	long long content_length;
+	char *mime_type;
+	char *etag;
+	char *last_modified;
+	int accept_ranges;
+};
+
+// the connections kept open after a complete response, for the next requests to the same host
+struct url_download_http_idle_s {
+	char *host;
+	int port;
+	int sockfd;
+	struct url_download_tls_s *tls;
+	struct timespec since;
+};
+
+static pthread_mutex_t g_http_mutex;
+static pthread_once_t g_http_once = PTHREAD_ONCE_INIT;
+static struct url_download_http_s *g_http_transfers[MAX_DOWNLOAD_HANDLE_COUNT] = {0,};
+static struct url_download_http_s *g_http_probes[URL_DOWNLOAD_HTTP_MAX_PROBES] = {0,};
+static unsigned long g_http_serial = 0;
+static int g_http_requestid = 0;
+static int g_http_running = 0;
+static int g_http_wakeup[2] = {-1, -1};
+static struct url_download_http_idle_s g_http_idle[URL_DOWNLOAD_HTTP_MAX_IDLE] = {{0,},};
+
+static void _http_init()
+{
+	pthread_mutexattr_t attr;
+
+	// the callbacks may call back into the engine from the engine thread
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&g_http_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	// the engine does not start without its writer
+	if (url_download_writer_init() != URL_DOWNLOAD_ERROR_NONE)
+		return;
+
+	if (pipe(g_http_wakeup) < 0) {
+		LOGE("[%s]pipe system error : %s",__FUNCTION__,strerror(errno));
+		g_http_wakeup[0] = g_http_wakeup[1] = -1;
+		return;
+	}
+	fcntl(g_http_wakeup[0], F_SETFL, O_NONBLOCK);
+	fcntl(g_http_wakeup[1], F_SETFL, O_NONBLOCK);
+	fcntl(g_http_wakeup[0], F_SETFD, FD_CLOEXEC);
+	fcntl(g_http_wakeup[1], F_SETFD, FD_CLOEXEC);
+}
+
+static void _lock()
+{
+	pthread_once(&g_http_once, _http_init);
+	pthread_mutex_lock(&g_http_mutex);
+}
+
+static void _unlock()
+{
+	pthread_mutex_unlock(&g_http_mutex);
+}
+
+static void _wakeup()
+{
+	char c = 0;
+	if (g_http_wakeup[1] >= 0 && write(g_http_wakeup[1], &c, 1) < 0 && errno != EAGAIN)
+		LOGE("[%s]write system error : %s",__FUNCTION__,strerror(errno));
+}
+
+static long long _ms_until(const struct timespec *when, const struct timespec *now)
+{
+	return (when->tv_sec - now->tv_sec) * 1000LL
+		+ (when->tv_nsec - now->tv_nsec) / 1000000LL;
+}
+
+static void _set_deadline(struct url_download_http_segment_s *segment)
+{
+	clock_gettime(CLOCK_MONOTONIC, &segment->deadline);
+	segment->deadline.tv_sec += URL_DOWNLOAD_HTTP_TIMEOUT_MS / 1000;
+}
+
+static void _close_socket(struct url_download_http_segment_s *segment)
+{
+	url_download_tls_free(segment->tls);
+	segment->tls = NULL;
+	if (segment->sockfd > 0)
+		close(segment->sockfd);
+	segment->sockfd = 0;
+}
+
+static void _reset_response(struct url_download_http_segment_s *segment)
+{
+	if (segment->request)
+		free(segment->request);
+	segment->request = NULL;
+	segment->request_length = 0;
+	segment->request_sent = 0;
+	if (segment->header)
+		free(segment->header);
+	segment->header = NULL;
+	segment->header_length = 0;
+	segment->status = 0;
+	segment->content_length = -1;
+	segment->response_received = 0;
+	segment->chunked = 0;
+	segment->chunk_state = CHUNK_SIZE;
+	segment->chunk_remaining = 0;
+	segment->chunk_line_length = 0;
+	segment->reused = 0;
+	segment->keep_alive = 0;
+	segment->response_complete = 0;
+	segment->skip = 0;
+}
+
+// the segment is idle until it is opened again
+static void _close_segment(struct url_download_http_segment_s *segment)
+{
+	_close_socket(segment);
+	_reset_response(segment);
+	if (segment->state != HTTP_STATE_DONE)
+		segment->state = HTTP_STATE_IDLE;
+}
+
+static void _free_lookup(struct url_download_http_lookup_s *lookup)
+{
+	if (lookup->addrs)
+		freeaddrinfo(lookup->addrs);
+	if (lookup->host)
+		free(lookup->host);
+	free(lookup);
+}
+
+// the transfer does not wait for its lookup anymore
+static void _cancel_lookup(struct url_download_http_s *transfer)
+{
+	if (transfer->lookup == NULL)
+		return;
+	if (transfer->lookup->done)
+		_free_lookup(transfer->lookup);
+	else
+		transfer->lookup->abandoned = 1;
+	transfer->lookup = NULL;
+}
+
+static void _free_probe(struct url_download_http_probe_s *probe)
+{
+	if (probe == NULL)
+		return;
+	if (probe->url)
+		free(probe->url);
+	if (probe->mime_type)
+		free(probe->mime_type);
+	if (probe->etag)
+		free(probe->etag);
+	if (probe->last_modified)
+		free(probe->last_modified);
+	free(probe);
+}
+
+static void _free_transfer(struct url_download_http_s *transfer)
+{
+	int i = 0;
+
+	for (i = 0; i < transfer->segment_count; i++)
+		_close_segment(&transfer->segments[i]);
+	url_download_writer_wait(&transfer->stream);
+	if (transfer->filefd > 0)
+		close(transfer->filefd);
+	if (transfer->commit != NULL)
+		url_download_commit_abandon(transfer->commit);
+	url_download_archive_free(transfer->archive);
+	if (transfer->memory)
+		free(transfer->memory);
+	if (transfer->source_fd > 0)
+		close(transfer->source_fd);
+	if (transfer->source_data)
+		free(transfer->source_data);
+	url_download_decoder_free(transfer->decoder);
+	url_download_digest_free(transfer->digest);
+	if (transfer->digest_value)
+		free(transfer->digest_value);
+	if (transfer->etag)
+		free(transfer->etag);
+	if (transfer->last_modified)
+		free(transfer->last_modified);
+	if (transfer->cached_path)
+		free(transfer->cached_path);
+	if (transfer->cached_etag)
+		free(transfer->cached_etag);
+	if (transfer->cached_last_modified)
+		free(transfer->cached_last_modified);
+	url_download_delta_free(transfer->delta);
+	if (transfer->manifest)
+		free(transfer->manifest);
+	_free_probe(transfer->probe);
+	_cancel_lookup(transfer);
+	if (transfer->addrs)
+		freeaddrinfo(transfer->addrs);
+	url_download_url_clear(&transfer->target);
+	if (transfer->url)
+		free(transfer->url);
+	if (transfer->path)
+		free(transfer->path);
+	if (transfer->final_path)
+		free(transfer->final_path);
+	free(transfer);
+}
+
+// the download leaves the engine
+static void _detach(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+
+	if (g_http_transfers[download->slot_index] == transfer)
+		g_http_transfers[download->slot_index] = NULL;
+	download->http = NULL;
+	download->throttled = 0;
+	url_download_scheduler_release(download);
+	_free_transfer(transfer);
+}
+
+static void _fail(struct url_download_http_s *transfer, int error)
+{
+	int i = 0;
+
+	url_download_error(__FUNCTION__, error, transfer->url);
+	for (i = 0; i < transfer->segment_count; i++)
+		_close_segment(&transfer->segments[i]);
+	transfer->finished = 1;
+	transfer->error = error;
+	transfer->events |= HTTP_EVENT_FAILED;
+}
+
+static int _status_error(int status)
+{
+	if (status == 404 || status == 410)
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	// the range starts after the end of the file
+	if (status == 416)
+		return URL_DOWNLOAD_ERROR_NO_DATA;
+	return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+}
+
+static void *_run_lookup(void *args)
+{
+	struct url_download_http_lookup_s *lookup = args;
+	struct addrinfo hints;
+	struct addrinfo *addrs = NULL;
+	int ret = 0;
+
+	memset(&hints, 0x00, sizeof(struct addrinfo));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	// blocking, out of the lock
+	ret = getaddrinfo(lookup->host, lookup->port, &hints, &addrs);
+
+	_lock();
+	if (ret != 0)
+		addrs = NULL;
+	lookup->addrs = addrs;
+	lookup->error = ret;
+	lookup->done = 1;
+	if (lookup->abandoned)
+		_free_lookup(lookup);
+	else
+		_wakeup();
+	_unlock();
+	return 0;
+}
+
+// start the lookup of the host of the target, the segments waiting for it
+// are connected by the engine once it is done.
+static int _resolve(struct url_download_http_s *transfer)
+{
+	struct url_download_http_lookup_s *lookup = NULL;
+	pthread_attr_t thread_attr;
+	pthread_t thread_pid;
+	int ret = 0;
+
+	if (transfer->lookup != NULL)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	lookup = calloc(1, sizeof(struct url_download_http_lookup_s));
+	if (lookup == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	lookup->host = strdup(transfer->target.host);
+	if (lookup->host == NULL) {
+		free(lookup);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	snprintf(lookup->port, sizeof(lookup->port), "%d", transfer->target.port);
+
+	if (pthread_attr_init(&thread_attr) != 0) {
+		LOGE("[%s]pthread_attr_init : %s",__FUNCTION__,strerror(errno));
+		_free_lookup(lookup);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread_pid, &thread_attr, _run_lookup, lookup);
+	pthread_attr_destroy(&thread_attr);
+	if (ret != 0) {
+		LOGE("[%s][%d] pthread_create : %s",__FUNCTION__, __LINE__,strerror(ret));
+		_free_lookup(lookup);
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	transfer->lookup = lookup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static void _idle_close(struct url_download_http_idle_s *idle)
+{
+	url_download_tls_free(idle->tls);
+	if (idle->sockfd > 0)
+		close(idle->sockfd);
+	if (idle->host)
+		free(idle->host);
+	memset(idle, 0x00, sizeof(struct url_download_http_idle_s));
+}
+
+// close the idle connections kept for too long
+static void _idle_expire(const struct timespec *now)
+{
+	int i = 0;
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_IDLE; i++) {
+		if (g_http_idle[i].sockfd > 0
+			&& _ms_until(now, &g_http_idle[i].since) >= URL_DOWNLOAD_HTTP_IDLE_TIMEOUT_MS)
+			_idle_close(&g_http_idle[i]);
+	}
+}
+
+static void _idle_put(const char *host, int port, int sockfd, struct url_download_tls_s *tls)
+{
+	struct url_download_http_idle_s *idle = NULL;
+	int count = 0;
+	int i = 0;
+
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_IDLE; i++) {
+		if (g_http_idle[i].sockfd <= 0) {
+			if (idle == NULL || idle->sockfd > 0)
+				idle = &g_http_idle[i];
+			continue;
+		}
+		if (g_http_idle[i].port == port && strcmp(g_http_idle[i].host, host) == 0)
+			count++;
+		// no free entry, the oldest one is replaced
+		if (idle == NULL || (idle->sockfd > 0
+				&& _ms_until(&g_http_idle[i].since, &idle->since) < 0))
+			idle = &g_http_idle[i];
+	}
+	if (count >= URL_DOWNLOAD_HTTP_MAX_IDLE_PER_HOST || idle == NULL) {
+		url_download_tls_free(tls);
+		close(sockfd);
+		return;
+	}
+
+	_idle_close(idle);
+	idle->host = strdup(host);
+	if (idle->host == NULL) {
+		url_download_tls_free(tls);
+		close(sockfd);
+		return;
+	}
+	idle->port = port;
+	idle->sockfd = sockfd;
+	idle->tls = tls;
+	clock_gettime(CLOCK_MONOTONIC, &idle->since);
+}
+
+// returns an idle connection to the host still open, -1 if there is none.
+// the TLS connection of an https one is returned in tls.
+static int _idle_take(const char *host, int port, int secure, struct url_download_tls_s **tls)
+{
+	struct timespec now;
+	char c = 0;
+	int sockfd = -1;
+	int i = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	_idle_expire(&now);
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_IDLE && sockfd < 0; i++) {
+		struct url_download_http_idle_s *idle = &g_http_idle[i];
+		if (idle->sockfd <= 0 || idle->port != port || (idle->tls != NULL) != secure
+			|| strcmp(idle->host, host) != 0)
+			continue;
+		// the server may have closed it, nothing can be readable on an idle connection
+		if (recv(idle->sockfd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0
+			&& (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			sockfd = idle->sockfd;
+			*tls = idle->tls;
+			idle->sockfd = 0;
+			idle->tls = NULL;
+		}
+		_idle_close(idle);
+	}
+	return sockfd;
+}
+
+// start a non-blocking connection to the current address, or the next one.
+static int _connect(struct url_download_http_segment_s *segment)
+{
+	int nodelay = 1;
+
+	_close_socket(segment);
+
+	for (; segment->addr != NULL; segment->addr = segment->addr->ai_next) {
+		int sockfd = socket(segment->addr->ai_family,
+			segment->addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			segment->addr->ai_protocol);
+		if (sockfd < 0)
+			continue;
+		// the request follows the last flight of the TLS handshake without waiting for its ack
+		setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+		if (connect(sockfd, segment->addr->ai_addr, segment->addr->ai_addrlen) < 0
+			&& errno != EINPROGRESS) {
+			close(sockfd);
+			continue;
+		}
+		segment->sockfd = sockfd;
+		segment->state = HTTP_STATE_CONNECTING;
+		_set_deadline(segment);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+}
+
+// the weak ETags do not identify the bytes of the file
+static const char *_strong_etag(struct url_download_http_s *transfer)
+{
+	if (transfer->etag == NULL || strncmp(transfer->etag, "W/", 2) == 0)
+		return NULL;
+	return transfer->etag;
+}
+
+static int _build_request(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	char **fields = NULL;
+	int fields_length = 0;
+	size_t size = 0;
+	size_t length = 0;
+	char range[64] = {0,};
+	char host[300] = {0,};
+	const char *method = "GET";
+	const char *if_none_match = NULL;
+	const char *if_modified_since = NULL;
+	const char *if_range = NULL;
+	const char *encoding = "identity";
+	int i = 0;
+
+	if (url_download_get_all_http_header_fields(transfer->download, &fields, &fields_length)
+		!= URL_DOWNLOAD_ERROR_NONE)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	if (strchr(transfer->target.host, ':'))
+		snprintf(host, sizeof(host), "[%s]", transfer->target.host);
+	else
+		snprintf(host, sizeof(host), "%s", transfer->target.host);
+	if (transfer->target.port != (transfer->secure ? 443 : 80)) {
+		length = strlen(host);
+		snprintf(host + length, sizeof(host) - length, ":%d", transfer->target.port);
+	}
+	if (transfer->probe != NULL) {
+		if (transfer->probe->head)
+			method = "HEAD";
+		else
+			snprintf(range, sizeof(range), "Range: bytes=0-0\r\n");
+	} else if (transfer->range_suffix > 0)
+		snprintf(range, sizeof(range), "Range: bytes=-%lld\r\n", transfer->range_suffix);
+	else if (segment->end >= 0)
+		snprintf(range, sizeof(range), "Range: bytes=%lld-%lld\r\n", segment->offset, segment->end - 1);
+	else if (segment->offset > 0)
+		snprintf(range, sizeof(range), "Range: bytes=%lld-\r\n", segment->offset);
+	// a range of a coded body could not be decoded, a probe asks for the size of the file
+	if (transfer->download->content_decoding && range[0] == '\0' && transfer->probe == NULL
+		&& transfer->delta_state != DELTA_MANIFEST)
+		encoding = url_download_decoder_accept();
+	// the file of the previous download is sent again only if it was modified
+	if (transfer->cached_path != NULL && !transfer->started && range[0] == '\0') {
+		if_none_match = transfer->cached_etag;
+		if_modified_since = transfer->cached_last_modified;
+	}
+	// the ranges of a resumed file, only if it was not modified since its checkpoint
+	if (transfer->resumed && range[0] != '\0')
+		if_range = (_strong_etag(transfer) ? _strong_etag(transfer) : transfer->last_modified);
+
+	size = strlen(transfer->target.path) + strlen(host) + strlen(range) + strlen(encoding) + 128
+		+ (if_none_match ? strlen(if_none_match) + 32 : 0)
+		+ (if_modified_since ? strlen(if_modified_since) + 32 : 0)
+		+ (if_range ? strlen(if_range) + 32 : 0);
+	for (i = 0; i < fields_length; i++)
+		size += strlen(fields[i]) + 2;
+
+	segment->request = calloc(size, sizeof(char));
+	if (segment->request != NULL) {
+		length = snprintf(segment->request, size,
+			"%s %s HTTP/1.1\r\n"
+			"Host: %s\r\n"
+			"Accept-Encoding: %s\r\n"
+			"%s",
+			method, transfer->target.path, host, encoding, range);
+		if (if_none_match)
+			length += snprintf(segment->request + length, size - length,
+				"If-None-Match: %s\r\n", if_none_match);
+		if (if_modified_since)
+			length += snprintf(segment->request + length, size - length,
+				"If-Modified-Since: %s\r\n", if_modified_since);
+		if (if_range)
+			length += snprintf(segment->request + length, size - length,
+				"If-Range: %s\r\n", if_range);
+		for (i = 0; i < fields_length; i++)
+			length += snprintf(segment->request + length, size - length, "%s\r\n", fields[i]);
+		length += snprintf(segment->request + length, size - length, "\r\n");
+		segment->request_length = length;
+	}
+
+	for (i = 0; i < fields_length; i++)
+		free(fields[i]);
+	if (fields)
+		free(fields);
+
+	return (segment->request ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+// send the request of the segment for its remaining range,
+// on an idle connection to the host if there is one.
+static int _open_segment(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, int reuse)
+{
+	struct url_download_tls_s *tls = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int sockfd = -1;
+
+	_close_segment(segment);
+	segment->addr = transfer->addrs;
+	errorcode = _build_request(transfer, segment);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+
+	if (reuse)
+		sockfd = _idle_take(transfer->target.host, transfer->target.port, transfer->secure, &tls);
+	if (sockfd > 0) {
+		segment->sockfd = sockfd;
+		segment->tls = tls;
+		segment->reused = 1;
+		segment->state = HTTP_STATE_SENDING;
+		_set_deadline(segment);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	// the segment is connected at the end of the lookup
+	if (transfer->addrs == NULL) {
+		segment->state = HTTP_STATE_RESOLVING;
+		_set_deadline(segment);
+		return _resolve(transfer);
+	}
+	return _connect(segment);
+}
+
+// the lookup of the host is done, the segments waiting for it are connected
+static int _resolved(struct url_download_http_s *transfer)
+{
+	struct url_download_http_lookup_s *lookup = transfer->lookup;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	transfer->lookup = NULL;
+	if (lookup->error != 0) {
+		LOGE("[%s] getaddrinfo [%s] : %s",__FUNCTION__, lookup->host, gai_strerror(lookup->error));
+		_free_lookup(lookup);
+		return URL_DOWNLOAD_ERROR_NETWORK_UNREACHABLE;
+	}
+	if (transfer->addrs)
+		freeaddrinfo(transfer->addrs);
+	transfer->addrs = lookup->addrs;
+	lookup->addrs = NULL;
+	_free_lookup(lookup);
+
+	for (i = 0; i < transfer->segment_count && errorcode == URL_DOWNLOAD_ERROR_NONE; i++) {
+		struct url_download_http_segment_s *segment = &transfer->segments[i];
+		if (segment->state != HTTP_STATE_RESOLVING)
+			continue;
+		segment->addr = transfer->addrs;
+		errorcode = _connect(segment);
+	}
+	return errorcode;
+}
+
+// parse the current url, the segments are opened on it once its host is resolved
+static int _open_target(struct url_download_http_s *transfer)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	_cancel_lookup(transfer);
+	if (transfer->addrs)
+		freeaddrinfo(transfer->addrs);
+	transfer->addrs = NULL;
+	url_download_url_clear(&transfer->target);
+	errorcode = url_download_url_parse(transfer->url, &transfer->target);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	transfer->secure = (strcmp(transfer->target.scheme, "https") == 0);
+	if (!transfer->secure && strcmp(transfer->target.scheme, "http") != 0) {
+		LOGE("[%s] unsupported scheme [%s]",__FUNCTION__, transfer->target.scheme);
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the last segment of the path, "index.html" for a directory
+static char *_file_name_from_url(const char *path)
+{
+	const char *name = NULL;
+	size_t length = 0;
+
+	length = strcspn(path, "?");
+	for (name = path + length; name > path && *(name - 1) != '/'; name--)
+		;
+	length = strcspn(name, "?");
+	if (length == 0)
+		return strdup("index.html");
+	return strndup(name, length);
+}
+
+// the name with the number i appended, the name itself for 0
+static void _numbered_path(char *path, size_t size, const char *directory, const char *name, int i)
+{
+	const char *extension = strrchr(name, '.');
+
+	if (extension == NULL || extension == name)
+		extension = name + strlen(name);
+	if (i == 0)
+		snprintf(path, size, "%s/%s", directory, name);
+	else
+		snprintf(path, size, "%s/%.*s_%d%s", directory, (int)(extension - name), name, i, extension);
+}
+
+// create the file, a number is appended to the name if it already exists.
+// the file of an atomic completion has a temporary name until it is committed.
+static int _open_file(struct url_download_http_s *transfer, const char *default_name)
+{
+	url_download_h download = transfer->download;
+	const char *directory = url_download_destination_directory(download);
+	char *name = NULL;
+	char *path = NULL;
+	char *final_path = NULL;
+	size_t size = 0;
+	int atomic = (download->atomic_completion && !transfer->in_place);
+	int flags = O_WRONLY;
+	int fd = -1;
+	int i = 0;
+
+	// the bytes received out of order are read back for the digest
+	if (transfer->digest != NULL)
+		flags = O_RDWR;
+
+	name = strdup(download->content_name ? download->content_name : default_name);
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	// the content in memory has no path, the memfd is sealed by _keep_memory()
+	if (download->destination_type != URL_DOWNLOAD_DESTINATION_FILE) {
+		if (download->destination_type == URL_DOWNLOAD_DESTINATION_MEMFD) {
+			transfer->filefd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+			if (transfer->filefd < 0) {
+				LOGE("[%s] memfd_create [%s] : %s",__FUNCTION__, name, strerror(errno));
+				transfer->filefd = 0;
+				free(name);
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			}
+		}
+		if (download->content_name == NULL)
+			download->content_name = name;
+		else
+			free(name);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	size = strlen(directory) + strlen(name) + sizeof(URL_DOWNLOAD_ATOMIC_SUFFIX) + 16;
+	path = calloc(size, sizeof(char));
+	if (atomic)
+		final_path = calloc(size, sizeof(char));
+	if (path == NULL || (atomic && final_path == NULL)) {
+		free(name);
+		if (path)
+			free(path);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	// the range goes to its offset of the file, which may exist
+	if (transfer->in_place) {
+		snprintf(path, size, "%s/%s", directory, name);
+		fd = open(path, flags | O_CREAT | O_CLOEXEC, 0644);
+	}
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_FILE_NUMBER && fd < 0 && !transfer->in_place; i++) {
+		_numbered_path(path, size, directory, name, i);
+		// the name is free when the download starts, it is taken at the commit
+		if (atomic) {
+			strcpy(final_path, path);
+			if (access(final_path, F_OK) == 0)
+				continue;
+			strcat(path, URL_DOWNLOAD_ATOMIC_SUFFIX);
+		}
+		fd = open(path, flags | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		if (fd < 0 && errno != EEXIST)
+			break;
+	}
+
+	if (fd < 0) {
+		LOGE("[%s] open [%s] : %s",__FUNCTION__, path, strerror(errno));
+		free(name);
+		free(path);
+		if (final_path)
+			free(final_path);
+		if (errno == ENOSPC)
+			return URL_DOWNLOAD_ERROR_NO_SPACE;
+		return URL_DOWNLOAD_ERROR_INVALID_DESTINATION;
+	}
+
+	if (download->content_name == NULL)
+		download->content_name = strdup(name);
+	free(name);
+	transfer->filefd = fd;
+	transfer->path = path;
+	transfer->final_path = final_path;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the content store, the revalidation, the delta downloads and the checkpoints are the ones of a file
+static int _to_file(url_download_h download)
+{
+	return (!download->archive_extraction && download->destination_type == URL_DOWNLOAD_DESTINATION_FILE);
+}
+
+// the buffer of the content in memory has at least size bytes
+static int _reserve_memory(struct url_download_http_s *transfer, long long size)
+{
+	char *memory = NULL;
+
+	if (size > URL_DOWNLOAD_MEMORY_MAX_SIZE) {
+		LOGE("[%s] slot[%d] [%lld] bytes do not fit in memory",__FUNCTION__,
+			transfer->download->slot_index, size);
+		return URL_DOWNLOAD_ERROR_NO_SPACE;
+	}
+	if ((size_t)size <= transfer->memory_size)
+		return URL_DOWNLOAD_ERROR_NONE;
+	memory = realloc(transfer->memory, size);
+	if (memory == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	transfer->memory = memory;
+	transfer->memory_size = size;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// a memfd holds no more than a buffer in memory would
+static int _check_memfd(struct url_download_http_s *transfer, long long end)
+{
+	if (transfer->download->destination_type != URL_DOWNLOAD_DESTINATION_MEMFD
+		|| end <= URL_DOWNLOAD_MEMORY_MAX_SIZE)
+		return URL_DOWNLOAD_ERROR_NONE;
+	LOGE("[%s] slot[%d] [%lld] bytes do not fit in memory",__FUNCTION__,
+		transfer->download->slot_index, end);
+	return URL_DOWNLOAD_ERROR_NO_SPACE;
+}
+
+// the data is copied at its offset of the content, the buffer grows by doubling when the size is unknown
+static int _write_memory(struct url_download_http_s *transfer, long long offset,
+		const char *data, size_t length)
+{
+	long long end = offset + (long long)length;
+	long long size = transfer->memory_size * 2;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if ((size_t)end > transfer->memory_size) {
+		if (size < end)
+			size = end;
+		if (size > URL_DOWNLOAD_MEMORY_MAX_SIZE && end <= URL_DOWNLOAD_MEMORY_MAX_SIZE)
+			size = URL_DOWNLOAD_MEMORY_MAX_SIZE;
+		errorcode = _reserve_memory(transfer, size);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	memcpy(transfer->memory + offset, data, length);
+	if ((size_t)end > transfer->memory_length)
+		transfer->memory_length = end;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the completed content in memory belongs to the download until its next start
+static void _keep_memory(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+
+	if (transfer->in_memory) {
+		download->memory = transfer->memory;
+		download->memory_length = transfer->memory_length;
+		transfer->memory = NULL;
+	} else if (download->destination_type == URL_DOWNLOAD_DESTINATION_MEMFD) {
+		// the receivers of the memfd read the content as it was completed
+		if (fcntl(transfer->filefd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+			LOGI("[%s] slot[%d] F_ADD_SEALS : %s",__FUNCTION__, download->slot_index, strerror(errno));
+		download->memory_fd = transfer->filefd;
+		transfer->filefd = 0;
+	}
+}
+
+// the extraction of the body starts, again for a body downloaded again
+static int _open_archive(struct url_download_http_s *transfer)
+{
+	url_download_writer_wait(&transfer->stream);
+	url_download_archive_free(transfer->archive);
+	transfer->archive = url_download_archive_new(
+		url_download_destination_directory(transfer->download));
+	return (transfer->archive ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+static int _digest_reset(struct url_download_http_s *transfer)
+{
+	if (transfer->digest == NULL)
+		return URL_DOWNLOAD_ERROR_NONE;
+	url_download_digest_free(transfer->digest);
+	transfer->digest = url_download_digest_new(transfer->digest_type);
+	transfer->digest_offset = transfer->digest_start;
+	return (transfer->digest ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+// the data written at the offset of the file is hashed if it follows the bytes hashed
+static void _digest_data(struct url_download_http_s *transfer, long long offset,
+		const char *data, size_t length)
+{
+	long long count = 0;
+
+	if (transfer->digest == NULL || offset > transfer->digest_offset
+		|| offset + (long long)length <= transfer->digest_offset)
+		return;
+	count = transfer->digest_offset - offset;
+	url_download_digest_update(transfer->digest, data + count, length - count);
+	transfer->digest_offset += length - count;
+}
+
+// hash a slice of the bytes written out of order, read back from the file
+static int _digest_file(struct url_download_http_s *transfer)
+{
+	static char buffer[URL_DOWNLOAD_HTTP_BUFFER_SIZE];
+	long long end = transfer->digest_start + transfer->received;
+	long long limit = transfer->digest_offset + URL_DOWNLOAD_DIGEST_SLICE_SIZE;
+	size_t length = 0;
+	ssize_t count = 0;
+
+	if (limit > end)
+		limit = end;
+	if (transfer->in_memory && transfer->digest_offset < limit) {
+		url_download_digest_update(transfer->digest, transfer->memory + transfer->digest_offset,
+			limit - transfer->digest_offset);
+		transfer->digest_read += limit - transfer->digest_offset;
+		transfer->digest_offset = limit;
+	}
+	while (transfer->digest_offset < limit) {
+		length = sizeof(buffer);
+		if (limit - transfer->digest_offset < (long long)length)
+			length = limit - transfer->digest_offset;
+		count = pread(transfer->filefd, buffer, length, transfer->digest_offset);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0) {
+			LOGE("[%s] pread : %s",__FUNCTION__, count < 0 ? strerror(errno) : "end of file");
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+		url_download_digest_update(transfer->digest, buffer, count);
+		transfer->digest_offset += count;
+		transfer->digest_read += count;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _check_digest(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	char *digest = NULL;
+
+	digest = url_download_digest_final(transfer->digest);
+	url_download_digest_free(transfer->digest);
+	transfer->digest = NULL;
+	if (digest == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	LOGI("[%s] slot[%d] digest [%s], [%lld] bytes read back",__FUNCTION__,
+		download->slot_index, digest, transfer->digest_read);
+	if (download->expected_digest != NULL && strcmp(digest, download->expected_digest) != 0) {
+		LOGE("[%s] slot[%d] expected [%s]",__FUNCTION__, download->slot_index, download->expected_digest);
+		free(digest);
+		return URL_DOWNLOAD_ERROR_DIGEST_MISMATCH;
+	}
+	// the file of a delta download is the one of its manifest
+	if (transfer->delta != NULL && transfer->digest_type == URL_DOWNLOAD_DIGEST_SHA256
+		&& strcmp(digest, url_download_delta_digest(transfer->delta)) != 0) {
+		LOGE("[%s] slot[%d] manifest [%s]",__FUNCTION__, download->slot_index,
+			url_download_delta_digest(transfer->delta));
+		free(digest);
+		return URL_DOWNLOAD_ERROR_DIGEST_MISMATCH;
+	}
+	transfer->digest_value = digest;
+	if (download->digest_type == URL_DOWNLOAD_DIGEST_NONE)
+		return URL_DOWNLOAD_ERROR_NONE;
+	if (download->digest)
+		free(download->digest);
+	download->digest = strdup(digest);
+	return (download->digest ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+// the blocks of the file are allocated before its data, in one extent if the
+// file system can, and a file which does not fit fails before its transfer.
+static int _preallocate(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	long long offset = transfer->segments[0].offset - transfer->file_base;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	errorcode = url_download_scheduler_reserve(download, transfer->total_size);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	// the size of the file grows with the data, like without preallocation
+	if (fallocate(transfer->filefd, FALLOC_FL_KEEP_SIZE, offset, transfer->total_size) < 0) {
+		if (errno == ENOSPC)
+			return URL_DOWNLOAD_ERROR_NO_SPACE;
+		// the space stays reserved
+		LOGI("[%s] slot[%d] fallocate : %s",__FUNCTION__, download->slot_index, strerror(errno));
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	return url_download_scheduler_reserve(download, 0);
+}
+
+// the completed file is recorded and the completion is reported
+static void _finish(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+
+	// the decoded file is not the body of the ETag
+	if (transfer->digest_value != NULL && !transfer->stored && !transfer->ranged
+		&& _to_file(download) && url_download_store_enabled())
+		url_download_store_add(transfer->path, transfer->digest_type, transfer->digest_value,
+			download->url, transfer->decoder ? NULL : _strong_etag(transfer));
+	if ((transfer->etag != NULL || transfer->last_modified != NULL) && !transfer->ranged
+		&& _to_file(download) && url_download_revalidation_enabled())
+		url_download_revalidation_record(download->url, url_download_destination_directory(download),
+			transfer->path, transfer->etag, transfer->last_modified);
+
+	if (download->completed_path)
+		free(download->completed_path);
+	download->completed_path = NULL;
+	// the files of an archive are under the destination, the content in memory has no path
+	if (transfer->archive != NULL)
+		download->completed_path = strdup(url_download_destination_directory(download));
+	else if (transfer->path != NULL)
+		download->completed_path = strdup(transfer->path);
+	if (download->file_size == 0)
+		download->file_size = transfer->received;
+	if (transfer->decoder != NULL)
+		LOGI("[%s] slot[%d] [%llu] bytes decoded to [%lld]",__FUNCTION__,
+			download->slot_index, download->wire_received, transfer->received);
+
+	transfer->finished = 1;
+	transfer->events |= HTTP_EVENT_PROGRESS | HTTP_EVENT_COMPLETED;
+}
+
+static void _complete(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	// the body ended in the middle of the coded data
+	if (transfer->decoder != NULL && !transfer->decoded) {
+		_fail(transfer, URL_DOWNLOAD_ERROR_IO_ERROR);
+		return;
+	}
+	// called again by the engine when the writes are done
+	if (transfer->stream.pending > 0
+		|| (transfer->archive != NULL && url_download_archive_pending(transfer->archive))) {
+		transfer->completing = 1;
+		return;
+	}
+	transfer->completing = 0;
+	if (transfer->stream.error != URL_DOWNLOAD_ERROR_NONE) {
+		_fail(transfer, transfer->stream.error);
+		return;
+	}
+	if (transfer->digest != NULL) {
+		errorcode = _digest_file(transfer);
+		// the next slice at the next turn of the engine
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE
+			&& transfer->digest_offset < transfer->digest_start + transfer->received) {
+			transfer->completing = 1;
+			return;
+		}
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+			errorcode = _check_digest(transfer);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+			_fail(transfer, errorcode);
+			return;
+		}
+	}
+
+	if (transfer->archive != NULL) {
+		errorcode = url_download_archive_finish(transfer->archive);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+			_fail(transfer, errorcode);
+			return;
+		}
+		_finish(transfer);
+		return;
+	}
+
+	if (transfer->source_fd > 0)
+		close(transfer->source_fd);
+	transfer->source_fd = 0;
+	if (download->checkpoint && transfer->path != NULL)
+		url_download_checkpoint_remove(transfer->path);
+	_keep_memory(transfer);
+
+	// the engine waits for the commit, the file is closed by it
+	if (transfer->final_path != NULL) {
+		transfer->commit = url_download_commit_submit(transfer->filefd, transfer->path, transfer->final_path);
+		if (transfer->commit == NULL) {
+			_fail(transfer, URL_DOWNLOAD_ERROR_IO_ERROR);
+			return;
+		}
+		transfer->filefd = 0;
+		transfer->completing = 1;
+		return;
+	}
+	if (transfer->filefd > 0)
+		close(transfer->filefd);
+	transfer->filefd = 0;
+	_finish(transfer);
+}
+
+// the committed file has its name
+static void _check_commit(struct url_download_http_s *transfer)
+{
+	int error = URL_DOWNLOAD_ERROR_NONE;
+
+	if (!url_download_commit_done(transfer->commit, &error))
+		return;
+	url_download_commit_free(transfer->commit);
+	transfer->commit = NULL;
+	transfer->completing = 0;
+	if (error != URL_DOWNLOAD_ERROR_NONE) {
+		_fail(transfer, error);
+		return;
+	}
+	free(transfer->path);
+	transfer->path = transfer->final_path;
+	transfer->final_path = NULL;
+	_finish(transfer);
+}
+
+// the partial file can be resumed at its offsets with the validators of the remote file
+static int _can_checkpoint(struct url_download_http_s *transfer)
+{
+	return (transfer->download->checkpoint && transfer->started && transfer->filefd > 0
+		&& !transfer->ranged && !transfer->local && !transfer->stored && transfer->decoder == NULL
+		&& transfer->delta_state == DELTA_NONE && transfer->accept_ranges && transfer->total_size > 0
+		&& (_strong_etag(transfer) != NULL || transfer->last_modified != NULL));
+}
+
+// the data written is flushed to the storage, then the ranges still to download are recorded
+static int _write_checkpoint(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	struct url_download_checkpoint_s checkpoint;
+	struct url_download_http_segment_s *segment = NULL;
+	long long end = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &transfer->last_checkpoint);
+	url_download_writer_wait(&transfer->stream);
+	if (transfer->stream.error != URL_DOWNLOAD_ERROR_NONE)
+		return transfer->stream.error;
+	if (fdatasync(transfer->filefd) < 0) {
+		LOGE("[%s] slot[%d] fdatasync : %s",__FUNCTION__, download->slot_index, strerror(errno));
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+
+	memset(&checkpoint, 0x00, sizeof(struct url_download_checkpoint_s));
+	checkpoint.url = download->url;
+	checkpoint.etag = (char *)_strong_etag(transfer);
+	checkpoint.last_modified = transfer->last_modified;
+	checkpoint.mime_type = download->mime_type;
+	checkpoint.length = transfer->total_size;
+	for (i = 0; i < transfer->segment_count; i++) {
+		segment = &transfer->segments[i];
+		end = (segment->end >= 0 ? segment->end : transfer->total_size);
+		if (segment->state == HTTP_STATE_DONE || segment->offset >= end)
+			continue;
+		checkpoint.ranges[checkpoint.range_count][0] = segment->offset;
+		checkpoint.ranges[checkpoint.range_count][1] = end;
+		checkpoint.range_count++;
+	}
+	// the file is complete
+	if (checkpoint.range_count == 0)
+		return URL_DOWNLOAD_ERROR_NO_DATA;
+	errorcode = url_download_checkpoint_write(transfer->path, &checkpoint);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		transfer->checkpointed = 1;
+	return errorcode;
+}
+
+// a stopped or failed transfer keeps its partial file if it can be resumed
+static void _remove_partial(struct url_download_http_s *transfer, int error)
+{
+	// an existing file written in place is kept
+	if (transfer->path == NULL || transfer->in_place)
+		return;
+	// the file completed is removed by its commit
+	if (transfer->commit != NULL) {
+		url_download_commit_abandon(transfer->commit);
+		transfer->commit = NULL;
+		return;
+	}
+	// the last checkpoint remains valid if the data after it could not be flushed
+	if (error != URL_DOWNLOAD_ERROR_DIGEST_MISMATCH && _can_checkpoint(transfer)
+		&& (_write_checkpoint(transfer) == URL_DOWNLOAD_ERROR_NONE || transfer->checkpointed)) {
+		LOGI("[%s] slot[%d] [%s] kept to be resumed",__FUNCTION__,
+			transfer->download->slot_index, transfer->path);
+		return;
+	}
+	unlink(transfer->path);
+	if (transfer->download->checkpoint)
+		url_download_checkpoint_remove(transfer->path);
+}
+
+// account the received bytes for the progress, the scheduler and the rate limit
+static void _account(struct url_download_http_s *transfer, size_t bytes)
+{
+	url_download_h download = transfer->download;
+	struct timespec now;
+	long delay_ms = 0;
+
+	// the coded bytes of the response, else the bytes of the file like the progress
+	if (transfer->decoder != NULL) {
+		download->wire_received += bytes;
+	} else {
+		download->wire_received = transfer->received;
+		download->wire_size = download->file_size;
+	}
+	url_download_update_received_size(download, transfer->received);
+	url_download_scheduler_report_progress(bytes);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (_ms_until(&now, &transfer->last_progress) >= URL_DOWNLOAD_HTTP_PROGRESS_INTERVAL_MS) {
+		transfer->last_progress = now;
+		transfer->events |= HTTP_EVENT_PROGRESS;
+	}
+
+	if (url_download_rate_limit_enabled(download)) {
+		delay_ms = url_download_rate_limit_consume(download, bytes);
+		if (delay_ms >= URL_DOWNLOAD_THROTTLE_MIN_MS) {
+			// stop reading the sockets until the budget is refilled
+			download->resume_time.tv_sec = now.tv_sec + delay_ms / 1000;
+			download->resume_time.tv_nsec = now.tv_nsec + (delay_ms % 1000) * 1000000L;
+			if (download->resume_time.tv_nsec >= 1000000000L) {
+				download->resume_time.tv_sec++;
+				download->resume_time.tv_nsec -= 1000000000L;
+			}
+			download->throttled = 1;
+		}
+	}
+}
+
+// the coded body is decoded to the buffers of the writer
+static int _decode_body(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *data, size_t length)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	size_t produced = 0;
+	size_t remaining = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	// the decoder may have more output for the same input
+	while (length > 0 || produced == URL_DOWNLOAD_HTTP_BUFFER_SIZE) {
+		buffer = url_download_writer_get(0);
+		if (buffer == NULL) {
+			url_download_writer_wait_any();
+			continue;
+		}
+		remaining = length;
+		errorcode = url_download_decoder_run(transfer->decoder, &data, &length,
+			buffer->data, URL_DOWNLOAD_HTTP_BUFFER_SIZE, &produced, &transfer->decoded);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE || produced == 0) {
+			url_download_writer_release(buffer);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+			if (length == remaining)
+				break;
+			continue;
+		}
+		errorcode = _check_memfd(transfer, segment->offset - transfer->file_base + produced);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+			url_download_writer_release(buffer);
+			return errorcode;
+		}
+		_digest_data(transfer, segment->offset - transfer->file_base, buffer->data, produced);
+		if (transfer->archive != NULL || transfer->in_memory) {
+			if (transfer->archive != NULL)
+				errorcode = url_download_archive_write(transfer->archive, buffer->data, produced);
+			else
+				errorcode = _write_memory(transfer, segment->offset - transfer->file_base,
+					buffer->data, produced);
+			url_download_writer_release(buffer);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+		} else {
+			url_download_writer_submit(buffer, &transfer->stream, transfer->filefd,
+				segment->offset - transfer->file_base, produced);
+		}
+		segment->offset += produced;
+		transfer->received += produced;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the data is copied to the buffers of the writer, a write error is returned by a next call
+static int _write_body(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *data, size_t length)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	char *manifest = NULL;
+	size_t total = length;
+	size_t count = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	// the bytes before the range are dropped
+	if (segment->skip > 0) {
+		count = (segment->skip < (long long)length ? segment->skip : length);
+		segment->skip -= count;
+		data += count;
+		length -= count;
+	}
+	// the range may have been shortened by _steal_range()
+	if (segment->end >= 0 && segment->offset + (long long)length > segment->end)
+		length = segment->end - segment->offset;
+
+	if (transfer->delta_state == DELTA_MANIFEST) {
+		if (transfer->manifest_length + length > URL_DOWNLOAD_DELTA_MAX_MANIFEST_SIZE)
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		manifest = realloc(transfer->manifest, transfer->manifest_length + length);
+		if (manifest == NULL)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		transfer->manifest = manifest;
+		memcpy(transfer->manifest + transfer->manifest_length, data, length);
+		transfer->manifest_length += length;
+		_account(transfer, total);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	if (transfer->decoder != NULL) {
+		errorcode = _decode_body(transfer, segment, data, length);
+		_account(transfer, total);
+	} else if (transfer->archive != NULL) {
+		_digest_data(transfer, segment->offset, data, length);
+		errorcode = url_download_archive_write(transfer->archive, data, length);
+		segment->offset += length;
+		transfer->received += length;
+		_account(transfer, total);
+	} else if (transfer->in_memory) {
+		errorcode = _write_memory(transfer, segment->offset - transfer->file_base, data, length);
+		_digest_data(transfer, segment->offset - transfer->file_base, data, length);
+		segment->offset += length;
+		transfer->received += length;
+		_account(transfer, total);
+	}
+	if (transfer->archive != NULL && url_download_archive_extracted(transfer->archive))
+		transfer->events |= HTTP_EVENT_EXTRACTED;
+	if (transfer->decoder != NULL || transfer->archive != NULL || transfer->in_memory) {
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		return transfer->stream.error;
+	}
+
+	errorcode = _check_memfd(transfer, segment->offset - transfer->file_base + length);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	while (length > 0) {
+		buffer = url_download_writer_get(0);
+		if (buffer == NULL) {
+			url_download_writer_wait_any();
+			continue;
+		}
+		count = (length < URL_DOWNLOAD_HTTP_BUFFER_SIZE ? length : URL_DOWNLOAD_HTTP_BUFFER_SIZE);
+		memcpy(buffer->data, data, count);
+		_digest_data(transfer, segment->offset - transfer->file_base, buffer->data, count);
+		url_download_writer_submit(buffer, &transfer->stream, transfer->filefd,
+			segment->offset - transfer->file_base, count);
+		data += count;
+		length -= count;
+		segment->offset += count;
+		transfer->received += count;
+	}
+	_account(transfer, total);
+	return transfer->stream.error;
+}
+
+// give a half of the largest remaining range to the idle segment.
+static int _steal_range(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *idle)
+{
+	struct url_download_http_segment_s *victim = NULL;
+	long long remaining = 0;
+	long long largest = 0;
+	long long middle = 0;
+	int i = 0;
+
+	for (i = 0; i < transfer->segment_count; i++) {
+		struct url_download_http_segment_s *segment = &transfer->segments[i];
+		if (segment == idle || segment->state == HTTP_STATE_DONE || segment->end < 0)
+			continue;
+		remaining = segment->end - segment->offset;
+		if (remaining > largest) {
+			largest = remaining;
+			victim = segment;
+		}
+	}
+	if (victim == NULL || largest < 2 * URL_DOWNLOAD_HTTP_MIN_SEGMENT_SIZE)
+		return 0;
+
+	// the victim drops the rest of its response when it reaches the new end
+	middle = victim->offset + largest / 2;
+	idle->offset = middle;
+	idle->end = victim->end;
+	idle->state = HTTP_STATE_IDLE;
+	victim->end = middle;
+	LOGI("[%s] slot[%d] range [%lld-%lld] taken over",__FUNCTION__,
+		transfer->download->slot_index, idle->offset, idle->end);
+	if (_open_segment(transfer, idle, 1) != URL_DOWNLOAD_ERROR_NONE) {
+		// the victim gets its range back
+		victim->end = idle->end;
+		idle->state = HTTP_STATE_DONE;
+		return 0;
+	}
+	return 1;
+}
+
+// the manifest is not used, the whole file is downloaded from the url
+static int _delta_fallback(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	url_download_h download = transfer->download;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	LOGI("[%s] slot[%d] no delta, download the whole file",__FUNCTION__, download->slot_index);
+	transfer->delta_state = DELTA_NONE;
+	url_download_delta_free(transfer->delta);
+	transfer->delta = NULL;
+	if (transfer->manifest)
+		free(transfer->manifest);
+	transfer->manifest = NULL;
+	transfer->manifest_length = 0;
+	if (transfer->source_fd > 0)
+		close(transfer->source_fd);
+	transfer->source_fd = 0;
+
+	free(transfer->url);
+	transfer->url = strdup(download->url);
+	if (transfer->url == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	transfer->redirects = 0;
+	errorcode = _open_target(transfer);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _open_segment(transfer, segment, 1);
+	return errorcode;
+}
+
+// the manifest is received, the file is opened for the blocks of the old file
+static int _manifest_done(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	url_download_h download = transfer->download;
+	char *name = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	transfer->delta = url_download_delta_new(transfer->manifest, transfer->manifest_length);
+	free(transfer->manifest);
+	transfer->manifest = NULL;
+	transfer->manifest_length = 0;
+	if (transfer->delta != NULL)
+		transfer->source_fd = open(download->delta_source, O_RDONLY | O_CLOEXEC);
+	if (transfer->delta == NULL || transfer->source_fd < 0) {
+		if (transfer->delta != NULL)
+			LOGE("[%s] open [%s] : %s",__FUNCTION__, download->delta_source, strerror(errno));
+		transfer->source_fd = 0;
+		return _delta_fallback(transfer, segment);
+	}
+
+	free(transfer->url);
+	transfer->url = strdup(download->url);
+	if (transfer->url == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	transfer->redirects = 0;
+	errorcode = _open_target(transfer);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	name = _file_name_from_url(transfer->target.path);
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	errorcode = _open_file(transfer, name);
+	free(name);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+
+	if (download->mime_type == NULL)
+		download->mime_type = strdup("application/octet-stream");
+	transfer->started = 1;
+	transfer->accept_ranges = 1;
+	transfer->total_size = url_download_delta_length(transfer->delta);
+	download->file_size = transfer->total_size;
+	segment->offset = 0;
+	segment->end = -1;
+	if (transfer->total_size > 0) {
+		errorcode = _preallocate(transfer);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	transfer->delta_state = DELTA_SCAN;
+	transfer->events |= HTTP_EVENT_STARTED;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the segment fetches the next range of a delta download, opened is 0 if there is none left
+static int _next_range(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, int *opened)
+{
+	long long start = 0;
+	long long end = 0;
+
+	*opened = 0;
+	if (!url_download_delta_next_range(transfer->delta, &start, &end))
+		return URL_DOWNLOAD_ERROR_NONE;
+	segment->offset = start;
+	segment->end = end;
+	segment->state = HTTP_STATE_IDLE;
+	*opened = 1;
+	return _open_segment(transfer, segment, 1);
+}
+
+// the blocks of the old file are copied, the segments fetch the other ranges
+static int _fetch_ranges(struct url_download_http_s *transfer)
+{
+	struct url_download_http_segment_s *segment = NULL;
+	int count = transfer->download->segment_count;
+	int opened = 1;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	transfer->delta_state = DELTA_FETCH;
+	if (count > URL_DOWNLOAD_HTTP_MAX_SEGMENTS)
+		count = URL_DOWNLOAD_HTTP_MAX_SEGMENTS;
+	if (count < 1)
+		count = 1;
+	for (i = 0; i < count && opened && errorcode == URL_DOWNLOAD_ERROR_NONE; i++) {
+		segment = &transfer->segments[i];
+		memset(segment, 0x00, sizeof(struct url_download_http_segment_s));
+		segment->state = HTTP_STATE_DONE;
+		if (i >= transfer->segment_count)
+			transfer->segment_count = i + 1;
+		errorcode = _next_range(transfer, segment, &opened);
+		if (!opened)
+			segment->state = HTTP_STATE_DONE;
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	// the whole file was in the old file
+	if (transfer->segments[0].state == HTTP_STATE_DONE)
+		_complete(transfer);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static void _segment_done(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int opened = 0;
+	int i = 0;
+
+	// the connection is ready for another request after a complete response
+	if (segment->keep_alive && segment->response_complete && segment->sockfd > 0
+		&& (segment->tls == NULL || url_download_tls_pending(segment->tls) == 0)) {
+		_idle_put(transfer->target.host, transfer->target.port, segment->sockfd, segment->tls);
+		segment->sockfd = 0;
+		segment->tls = NULL;
+	}
+	_close_socket(segment);
+	_reset_response(segment);
+	segment->state = HTTP_STATE_DONE;
+
+	if (transfer->delta_state == DELTA_MANIFEST)
+		errorcode = _manifest_done(transfer, segment);
+	else if (transfer->delta_state == DELTA_FETCH)
+		errorcode = _next_range(transfer, segment, &opened);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+		_fail(transfer, errorcode);
+		return;
+	}
+	if (opened || transfer->delta_state == DELTA_SCAN)
+		return;
+
+	if (transfer->segment_count > 1 && _steal_range(transfer, segment))
+		return;
+
+	for (i = 0; i < transfer->segment_count; i++) {
+		if (transfer->segments[i].state != HTTP_STATE_DONE)
+			return;
+	}
+	_complete(transfer);
+}
+
+// REF : http://tools.ietf.org/html/rfc2616#section-3.6.1
+static int _receive_chunked(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *data, size_t length)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	size_t size = 0;
+	char c = 0;
+
+	while (length > 0 && segment->state == HTTP_STATE_BODY) {
+		switch (segment->chunk_state) {
+		case CHUNK_SIZE:
+		case CHUNK_TRAILER:
+			c = *data++;
+			length--;
+			if (c != '\n') {
+				// the chunk extensions are not needed, a long line is cut
+				if (c != '\r' && segment->chunk_line_length < sizeof(segment->chunk_line) - 1)
+					segment->chunk_line[segment->chunk_line_length++] = c;
+				break;
+			}
+			segment->chunk_line[segment->chunk_line_length] = '\0';
+			if (segment->chunk_state == CHUNK_TRAILER) {
+				if (segment->chunk_line_length == 0) {
+					segment->response_complete = 1;
+					_segment_done(transfer, segment);
+				}
+			} else if (!isxdigit((unsigned char)segment->chunk_line[0])) {
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			} else {
+				segment->chunk_remaining = strtoll(segment->chunk_line, NULL, 16);
+				if (segment->chunk_remaining > 0)
+					segment->chunk_state = CHUNK_DATA;
+				else
+					segment->chunk_state = CHUNK_TRAILER;
+			}
+			segment->chunk_line_length = 0;
+			break;
+		case CHUNK_DATA:
+			size = length;
+			if ((long long)size > segment->chunk_remaining)
+				size = segment->chunk_remaining;
+			errorcode = _write_body(transfer, segment, data, size);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+			data += size;
+			length -= size;
+			segment->chunk_remaining -= size;
+			if (segment->chunk_remaining == 0)
+				segment->chunk_state = CHUNK_DATA_END;
+			// the end of the range before the end of the response
+			if (segment->end >= 0 && segment->offset >= segment->end)
+				_segment_done(transfer, segment);
+			break;
+		case CHUNK_DATA_END:
+			c = *data++;
+			length--;
+			if (c == '\n')
+				segment->chunk_state = CHUNK_SIZE;
+			break;
+		}
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _body_received(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment);
+
+static int _receive_body(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *data, size_t length)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (segment->chunked)
+		return _receive_chunked(transfer, segment, data, length);
+
+	if (segment->content_length >= 0
+		&& segment->response_received + (long long)length > segment->content_length)
+		length = segment->content_length - segment->response_received;
+	segment->response_received += length;
+	if (segment->response_received == segment->content_length)
+		segment->response_complete = 1;
+
+	if (length > 0) {
+		errorcode = _write_body(transfer, segment, data, length);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	return _body_received(transfer, segment);
+}
+
+// the segment is over at the end of its range or at the end of the response
+static int _body_received(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	if (segment->end >= 0 && segment->offset >= segment->end) {
+		_segment_done(transfer, segment);
+	} else if (segment->content_length >= 0
+		&& segment->response_received >= segment->content_length) {
+		// the response ended before the range
+		if (segment->end >= 0)
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		_segment_done(transfer, segment);
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// returns the bytes of the segment to splice, 0 if they are copied through a buffer
+static size_t _splice_length(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	long long length = URL_DOWNLOAD_HTTP_BUFFER_SIZE;
+
+	if (transfer->buffered || transfer->stream.buffered || segment->tls != NULL || segment->skip > 0
+		|| transfer->decoder != NULL || segment->state != HTTP_STATE_BODY || segment->chunked
+		|| transfer->delta_state == DELTA_MANIFEST || transfer->archive != NULL || transfer->in_memory)
+		return 0;
+	// the bytes to hash go through the buffers
+	if (transfer->digest != NULL && segment->offset - transfer->file_base == transfer->digest_offset)
+		return 0;
+	if (segment->content_length >= 0 && segment->content_length - segment->response_received < length)
+		length = segment->content_length - segment->response_received;
+	if (segment->end >= 0 && segment->end - segment->offset < length)
+		length = segment->end - segment->offset;
+	if (length <= 0)
+		return 0;
+	return length;
+}
+
+// the end of the body is the end of the connection only without length
+static int _on_closed(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	if (segment->state == HTTP_STATE_BODY && segment->end < 0
+		&& segment->content_length < 0 && !segment->chunked) {
+		_segment_done(transfer, segment);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+}
+
+// the body goes from the socket to a pipe of the writer, which splices it to the file
+static int _splice_body(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t length)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	ssize_t received = 0;
+
+	buffer = url_download_writer_get(1);
+	if (buffer == NULL) {
+		// all the buffers are in flight, or there is no pipe
+		if (url_download_writer_available() > 0)
+			transfer->buffered = 1;
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	received = splice(segment->sockfd, NULL, buffer->pipe[1], NULL, length,
+		SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (received < 0) {
+		if (errno == EAGAIN || errno == EINTR) {
+			url_download_writer_release(buffer);
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+		if (errno == EINVAL || errno == ENOSYS) {
+			LOGI("[%s] slot[%d] splice not supported, copy the body",__FUNCTION__,
+				transfer->download->slot_index);
+			url_download_writer_release(buffer);
+			transfer->buffered = 1;
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+		url_download_writer_release(buffer);
+		return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+	}
+	_set_deadline(segment);
+	if (received == 0) {
+		url_download_writer_release(buffer);
+		return _on_closed(transfer, segment);
+	}
+
+	url_download_writer_submit(buffer, &transfer->stream, transfer->filefd,
+		segment->offset - transfer->file_base, received);
+	segment->response_received += received;
+	if (segment->response_received == segment->content_length)
+		segment->response_complete = 1;
+	segment->offset += received;
+	transfer->received += received;
+	_account(transfer, received);
+	if (transfer->stream.error != URL_DOWNLOAD_ERROR_NONE)
+		return transfer->stream.error;
+	return _body_received(transfer, segment);
+}
+
+// the location of a redirection, relative to the url requested
+static char *_resolve_location(struct url_download_http_s *transfer, const char *location)
+{
+	struct url_download_url_s *target = &transfer->target;
+	char *url = NULL;
+	size_t size = 0;
+	size_t directory_length = 0;
+
+	if (strstr(location, "://") != NULL)
+		return strdup(location);
+
+	size = strlen(target->scheme) + strlen(target->host) + strlen(target->path)
+		+ strlen(location) + 32;
+	url = calloc(size, sizeof(char));
+	if (url == NULL)
+		return NULL;
+
+	if (strncmp(location, "//", 2) == 0) {
+		snprintf(url, size, "%s:%s", target->scheme, location);
+	} else if (location[0] == '/') {
+		snprintf(url, size, "%s://%s%s%s:%d%s", target->scheme,
+			strchr(target->host, ':') ? "[" : "", target->host,
+			strchr(target->host, ':') ? "]" : "", target->port, location);
+	} else {
+		directory_length = strcspn(target->path, "?");
+		while (directory_length > 0 && target->path[directory_length - 1] != '/')
+			directory_length--;
+		snprintf(url, size, "%s://%s%s%s:%d%.*s%s", target->scheme,
+			strchr(target->host, ':') ? "[" : "", target->host,
+			strchr(target->host, ':') ? "]" : "", target->port,
+			(int)directory_length, target->path, location);
+	}
+	return url;
+}
+
+static char *_trim(char *value)
+{
+	char *end = NULL;
+
+	while (*value == ' ' || *value == '\t')
+		value++;
+	end = value + strlen(value);
+	while (end > value && (*(end - 1) == ' ' || *(end - 1) == '\t'))
+		*--end = '\0';
+	return value;
+}
+
+static int _has_token(const char *value, const char *token)
+{
+	size_t length = strlen(token);
+
+	for (; *value != '\0'; value++) {
+		if (strncasecmp(value, token, length) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int _redirect(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *location)
+{
+	char *url = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (++transfer->redirects > URL_DOWNLOAD_HTTP_MAX_REDIRECTS)
+		return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+
+	url = _resolve_location(transfer, location);
+	if (url == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	LOGI("[%s] slot[%d] redirected to [%s]",__FUNCTION__, transfer->download->slot_index, url);
+	free(transfer->url);
+	transfer->url = url;
+
+	errorcode = _open_target(transfer);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _open_segment(transfer, segment, 1);
+	return errorcode;
+}
+
+// fetch the rest of the file over more connections, each one a range of it
+static int _split_segments(struct url_download_http_s *transfer)
+{
+	struct url_download_http_segment_s *segment = NULL;
+	long long start = transfer->segments[0].offset;
+	long long size = 0;
+	int count = transfer->download->segment_count;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	// an archive is extracted in order
+	if (!transfer->accept_ranges || transfer->total_size <= 0 || transfer->archive != NULL)
+		return URL_DOWNLOAD_ERROR_NONE;
+	if (count > URL_DOWNLOAD_HTTP_MAX_SEGMENTS)
+		count = URL_DOWNLOAD_HTTP_MAX_SEGMENTS;
+	if (count > transfer->total_size / URL_DOWNLOAD_HTTP_MIN_SEGMENT_SIZE)
+		count = transfer->total_size / URL_DOWNLOAD_HTTP_MIN_SEGMENT_SIZE;
+	if (count <= 1)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	LOGI("[%s] slot[%d] %d segments for [%lld] bytes",__FUNCTION__,
+		transfer->download->slot_index, count, transfer->total_size);
+	size = transfer->total_size / count;
+	// the first segment goes on with the response in progress
+	transfer->segments[0].end = start + size;
+	for (i = 1; i < count && errorcode == URL_DOWNLOAD_ERROR_NONE; i++) {
+		segment = &transfer->segments[i];
+		memset(segment, 0x00, sizeof(struct url_download_http_segment_s));
+		segment->offset = start + size * i;
+		segment->end = start + (i == count - 1 ? transfer->total_size : size * (i + 1));
+		transfer->segment_count = i + 1;
+		errorcode = _open_segment(transfer, segment, 1);
+	}
+	return errorcode;
+}
+
+// the first response of a range : the bytes [first, last] of a file of complete bytes
+// for a 206, the whole file for a 200 whose bytes before the range are dropped.
+static int _check_range(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, long long first, long long last, long long complete)
+{
+	long long suffix = transfer->range_suffix;
+
+	if (segment->status == 206) {
+		if (suffix > 0) {
+			if (complete >= 0 && first != (complete > suffix ? complete - suffix : 0))
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			segment->offset = first;
+		}
+		if (first != segment->offset || last < first)
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		// a range past the end of the file is shortened
+		if (segment->end >= 0 && last + 1 != segment->end
+			&& (last + 1 > segment->end || complete < 0 || last + 1 != complete))
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		segment->end = last + 1;
+	} else {
+		if (suffix > 0) {
+			if (segment->content_length < 0)
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			segment->offset = (segment->content_length > suffix ? segment->content_length - suffix : 0);
+		}
+		if (segment->content_length >= 0
+			&& (segment->end < 0 || segment->end > segment->content_length))
+			segment->end = segment->content_length;
+		if (segment->end >= 0 && segment->offset >= segment->end)
+			return URL_DOWNLOAD_ERROR_NO_DATA;
+		LOGI("[%s] slot[%d] range not supported, [%lld] bytes skipped",__FUNCTION__,
+			transfer->download->slot_index, segment->offset);
+		segment->skip = segment->offset;
+	}
+	transfer->range_suffix = 0;
+	if (!transfer->in_place)
+		transfer->file_base = segment->offset;
+	else
+		transfer->digest_start = transfer->digest_offset = segment->offset;
+	transfer->total_size = (segment->end >= 0 ? segment->end - segment->offset : -1);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _probe_field(char **field, const char *value)
+{
+	if (*field)
+		free(*field);
+	*field = NULL;
+	if (value == NULL)
+		return URL_DOWNLOAD_ERROR_NONE;
+	*field = strdup(value);
+	return (*field ? URL_DOWNLOAD_ERROR_NONE : URL_DOWNLOAD_ERROR_OUT_OF_MEMORY);
+}
+
+// the connection of a complete response goes back to the idle connections
+static void _release_segment(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t header_end, int bodyless)
+{
+	size_t body_length = segment->header_length - header_end;
+
+	// the responses to HEAD and the 304 have no body, whatever their header says
+	if (segment->keep_alive && (segment->tls == NULL || url_download_tls_pending(segment->tls) == 0)
+		&& (bodyless ? body_length == 0
+			: (!segment->chunked && segment->content_length == (long long)body_length))) {
+		_idle_put(transfer->target.host, transfer->target.port, segment->sockfd, segment->tls);
+		segment->sockfd = 0;
+		segment->tls = NULL;
+	}
+	_close_segment(segment);
+}
+
+// the response header of a probe, the transfer is finished with the metadata
+static int _probe_response(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t header_end,
+		const char *location, int accept_ranges, long long range_complete)
+{
+	struct url_download_http_probe_s *probe = transfer->probe;
+	int status = segment->status;
+
+	if (status == 301 || status == 302 || status == 303 || status == 307 || status == 308) {
+		if (location == NULL)
+			return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+		return _redirect(transfer, segment, location);
+	}
+	// some servers refuse HEAD, the range of the first byte gives the size of the file
+	if (probe->head && status >= 400 && status != 404 && status != 410) {
+		LOGI("[%s] slot[%d] HEAD refused [%d], range request",__FUNCTION__,
+			transfer->download->slot_index, status);
+		probe->head = 0;
+		_release_segment(transfer, segment, header_end, probe->head);
+		return _open_segment(transfer, segment, 1);
+	}
+
+	if (status == 206 || (status == 416 && !probe->head)) {
+		// the file is empty for a 416
+		probe->content_length = range_complete;
+		accept_ranges = 1;
+	} else if (status >= 200 && status < 300) {
+		probe->content_length = segment->content_length;
+	} else {
+		return _status_error(status);
+	}
+	probe->accept_ranges = accept_ranges;
+	segment->state = HTTP_STATE_DONE;
+	_release_segment(transfer, segment, header_end, probe->head);
+	transfer->finished = 1;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the remote file changed since the checkpoint, it is downloaded again from its start
+static int _restart_resumed(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, int accept_ranges,
+		const char *etag, const char *last_modified)
+{
+	url_download_h download = transfer->download;
+	int i = 0;
+
+	LOGI("[%s] slot[%d] [%s] changed since its checkpoint",__FUNCTION__,
+		download->slot_index, download->url);
+	for (i = 0; i < transfer->segment_count; i++) {
+		if (&transfer->segments[i] == segment)
+			continue;
+		_close_segment(&transfer->segments[i]);
+		transfer->segments[i].state = HTTP_STATE_DONE;
+	}
+	url_download_checkpoint_remove(transfer->path);
+	transfer->resumed = 0;
+	transfer->checkpointed = 0;
+	url_download_writer_wait(&transfer->stream);
+	if (ftruncate(transfer->filefd, 0) < 0)
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	segment->offset = 0;
+	segment->end = -1;
+	transfer->received = 0;
+	transfer->accept_ranges = accept_ranges;
+	transfer->total_size = segment->content_length;
+	download->file_size = (transfer->total_size > 0 ? transfer->total_size : 0);
+
+	if (transfer->etag)
+		free(transfer->etag);
+	if (transfer->last_modified)
+		free(transfer->last_modified);
+	transfer->etag = (etag ? strdup(etag) : NULL);
+	transfer->last_modified = (last_modified ? strdup(last_modified) : NULL);
+	if ((etag != NULL && transfer->etag == NULL) || (last_modified != NULL && transfer->last_modified == NULL))
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	return _digest_reset(transfer);
+}
+
+// the response header of the manifest, the whole file is downloaded without it
+static int _manifest_response(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t header_end)
+{
+	url_download_h download = transfer->download;
+
+	if (segment->status == 200 && segment->content_length <= URL_DOWNLOAD_DELTA_MAX_MANIFEST_SIZE) {
+		if (transfer->manifest)
+			free(transfer->manifest);
+		transfer->manifest = NULL;
+		transfer->manifest_length = 0;
+		url_download_decoder_free(transfer->decoder);
+		transfer->decoder = NULL;
+		segment->state = HTTP_STATE_BODY;
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	LOGI("[%s] slot[%d] manifest status [%d]",__FUNCTION__, download->slot_index, segment->status);
+	_release_segment(transfer, segment, header_end, 0);
+	return _delta_fallback(transfer, segment);
+}
+
+// the file is a copy of the object of the content store instead of the remote
+// file, digest is the name of the object if it was looked up by digest.
+static int _open_stored(struct url_download_http_s *transfer, const char *object, const char *digest)
+{
+	url_download_h download = transfer->download;
+	struct stat st;
+	char *name = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	for (i = 0; i < transfer->segment_count; i++)
+		_close_segment(&transfer->segments[i]);
+	transfer->segment_count = 0;
+	transfer->local = 1;
+	transfer->stored = 1;
+	transfer->source_fd = open(object, O_RDONLY | O_CLOEXEC);
+	if (transfer->source_fd < 0 || fstat(transfer->source_fd, &st) < 0) {
+		LOGE("[%s] open [%s] : %s",__FUNCTION__, object, strerror(errno));
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	// the content is the one of the expected digest, it is not read back
+	// nor hashed for the store only
+	if (digest != NULL || download->digest_type == URL_DOWNLOAD_DIGEST_NONE) {
+		url_download_digest_free(transfer->digest);
+		transfer->digest = NULL;
+	}
+	if (digest != NULL) {
+		download->digest = strdup(digest);
+		if (download->digest == NULL)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	if (transfer->target.path == NULL) {
+		errorcode = url_download_url_parse(transfer->url, &transfer->target);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	name = _file_name_from_url(transfer->target.path);
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	errorcode = _open_file(transfer, name);
+	free(name);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	transfer->started = 1;
+	transfer->total_size = st.st_size;
+	download->file_size = st.st_size;
+	transfer->events |= HTTP_EVENT_STARTED;
+
+	// the blocks are shared if the file system supports it, the object is linked otherwise,
+	// else the file is copied by slices like a file:// url
+	if (st.st_size > 0 && url_download_local_clone(transfer->source_fd, transfer->filefd)
+		== URL_DOWNLOAD_ERROR_NONE) {
+		LOGI("[%s] slot[%d] cloned from [%s]",__FUNCTION__, download->slot_index, object);
+	} else if (url_download_store_link(object, transfer->path) == URL_DOWNLOAD_ERROR_NONE) {
+		LOGI("[%s] slot[%d] linked to [%s]",__FUNCTION__, download->slot_index, object);
+		// the file opened was replaced, the digest reads the link
+		close(transfer->filefd);
+		transfer->filefd = open(transfer->path, O_RDONLY | O_CLOEXEC);
+		if (transfer->filefd < 0) {
+			transfer->filefd = 0;
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		}
+	} else {
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	transfer->received = st.st_size;
+	transfer->local_done = 1;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the file of the revalidation index was not modified, the transfer completes with it
+static int _not_modified(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t header_end)
+{
+	url_download_h download = transfer->download;
+	struct stat st;
+	const char *name = NULL;
+
+	segment->state = HTTP_STATE_DONE;
+	_release_segment(transfer, segment, header_end, 1);
+	if (stat(transfer->cached_path, &st) < 0) {
+		LOGE("[%s] stat [%s] : %s",__FUNCTION__, transfer->cached_path, strerror(errno));
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	LOGI("[%s] slot[%d] [%s] not modified",__FUNCTION__, download->slot_index, transfer->cached_path);
+
+	if (download->completed_path)
+		free(download->completed_path);
+	download->completed_path = strdup(transfer->cached_path);
+	if (download->completed_path == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	if (download->content_name == NULL) {
+		name = strrchr(transfer->cached_path, '/');
+		download->content_name = strdup(name ? name + 1 : transfer->cached_path);
+	}
+	download->not_modified = 1;
+	download->file_size = st.st_size;
+	transfer->total_size = st.st_size;
+	transfer->received = st.st_size;
+	transfer->started = 1;
+	transfer->finished = 1;
+	transfer->events |= HTTP_EVENT_STARTED | HTTP_EVENT_PROGRESS | HTTP_EVENT_COMPLETED;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// parse the status line and the header fields, the body starts at header_end.
+static int _parse_headers(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, size_t header_end)
+{
+	url_download_h download = transfer->download;
+	char *line = segment->header;
+	char *next = NULL;
+	char *value = NULL;
+	char *location = NULL;
+	char *content_type = NULL;
+	char *content_encoding = NULL;
+	char *etag = NULL;
+	char *last_modified = NULL;
+	char *name = NULL;
+	char *object = NULL;
+	long long range_start = -1;
+	long long range_last = -1;
+	long long range_complete = -1;
+	int accept_ranges = 0;
+	int major = 0;
+	int minor = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	segment->header[header_end - 2] = '\0';
+
+	if (sscanf(line, "HTTP/%d.%d %d", &major, &minor, &segment->status) != 3)
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	// REF : http://tools.ietf.org/html/rfc2616#section-8.1.2.1
+	segment->keep_alive = (major > 1 || (major == 1 && minor >= 1));
+
+	for (line = strstr(line, "\r\n"); line != NULL; line = next) {
+		line += 2;
+		next = strstr(line, "\r\n");
+		if (next)
+			*next = '\0';
+		value = strchr(line, ':');
+		if (value == NULL)
+			continue;
+		*value++ = '\0';
+		value = _trim(value);
+		if (strcasecmp(line, "Content-Length") == 0)
+			segment->content_length = strtoll(value, NULL, 10);
+		else if (strcasecmp(line, "Transfer-Encoding") == 0)
+			segment->chunked = _has_token(value, "chunked");
+		else if (strcasecmp(line, "Location") == 0)
+			location = value;
+		else if (strcasecmp(line, "Content-Type") == 0)
+			content_type = value;
+		else if (strcasecmp(line, "Content-Encoding") == 0)
+			content_encoding = value;
+		else if (strcasecmp(line, "Content-Range") == 0) {
+			// "bytes */length" comes with a 416
+			if (sscanf(value, "bytes */%lld", &range_complete) != 1)
+				sscanf(value, "bytes %lld-%lld/%lld", &range_start, &range_last, &range_complete);
+		} else if (strcasecmp(line, "ETag") == 0)
+			etag = value;
+		else if (strcasecmp(line, "Last-Modified") == 0)
+			last_modified = value;
+		else if (strcasecmp(line, "Accept-Ranges") == 0)
+			accept_ranges = _has_token(value, "bytes");
+		else if (strcasecmp(line, "Connection") == 0)
+			segment->keep_alive = (_has_token(value, "close") ? 0
+				: (_has_token(value, "keep-alive") ? 1 : segment->keep_alive));
+	}
+	if (segment->chunked)
+		segment->content_length = -1;
+
+	LOGI("[%s] slot[%d] status [%d] length [%lld]",__FUNCTION__,
+		download->slot_index, segment->status, segment->content_length);
+
+	if (transfer->probe != NULL) {
+		if (content_type)
+			content_type[strcspn(content_type, ";")] = '\0';
+		if (_probe_field(&transfer->probe->mime_type, content_type ? _trim(content_type) : NULL)
+			!= URL_DOWNLOAD_ERROR_NONE
+			|| _probe_field(&transfer->probe->etag, etag) != URL_DOWNLOAD_ERROR_NONE
+			|| _probe_field(&transfer->probe->last_modified, last_modified) != URL_DOWNLOAD_ERROR_NONE)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		return _probe_response(transfer, segment, header_end, location, accept_ranges, range_complete);
+	}
+	if (transfer->delta_state == DELTA_MANIFEST && (segment->status < 300 || segment->status >= 400))
+		return _manifest_response(transfer, segment, header_end);
+
+	switch (segment->status) {
+	case 301:
+	case 302:
+	case 303:
+	case 307:
+	case 308:
+		// the other segments request the final url
+		if (location == NULL || transfer->started)
+			return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+		return _redirect(transfer, segment, location);
+	case 200:
+		if (transfer->resumed) {
+			errorcode = _restart_resumed(transfer, segment, accept_ranges, etag, last_modified);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+		// the bytes before the range are dropped
+		} else if ((transfer->ranged || transfer->delta_state == DELTA_FETCH) && transfer->started) {
+			segment->skip = segment->offset;
+		} else if (segment->offset > 0 && !transfer->ranged) {
+			// the server ignored the range
+			if (transfer->segment_count > 1)
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			// the bytes extracted are dropped
+			if (transfer->archive != NULL) {
+				segment->skip = segment->offset;
+				break;
+			}
+			LOGI("[%s] slot[%d] range not satisfied, restart",__FUNCTION__, download->slot_index);
+			url_download_writer_wait(&transfer->stream);
+			transfer->memory_length = 0;
+			if (!transfer->in_memory && ftruncate(transfer->filefd, 0) < 0)
+				return URL_DOWNLOAD_ERROR_IO_ERROR;
+			segment->offset = 0;
+			transfer->received = 0;
+			errorcode = _digest_reset(transfer);
+			if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+				return errorcode;
+		}
+		break;
+	case 206:
+		if (range_start != segment->offset && transfer->range_suffix == 0)
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		// the file of the manifest, or of the checkpoint, was replaced
+		if ((transfer->delta_state == DELTA_FETCH || transfer->resumed)
+			&& range_complete != transfer->total_size)
+			return URL_DOWNLOAD_ERROR_IO_ERROR;
+		accept_ranges = 1;
+		break;
+	case 304:
+		if (transfer->cached_path == NULL || transfer->started)
+			return _status_error(segment->status);
+		return _not_modified(transfer, segment, header_end);
+	default:
+		return _status_error(segment->status);
+	}
+
+	segment->state = HTTP_STATE_BODY;
+	url_download_decoder_free(transfer->decoder);
+	transfer->decoder = NULL;
+	transfer->decoded = 0;
+	if (download->content_decoding && content_encoding != NULL
+		&& strcasecmp(content_encoding, "identity") != 0) {
+		transfer->decoder = url_download_decoder_new(content_encoding);
+		if (transfer->decoder == NULL)
+			LOGE("[%s] slot[%d] Content-Encoding [%s] not supported, stored as is",__FUNCTION__,
+				download->slot_index, content_encoding);
+	}
+	// a coded body is downloaded again from its beginning
+	if (transfer->decoder != NULL) {
+		download->wire_received = 0;
+		download->wire_size = (segment->content_length > 0 ? segment->content_length : 0);
+	}
+	if (transfer->started)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	if (content_type) {
+		content_type[strcspn(content_type, ";")] = '\0';
+		if (download->mime_type)
+			free(download->mime_type);
+		download->mime_type = strdup(_trim(content_type));
+	}
+	if ((etag != NULL && (transfer->etag = strdup(etag)) == NULL)
+		|| (last_modified != NULL && (transfer->last_modified = strdup(last_modified)) == NULL))
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	// the body of the url with this ETag is in the content store
+	if (_strong_etag(transfer) != NULL && !transfer->ranged && _to_file(download)
+		&& transfer->decoder == NULL && url_download_store_enabled()) {
+		object = url_download_store_find_etag(download->url, transfer->etag);
+		if (object != NULL) {
+			LOGI("[%s] slot[%d] ETag %s in the content store",__FUNCTION__,
+				download->slot_index, transfer->etag);
+			errorcode = _open_stored(transfer, object, NULL);
+			free(object);
+			return errorcode;
+		}
+	}
+
+	if (download->archive_extraction) {
+		errorcode = _open_archive(transfer);
+	} else {
+		name = _file_name_from_url(transfer->target.path);
+		if (name == NULL)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		errorcode = _open_file(transfer, name);
+		free(name);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	transfer->started = 1;
+	transfer->accept_ranges = accept_ranges;
+	transfer->total_size = segment->content_length;
+	if (transfer->ranged) {
+		errorcode = _check_range(transfer, segment, range_start, range_last, range_complete);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+	}
+	// the size of a coded body is not the size of the file
+	if (transfer->decoder != NULL) {
+		transfer->accept_ranges = 0;
+		transfer->total_size = -1;
+	}
+	download->file_size = (transfer->total_size > 0 ? transfer->total_size : 0);
+	if (transfer->total_size > 0 && transfer->in_memory)
+		errorcode = _reserve_memory(transfer, transfer->total_size);
+	else if (transfer->total_size > 0 && download->destination_type == URL_DOWNLOAD_DESTINATION_MEMFD)
+		errorcode = _check_memfd(transfer, transfer->total_size);
+	else if (transfer->total_size > 0 && _to_file(download))
+		errorcode = _preallocate(transfer);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	transfer->events |= HTTP_EVENT_STARTED;
+
+	return _split_segments(transfer);
+}
+
+static int _receive_headers(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, const char *data, size_t length)
+{
+	char *header = NULL;
+	char *end = NULL;
+	char *body = NULL;
+	size_t header_end = 0;
+	size_t body_length = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (segment->header_length + length > URL_DOWNLOAD_HTTP_MAX_HEADER_SIZE)
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+
+	header = realloc(segment->header, segment->header_length + length + 1);
+	if (header == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	memcpy(header + segment->header_length, data, length);
+	segment->header = header;
+	segment->header_length += length;
+	segment->header[segment->header_length] = '\0';
+
+	end = strstr(segment->header, "\r\n\r\n");
+	if (end == NULL)
+		return URL_DOWNLOAD_ERROR_NONE;
+	header_end = end - segment->header + 4;
+
+	// the beginning of the body came with the header
+	body_length = segment->header_length - header_end;
+	if (body_length > 0) {
+		body = malloc(body_length);
+		if (body == NULL)
+			return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+		memcpy(body, segment->header + header_end, body_length);
+	}
+
+	errorcode = _parse_headers(transfer, segment, header_end);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE && segment->state == HTTP_STATE_BODY) {
+		if (segment->content_length == 0 && !segment->chunked) {
+			segment->response_complete = 1;
+			_segment_done(transfer, segment);
+		}
+		else if (body_length > 0)
+			errorcode = _receive_body(transfer, segment, body, body_length);
+	}
+	if (body)
+		free(body);
+	return errorcode;
+}
+
+static int _on_handshake(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int done = 0;
+
+	errorcode = url_download_tls_handshake(segment->tls, &done);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	_set_deadline(segment);
+	if (done)
+		segment->state = HTTP_STATE_SENDING;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _on_writable(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	int error = 0;
+	socklen_t length = sizeof(error);
+	ssize_t sent = 0;
+
+	if (segment->state == HTTP_STATE_CONNECTING) {
+		if (getsockopt(segment->sockfd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+			error = errno;
+		if (error != 0) {
+			LOGE("[%s] connect : %s",__FUNCTION__, strerror(error));
+			segment->addr = segment->addr->ai_next;
+			return _connect(segment);
+		}
+		if (transfer->secure) {
+			segment->tls = url_download_tls_new(segment->sockfd,
+				transfer->target.host, transfer->target.port);
+			if (segment->tls == NULL)
+				return URL_DOWNLOAD_ERROR_SSL_FAILED;
+			segment->state = HTTP_STATE_HANDSHAKE;
+			return _on_handshake(transfer, segment);
+		}
+		segment->state = HTTP_STATE_SENDING;
+	}
+
+	if (segment->tls)
+		sent = url_download_tls_write(segment->tls, segment->request + segment->request_sent,
+			segment->request_length - segment->request_sent);
+	else
+		sent = send(segment->sockfd, segment->request + segment->request_sent,
+			segment->request_length - segment->request_sent, MSG_NOSIGNAL);
+	if (sent < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return URL_DOWNLOAD_ERROR_NONE;
+		return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+	}
+	segment->request_sent += sent;
+	if (segment->request_sent >= segment->request_length)
+		segment->state = HTTP_STATE_HEADERS;
+	_set_deadline(segment);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _on_readable(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment)
+{
+	static char buffer[URL_DOWNLOAD_HTTP_BUFFER_SIZE];
+	ssize_t received = 0;
+	size_t length = 0;
+
+	// the data stays in the socket until the storage catches up
+	if (segment->state == HTTP_STATE_BODY && url_download_writer_available() == 0)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	length = _splice_length(transfer, segment);
+	if (length > 0)
+		return _splice_body(transfer, segment, length);
+
+	if (segment->tls)
+		received = url_download_tls_read(segment->tls, buffer, sizeof(buffer));
+	else
+		received = recv(segment->sockfd, buffer, sizeof(buffer), 0);
+	if (received < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return URL_DOWNLOAD_ERROR_NONE;
+		return URL_DOWNLOAD_ERROR_CONNECTION_FAILED;
+	}
+	_set_deadline(segment);
+
+	if (received == 0)
+		return _on_closed(transfer, segment);
+
+	if (segment->state == HTTP_STATE_HEADERS)
+		return _receive_headers(transfer, segment, buffer, received);
+	return _receive_body(transfer, segment, buffer, received);
+}
+
+static void _process(struct url_download_http_s *transfer,
+		struct url_download_http_segment_s *segment, short revents)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	// the events polled are the ones of the state, a TLS connection may wait for both
+	if (segment->state == HTTP_STATE_CONNECTING || segment->state == HTTP_STATE_SENDING) {
+		if (revents & (POLLIN | POLLOUT | POLLERR | POLLHUP))
+			errorcode = _on_writable(transfer, segment);
+	} else if (segment->state == HTTP_STATE_HANDSHAKE) {
+		if (revents & (POLLIN | POLLOUT | POLLERR | POLLHUP))
+			errorcode = _on_handshake(transfer, segment);
+	} else if (revents & (POLLIN | POLLOUT | POLLERR | POLLHUP)) {
+		errorcode = _on_readable(transfer, segment);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE && segment->reused && segment->header_length == 0) {
+		// the server closed the idle connection in the meantime, the request is sent again
+		LOGI("[%s] slot[%d] reused connection closed, reconnect",__FUNCTION__,
+			transfer->download->slot_index);
+		errorcode = _open_segment(transfer, segment, 0);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		_fail(transfer, errorcode);
+}
+
+static int _open_local(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	struct stat st;
+	char *path = NULL;
+	char *name = NULL;
+	char *mime_type = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	transfer->local = 1;
+	transfer->segment_count = 0;
+	if (strncasecmp(transfer->url, "file:", 5) == 0) {
+		errorcode = url_download_url_get_file_path(transfer->url, &path);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		transfer->source_fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (transfer->source_fd < 0 || fstat(transfer->source_fd, &st) < 0
+			|| !S_ISREG(st.st_mode)) {
+			LOGE("[%s] open [%s] : %s",__FUNCTION__, path, strerror(errno));
+			free(path);
+			return URL_DOWNLOAD_ERROR_INVALID_URL;
+		}
+		transfer->total_size = st.st_size;
+		name = _file_name_from_url(path);
+		free(path);
+		mime_type = strdup("application/octet-stream");
+	} else {
+		errorcode = url_download_url_parse_data(transfer->url, &mime_type,
+			&transfer->source_base64, &transfer->source_data, &transfer->source_length);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+			return errorcode;
+		if (transfer->source_base64)
+			transfer->total_size = url_download_base64_length(transfer->source_data,
+				transfer->source_length);
+		else
+			transfer->total_size = transfer->source_length;
+		if (transfer->total_size < 0) {
+			free(mime_type);
+			return URL_DOWNLOAD_ERROR_INVALID_URL;
+		}
+		name = strdup("download");
+	}
+	if (name == NULL || mime_type == NULL) {
+		if (name)
+			free(name);
+		if (mime_type)
+			free(mime_type);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	errorcode = _open_file(transfer, name);
+	free(name);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+		free(mime_type);
+		return errorcode;
+	}
+	transfer->started = 1;
+	download->file_size = transfer->total_size;
+	if (download->mime_type)
+		free(download->mime_type);
+	download->mime_type = mime_type;
+	transfer->events |= HTTP_EVENT_STARTED;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _copy_file(struct url_download_http_s *transfer, size_t *copied)
+{
+	long long length = transfer->total_size - transfer->received;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	*copied = 0;
+	if (transfer->received == 0 && length > 0
+		&& url_download_local_clone(transfer->source_fd, transfer->filefd) == URL_DOWNLOAD_ERROR_NONE) {
+		LOGI("[%s] slot[%d] cloned",__FUNCTION__, transfer->download->slot_index);
+		*copied = length;
+		transfer->local_done = 1;
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	if (length > URL_DOWNLOAD_LOCAL_SLICE_SIZE)
+		length = URL_DOWNLOAD_LOCAL_SLICE_SIZE;
+	if (length > 0)
+		errorcode = url_download_local_copy(transfer->source_fd, transfer->filefd,
+			transfer->received, length, copied);
+	// the end of the source, it may have been truncated in the meantime
+	if (length <= 0 || (errorcode == URL_DOWNLOAD_ERROR_NONE && *copied == 0))
+		transfer->local_done = 1;
+	return errorcode;
+}
+
+// the input of a buffer, its output and the last quantum fit in the buffer
+#define BASE64_INPUT_SIZE (((URL_DOWNLOAD_HTTP_BUFFER_SIZE / 3) - 1) * 4)
+
+// the data is decoded to the buffers of the writer
+static int _decode_data(struct url_download_http_s *transfer, size_t *copied)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	const char *data = NULL;
+	size_t input = 0;
+	size_t output = 0;
+
+	*copied = 0;
+	while (*copied < URL_DOWNLOAD_LOCAL_SLICE_SIZE && !transfer->local_done) {
+		buffer = url_download_writer_get(0);
+		if (buffer == NULL)
+			break;
+		data = transfer->source_data + transfer->source_offset;
+		input = transfer->source_length - transfer->source_offset;
+		if (transfer->source_base64) {
+			if (input > BASE64_INPUT_SIZE)
+				input = BASE64_INPUT_SIZE;
+			output = url_download_base64_decode(&transfer->base64, data, input,
+				(unsigned char *)buffer->data);
+			if (transfer->source_offset + input >= transfer->source_length)
+				output += url_download_base64_finish(&transfer->base64,
+					(unsigned char *)buffer->data + output);
+		} else {
+			if (input > URL_DOWNLOAD_HTTP_BUFFER_SIZE)
+				input = URL_DOWNLOAD_HTTP_BUFFER_SIZE;
+			memcpy(buffer->data, data, input);
+			output = input;
+		}
+		transfer->source_offset += input;
+		if (transfer->source_offset >= transfer->source_length)
+			transfer->local_done = 1;
+		if (output == 0) {
+			url_download_writer_release(buffer);
+			continue;
+		}
+		_digest_data(transfer, transfer->received + *copied, buffer->data, output);
+		url_download_writer_submit(buffer, &transfer->stream, transfer->filefd,
+			transfer->received + *copied, output);
+		*copied += output;
+	}
+	return transfer->stream.error;
+}
+
+// one slice of a file:// or data: url at each turn of the engine
+static void _copy_local(struct url_download_http_s *transfer)
+{
+	size_t copied = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (transfer->source_fd > 0)
+		errorcode = _copy_file(transfer, &copied);
+	else
+		errorcode = _decode_data(transfer, &copied);
+	if (copied > 0) {
+		transfer->received += copied;
+		_account(transfer, copied);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		_fail(transfer, errorcode);
+	else if (transfer->local_done)
+		_complete(transfer);
+}
+
+// the old file is scanned for the blocks of the manifest then they are copied,
+// a slice at each turn, the segments fetch the other ranges.
+static void _copy_delta(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	size_t copied = 0;
+	int done = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (transfer->delta_state == DELTA_SCAN) {
+		errorcode = url_download_delta_scan(transfer->delta, transfer->source_fd, &done);
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE && done) {
+			LOGI("[%s] slot[%d] [%lld] of [%lld] bytes in [%s]",__FUNCTION__, download->slot_index,
+				url_download_delta_matched(transfer->delta), transfer->total_size, download->delta_source);
+			transfer->delta_state = DELTA_COPY;
+		}
+	} else {
+		errorcode = url_download_delta_copy(transfer->delta, transfer->source_fd, transfer->filefd,
+			&copied, &done);
+		// the blocks are not received from the network
+		if (copied > 0) {
+			transfer->received += copied;
+			url_download_update_received_size(download, transfer->received);
+			transfer->events |= HTTP_EVENT_PROGRESS;
+		}
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE && done)
+			errorcode = _fetch_ranges(transfer);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		_fail(transfer, errorcode);
+}
+
+// the write errors fail the transfer, the completion waits for the writes
+static void _check_writes(struct url_download_http_s *transfer)
+{
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	if (transfer == NULL || transfer->finished)
+		return;
+	// the files of the archive whose writes are done
+	if (transfer->archive != NULL) {
+		errorcode = url_download_archive_retire(transfer->archive);
+		if (url_download_archive_extracted(transfer->archive))
+			transfer->events |= HTTP_EVENT_EXTRACTED;
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		_fail(transfer, errorcode);
+	else if (transfer->stream.error != URL_DOWNLOAD_ERROR_NONE)
+		_fail(transfer, transfer->stream.error);
+	else if (transfer->commit != NULL)
+		_check_commit(transfer);
+	else if (transfer->completing && transfer->stream.pending == 0)
+		_complete(transfer);
+}
+
+// the slots after the ones of the downloads are the ones of the probes
+static struct url_download_http_s *_slot_transfer(int slot)
+{
+	if (slot >= MAX_DOWNLOAD_HANDLE_COUNT)
+		return g_http_probes[slot - MAX_DOWNLOAD_HANDLE_COUNT];
+	return g_http_transfers[slot];
+}
+
+static int _is_alive(int slot, unsigned long serial)
+{
+	return (_slot_transfer(slot) != NULL && _slot_transfer(slot)->serial == serial);
+}
+
+// invoke the callbacks of the events of the transfer.
+// a callback may stop or destroy the download, the transfer is checked after each one.
+static void _deliver_events(int slot)
+{
+	struct url_download_http_s *transfer = g_http_transfers[slot];
+	url_download_h download = NULL;
+	unsigned long serial = 0;
+	char *path = NULL;
+	unsigned long long size = 0;
+	int events = 0;
+	int error = URL_DOWNLOAD_ERROR_NONE;
+
+	if (transfer == NULL || transfer->events == 0)
+		return;
+
+	download = transfer->download;
+	serial = transfer->serial;
+	events = transfer->events;
+	transfer->events = 0;
+
+	if (events & HTTP_EVENT_STARTED) {
+		url_download_notify_started(download);
+		if (!_is_alive(slot, serial))
+			return;
+	}
+	if (events & HTTP_EVENT_PROGRESS) {
+		url_download_notify_progress(download, transfer->received, download->file_size);
+		if (!_is_alive(slot, serial))
+			return;
+	}
+	if (events & HTTP_EVENT_PAUSED) {
+		url_download_notify_paused(download);
+		if (!_is_alive(slot, serial))
+			return;
+	}
+	// the files extracted before a failure are reported too
+	if (events & HTTP_EVENT_EXTRACTED) {
+		while (url_download_archive_next(transfer->archive, &path, &size) == URL_DOWNLOAD_ERROR_NONE) {
+			url_download_notify_extracted(download, path, size);
+			free(path);
+			if (!_is_alive(slot, serial))
+				return;
+		}
+	}
+	if (events & HTTP_EVENT_COMPLETED) {
+		_detach(transfer);
+		download->state = URL_DOWNLOAD_STATE_COMPLETED;
+		url_download_notify_completed(download);
+	} else if (events & HTTP_EVENT_FAILED) {
+		error = transfer->error;
+		_remove_partial(transfer, error);
+		_detach(transfer);
+		download->state = URL_DOWNLOAD_STATE_FAILED;
+		url_download_notify_stopped(download, error);
+	}
+}
+
+// the metadata of a finished probe are passed to its callback
+static void _deliver_probe(int index)
+{
+	struct url_download_http_s *transfer = g_http_probes[index];
+	struct url_download_http_probe_s *probe = NULL;
+
+	if (transfer == NULL || !transfer->finished)
+		return;
+
+	probe = transfer->probe;
+	g_http_probes[index] = NULL;
+	if (transfer->error == URL_DOWNLOAD_ERROR_NONE && probe->content_length > 0)
+		url_download_scheduler_record_size(probe->url, probe->content_length);
+	probe->callback(transfer->download, probe->url, transfer->error, probe->content_length,
+		probe->mime_type, probe->etag, probe->last_modified, probe->accept_ranges ? true : false,
+		probe->user_data);
+	_free_transfer(transfer);
+}
+
+#define MAX_POLL_COUNT ((MAX_DOWNLOAD_HANDLE_COUNT + URL_DOWNLOAD_HTTP_MAX_PROBES) \
+	* URL_DOWNLOAD_HTTP_MAX_SEGMENTS + 3)
+
+// the socket events the segment waits for
+static short _poll_events(struct url_download_http_segment_s *segment)
+{
+	short events = POLLIN;
+
+	if (segment->state == HTTP_STATE_CONNECTING || segment->state == HTTP_STATE_SENDING)
+		events = POLLOUT;
+	if (segment->tls == NULL || segment->state == HTTP_STATE_CONNECTING)
+		return events;
+	if (segment->state == HTTP_STATE_HANDSHAKE)
+		return url_download_tls_events(segment->tls);
+	return events | url_download_tls_events(segment->tls);
+}
+
+// the data already decrypted is processed without waiting for the socket
+static int _has_pending(struct url_download_http_segment_s *segment)
+{
+	return (segment->tls != NULL && (segment->state == HTTP_STATE_HEADERS
+		|| segment->state == HTTP_STATE_BODY) && url_download_tls_pending(segment->tls) > 0);
+}
+
+static void *_run_engine(void *args)
+{
+	// one engine thread runs at a time, the arrays do not fit on its stack
+	static struct pollfd fds[MAX_POLL_COUNT];
+	static int slots[MAX_POLL_COUNT];
+	static int indexes[MAX_POLL_COUNT];
+	static unsigned long serials[MAX_POLL_COUNT];
+	struct timespec now;
+	long long timeout = 0;
+	long long remaining = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int nfds = 0;
+	int first = 0;
+	int active = 0;
+	int i = 0;
+	int j = 0;
+	char drain[64];
+
+	LOGI("[%s] start engine thread",__FUNCTION__);
+	while (1) {
+		_lock();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		fds[0].fd = g_http_wakeup[0];
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		nfds = 1;
+		fds[nfds].fd = url_download_writer_fd();
+		if (fds[nfds].fd >= 0) {
+			fds[nfds].events = POLLIN;
+			fds[nfds].revents = 0;
+			nfds++;
+		}
+		fds[nfds].fd = url_download_commit_fd();
+		if (fds[nfds].fd >= 0) {
+			fds[nfds].events = POLLIN;
+			fds[nfds].revents = 0;
+			nfds++;
+		}
+		first = nfds;
+		active = 0;
+		timeout = URL_DOWNLOAD_HTTP_TIMEOUT_MS;
+		_idle_expire(&now);
+
+		for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+			struct url_download_http_s *transfer = g_http_transfers[i];
+			if (transfer == NULL)
+				continue;
+			active++;
+			if (transfer->events)
+				timeout = 0;
+			if (transfer->paused || transfer->finished)
+				continue;
+			if (transfer->download->throttled) {
+				remaining = _ms_until(&transfer->download->resume_time, &now);
+				if (remaining > 0) {
+					if (remaining < timeout)
+						timeout = remaining;
+					continue;
+				}
+				transfer->download->throttled = 0;
+				for (j = 0; j < transfer->segment_count; j++)
+					_set_deadline(&transfer->segments[j]);
+			}
+			// the file is read back for the digest, the files of an archive are waited on the writer
+			if (transfer->completing && transfer->commit == NULL && transfer->stream.pending == 0
+				&& (transfer->archive == NULL || !url_download_archive_pending(transfer->archive)))
+				timeout = 0;
+			// the writes of a data: url are waited on the writer
+			if (transfer->local && !transfer->completing
+				&& (transfer->source_fd > 0 || url_download_writer_available() > 0))
+				timeout = 0;
+			if (transfer->delta_state == DELTA_SCAN || transfer->delta_state == DELTA_COPY)
+				timeout = 0;
+			if (transfer->lookup != NULL && transfer->lookup->done) {
+				errorcode = _resolved(transfer);
+				if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+					_fail(transfer, errorcode);
+					timeout = 0;
+					continue;
+				}
+			}
+			for (j = 0; j < transfer->segment_count; j++) {
+				struct url_download_http_segment_s *segment = &transfer->segments[j];
+				if (segment->sockfd <= 0 && segment->state != HTTP_STATE_RESOLVING)
+					continue;
+				// a slow storage is not a network timeout
+				if (segment->state == HTTP_STATE_BODY && url_download_writer_available() == 0) {
+					_set_deadline(segment);
+					continue;
+				}
+				remaining = _ms_until(&segment->deadline, &now);
+				if (remaining <= 0) {
+					_fail(transfer, URL_DOWNLOAD_ERROR_CONNECTION_TIMED_OUT);
+					timeout = 0;
+					break;
+				}
+				if (remaining < timeout)
+					timeout = remaining;
+				if (segment->state == HTTP_STATE_RESOLVING)
+					continue;
+				if (_has_pending(segment))
+					timeout = 0;
+				fds[nfds].fd = segment->sockfd;
+				fds[nfds].events = _poll_events(segment);
+				fds[nfds].revents = 0;
+				slots[nfds] = i;
+				indexes[nfds] = j;
+				serials[nfds] = transfer->serial;
+				nfds++;
+			}
+		}
+		for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_PROBES; i++) {
+			struct url_download_http_s *transfer = g_http_probes[i];
+			struct url_download_http_segment_s *segment = NULL;
+			if (transfer == NULL)
+				continue;
+			active++;
+			segment = &transfer->segments[0];
+			if (!transfer->finished && transfer->lookup != NULL && transfer->lookup->done) {
+				errorcode = _resolved(transfer);
+				if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+					_fail(transfer, errorcode);
+			}
+			if (transfer->finished
+				|| (segment->sockfd <= 0 && segment->state != HTTP_STATE_RESOLVING)) {
+				timeout = 0;
+				continue;
+			}
+			remaining = _ms_until(&segment->deadline, &now);
+			if (remaining <= 0) {
+				_fail(transfer, URL_DOWNLOAD_ERROR_CONNECTION_TIMED_OUT);
+				timeout = 0;
+				continue;
+			}
+			if (remaining < timeout)
+				timeout = remaining;
+			if (segment->state == HTTP_STATE_RESOLVING)
+				continue;
+			if (_has_pending(segment))
+				timeout = 0;
+			fds[nfds].fd = segment->sockfd;
+			fds[nfds].events = _poll_events(segment);
+			fds[nfds].revents = 0;
+			slots[nfds] = MAX_DOWNLOAD_HANDLE_COUNT + i;
+			indexes[nfds] = 0;
+			serials[nfds] = transfer->serial;
+			nfds++;
+		}
+		if (active == 0) {
+			g_http_running = 0;
+			_unlock();
+			break;
+		}
+		url_download_writer_flush();
+		_unlock();
+
+		if (poll(fds, nfds, (int)timeout) < 0 && errno != EINTR)
+			LOGE("[%s]poll system error : %s",__FUNCTION__,strerror(errno));
+
+		_lock();
+		if (fds[0].revents & POLLIN) {
+			while (read(g_http_wakeup[0], drain, sizeof(drain)) > 0)
+				;
+		}
+		url_download_writer_reap();
+		url_download_commit_reap();
+		for (i = first; i < nfds; i++) {
+			struct url_download_http_s *transfer = _slot_transfer(slots[i]);
+			if (!_is_alive(slots[i], serials[i]) || transfer->paused || transfer->finished
+				|| transfer->segments[indexes[i]].sockfd != fds[i].fd)
+				continue;
+			if (_has_pending(&transfer->segments[indexes[i]]))
+				fds[i].revents |= POLLIN;
+			if (fds[i].revents != 0)
+				_process(transfer, &transfer->segments[indexes[i]], fds[i].revents);
+		}
+		for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+			struct url_download_http_s *transfer = g_http_transfers[i];
+			if (transfer != NULL && transfer->local && !transfer->paused && !transfer->finished
+				&& !transfer->completing && !transfer->download->throttled)
+				_copy_local(transfer);
+			else if (transfer != NULL && !transfer->paused && !transfer->finished
+				&& (transfer->delta_state == DELTA_SCAN || transfer->delta_state == DELTA_COPY))
+				_copy_delta(transfer);
+		}
+		for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+			struct url_download_http_s *transfer = g_http_transfers[i];
+			if (transfer != NULL && !transfer->paused && !transfer->finished && !transfer->completing
+				&& _can_checkpoint(transfer)
+				&& _ms_until(&now, &transfer->last_checkpoint) >= URL_DOWNLOAD_CHECKPOINT_INTERVAL_MS)
+				_write_checkpoint(transfer);
+		}
+		url_download_writer_reap();
+		for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+			_check_writes(g_http_transfers[i]);
+			_deliver_events(i);
+		}
+		for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_PROBES; i++)
+			_deliver_probe(i);
+		_unlock();
+
+		// start the queued downloads if some finished
+		url_download_scheduler_dispatch();
+	}
+	LOGI("[%s] shutdown engine thread",__FUNCTION__);
+	return 0;
+}
+
+static int _start_engine()
+{
+	pthread_attr_t thread_attr;
+	pthread_t thread_pid;
+
+	if (g_http_running)
+		return URL_DOWNLOAD_ERROR_NONE;
+	if (g_http_wakeup[0] < 0)
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+
+	if (pthread_attr_init(&thread_attr) != 0) {
+		LOGE("[%s]pthread_attr_init : %s",__FUNCTION__,strerror(errno));
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	if (pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED) != 0) {
+		LOGE("[%s]pthread_attr_setdetachstate : %s",__FUNCTION__,strerror(errno));
+		pthread_attr_destroy(&thread_attr);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	if (pthread_create(&thread_pid, &thread_attr, _run_engine, NULL) != 0) {
+		LOGE("[%s][%d] pthread_create : %s",__FUNCTION__, __LINE__,strerror(errno));
+		pthread_attr_destroy(&thread_attr);
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	pthread_attr_destroy(&thread_attr);
+	g_http_running = 1;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the validators of the file downloaded before from the url to the destination
+static void _find_validators(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	const char *name = NULL;
+
+	if (url_download_revalidation_find(download->url, url_download_destination_directory(download),
+		&transfer->cached_path, &transfer->cached_etag, &transfer->cached_last_modified)
+		!= URL_DOWNLOAD_ERROR_NONE)
+		return;
+	// another name is another file
+	name = strrchr(transfer->cached_path, '/');
+	name = (name ? name + 1 : transfer->cached_path);
+	if (download->content_name != NULL && strcmp(download->content_name, name) != 0) {
+		free(transfer->cached_path);
+		transfer->cached_path = NULL;
+		return;
+	}
+	LOGI("[%s] slot[%d] revalidate [%s]",__FUNCTION__, download->slot_index, transfer->cached_path);
+}
+
+// the partial file of a previous download of the url is resumed at the ranges of its checkpoint
+static int _resume_checkpoint(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	const char *directory = url_download_destination_directory(download);
+	struct url_download_checkpoint_s checkpoint;
+	char *name = NULL;
+	char *path = NULL;
+	char *final_path = NULL;
+	size_t size = 0;
+	int flags = (transfer->digest != NULL ? O_RDWR : O_WRONLY);
+	int fd = -1;
+	int i = 0;
+
+	if (download->content_name != NULL)
+		name = strdup(download->content_name);
+	else
+		name = _file_name_from_url(transfer->target.path);
+	if (name == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	size = strlen(directory) + strlen(name) + sizeof(URL_DOWNLOAD_ATOMIC_SUFFIX) + 16;
+	path = calloc(size, sizeof(char));
+	final_path = calloc(size, sizeof(char));
+	if (path == NULL || final_path == NULL) {
+		free(name);
+		if (path)
+			free(path);
+		if (final_path)
+			free(final_path);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	// the files numbered by _open_file(), with their temporary names for an atomic completion
+	memset(&checkpoint, 0x00, sizeof(struct url_download_checkpoint_s));
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_FILE_NUMBER && fd < 0; i++) {
+		_numbered_path(final_path, size, directory, name, i);
+		snprintf(path, size, "%s%s", final_path,
+			download->atomic_completion ? URL_DOWNLOAD_ATOMIC_SUFFIX : "");
+		if (access(path, F_OK) != 0 && access(final_path, F_OK) != 0)
+			break;
+		if (url_download_checkpoint_read(path, &checkpoint) != URL_DOWNLOAD_ERROR_NONE)
+			continue;
+		if (strcmp(checkpoint.url, download->url) == 0)
+			fd = open(path, flags | O_CLOEXEC);
+		if (fd < 0)
+			url_download_checkpoint_clear(&checkpoint);
+	}
+	if (fd < 0) {
+		free(name);
+		free(path);
+		free(final_path);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	if (download->content_name == NULL)
+		download->content_name = name;
+	else
+		free(name);
+	transfer->filefd = fd;
+	transfer->path = path;
+	if (download->atomic_completion)
+		transfer->final_path = final_path;
+	else
+		free(final_path);
+	transfer->etag = checkpoint.etag;
+	transfer->last_modified = checkpoint.last_modified;
+	checkpoint.etag = NULL;
+	checkpoint.last_modified = NULL;
+	if (checkpoint.mime_type != NULL) {
+		if (download->mime_type)
+			free(download->mime_type);
+		download->mime_type = checkpoint.mime_type;
+		checkpoint.mime_type = NULL;
+	}
+	transfer->total_size = checkpoint.length;
+	transfer->received = checkpoint.length;
+	transfer->segment_count = checkpoint.range_count;
+	for (i = 0; i < checkpoint.range_count; i++) {
+		transfer->segments[i].offset = checkpoint.ranges[i][0];
+		transfer->segments[i].end = checkpoint.ranges[i][1];
+		transfer->received -= checkpoint.ranges[i][1] - checkpoint.ranges[i][0];
+	}
+	url_download_checkpoint_clear(&checkpoint);
+	download->file_size = transfer->total_size;
+	transfer->started = 1;
+	transfer->accept_ranges = 1;
+	transfer->resumed = 1;
+	transfer->checkpointed = 1;
+	transfer->events |= HTTP_EVENT_STARTED;
+	LOGI("[%s] slot[%d] resume [%s] at [%lld] of [%lld] bytes",__FUNCTION__, download->slot_index,
+		transfer->path, transfer->received, transfer->total_size);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the manifest is requested first, from its own url or next to the url
+static int _open_manifest(struct url_download_http_s *transfer)
+{
+	url_download_h download = transfer->download;
+	size_t size = strlen(download->url) + sizeof(URL_DOWNLOAD_DELTA_MANIFEST_SUFFIX);
+
+	free(transfer->url);
+	if (download->delta_manifest != NULL) {
+		transfer->url = strdup(download->delta_manifest);
+	} else {
+		transfer->url = calloc(size, sizeof(char));
+		if (transfer->url != NULL)
+			snprintf(transfer->url, size, "%s%s", download->url, URL_DOWNLOAD_DELTA_MANIFEST_SUFFIX);
+	}
+	if (transfer->url == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	LOGI("[%s] slot[%d] manifest [%s]",__FUNCTION__, download->slot_index, transfer->url);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _http_start(url_download_h download, int *id)
+{
+	struct url_download_http_s *transfer = NULL;
+	char *object = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	transfer = calloc(1, sizeof(struct url_download_http_s));
+	if (transfer == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	transfer->download = download;
+	transfer->total_size = -1;
+	transfer->segment_count = 1;
+	transfer->segments[0].end = -1;
+	transfer->url = strdup(download->url);
+	if (transfer->url == NULL) {
+		free(transfer);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	}
+	// an archive is extracted from its first byte, from the network
+	if (download->archive_extraction && (download->range_offset != 0 || download->range_length != 0
+		|| url_download_url_is_local(transfer->url))) {
+		free(transfer->url);
+		free(transfer);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "archive extraction");
+	}
+	// the content in memory comes from the network, in a new buffer or memfd
+	if (download->destination_type != URL_DOWNLOAD_DESTINATION_FILE && (download->archive_extraction
+		|| (download->range_at_offset && (download->range_offset != 0 || download->range_length != 0))
+		|| url_download_url_is_local(transfer->url))) {
+		free(transfer->url);
+		free(transfer);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "memory destination");
+	}
+	transfer->in_memory = (download->destination_type == URL_DOWNLOAD_DESTINATION_MEMORY);
+	if (download->range_offset != 0 || download->range_length != 0) {
+		// the local urls are copied as a whole
+		if (url_download_url_is_local(transfer->url)) {
+			free(transfer->url);
+			free(transfer);
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "range of a local url");
+		}
+		transfer->ranged = 1;
+		transfer->in_place = download->range_at_offset;
+		if (download->range_offset < 0) {
+			transfer->range_suffix = -download->range_offset;
+		} else {
+			transfer->segments[0].offset = download->range_offset;
+			if (download->range_length > 0)
+				transfer->segments[0].end = download->range_offset + download->range_length;
+		}
+		if (!transfer->in_place)
+			transfer->file_base = transfer->segments[0].offset;
+	}
+	transfer->digest_type = download->digest_type;
+	if (download->delta_source != NULL && !transfer->ranged && _to_file(download)
+		&& !url_download_url_is_local(transfer->url))
+		transfer->delta_state = DELTA_MANIFEST;
+	// the files of the content store are named by their digest, the file of a
+	// delta download is checked against its manifest
+	if (transfer->digest_type == URL_DOWNLOAD_DIGEST_NONE && !transfer->ranged
+		&& _to_file(download) && !url_download_url_is_local(transfer->url)
+		&& (url_download_store_enabled() || transfer->delta_state == DELTA_MANIFEST))
+		transfer->digest_type = URL_DOWNLOAD_DIGEST_SHA256;
+	if (transfer->digest_type != URL_DOWNLOAD_DIGEST_NONE) {
+		transfer->digest = url_download_digest_new(transfer->digest_type);
+		if (transfer->digest == NULL) {
+			_free_transfer(transfer);
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+		}
+		transfer->digest_start = (transfer->in_place ? transfer->segments[0].offset : 0);
+		transfer->digest_offset = transfer->digest_start;
+	}
+	if (!transfer->ranged && download->digest_type == URL_DOWNLOAD_DIGEST_NONE
+		&& transfer->delta_state == DELTA_NONE && _to_file(download)
+		&& !url_download_url_is_local(transfer->url) && url_download_revalidation_enabled())
+		_find_validators(transfer);
+
+	_lock();
+	if (download->http != NULL)
+		_detach(download->http);
+	url_download_rate_limit_reset(download);
+	download->wire_received = 0;
+	download->wire_size = 0;
+	if (download->digest)
+		free(download->digest);
+	download->digest = NULL;
+	download->not_modified = 0;
+	if (download->memory)
+		free(download->memory);
+	download->memory = NULL;
+	download->memory_length = 0;
+	if (download->memory_fd > 0)
+		close(download->memory_fd);
+	download->memory_fd = 0;
+
+	if (!transfer->ranged && _to_file(download))
+		object = url_download_store_find(download->digest_type, download->expected_digest);
+	if (url_download_url_is_local(transfer->url)) {
+		errorcode = _open_local(transfer);
+	} else if (object != NULL) {
+		LOGI("[%s] slot[%d] digest [%s] in the content store",__FUNCTION__,
+			download->slot_index, download->expected_digest);
+		transfer->delta_state = DELTA_NONE;
+		errorcode = _open_stored(transfer, object, download->expected_digest);
+		free(object);
+	} else {
+		if (transfer->delta_state == DELTA_MANIFEST)
+			errorcode = _open_manifest(transfer);
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+			errorcode = _open_target(transfer);
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE && download->checkpoint && !transfer->ranged
+			&& transfer->delta_state == DELTA_NONE && _to_file(download))
+			errorcode = _resume_checkpoint(transfer);
+		for (i = 0; i < transfer->segment_count && errorcode == URL_DOWNLOAD_ERROR_NONE; i++)
+			errorcode = _open_segment(transfer, &transfer->segments[i], 1);
+	}
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _start_engine();
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+		_free_transfer(transfer);
+		_unlock();
+		return url_download_error(__FUNCTION__, errorcode, NULL);
+	}
+
+	transfer->serial = ++g_http_serial;
+	clock_gettime(CLOCK_MONOTONIC, &transfer->last_progress);
+	transfer->last_checkpoint = transfer->last_progress;
+	download->http = transfer;
+	download->requestid = ++g_http_requestid;
+	download->state = URL_DOWNLOAD_STATE_DOWNLOADING;
+	g_http_transfers[download->slot_index] = transfer;
+	if (id)
+		*id = download->requestid;
+	// a data: url may be large
+	LOGI("[%s] slot[%d] id[%d] url[%.256s]",__FUNCTION__, download->slot_index, download->requestid, download->url);
+	_wakeup();
+	_unlock();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _http_pause(url_download_h download)
+{
+	struct url_download_http_s *transfer = NULL;
+	int i = 0;
+
+	if (download == NULL || download->requestid <= 0)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	_lock();
+	transfer = download->http;
+	if (transfer == NULL || download->state != URL_DOWNLOAD_STATE_DOWNLOADING
+		|| transfer->finished || transfer->commit != NULL) {
+		_unlock();
+		return url_download_error_invalid_state(__FUNCTION__, download);
+	}
+	// the connections are closed, the segments resume with range requests
+	for (i = 0; i < transfer->segment_count; i++)
+		_close_segment(&transfer->segments[i]);
+	if (_can_checkpoint(transfer))
+		_write_checkpoint(transfer);
+	transfer->paused = 1;
+	transfer->events |= HTTP_EVENT_PAUSED;
+	download->throttled = 0;
+	download->state = URL_DOWNLOAD_STATE_PAUSED;
+	_wakeup();
+	_unlock();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _http_resume(url_download_h download)
+{
+	struct url_download_http_s *transfer = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int i = 0;
+
+	if (download == NULL || download->requestid <= 0)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	_lock();
+	transfer = download->http;
+	if (transfer == NULL || download->state != URL_DOWNLOAD_STATE_PAUSED) {
+		_unlock();
+		return url_download_error_invalid_state(__FUNCTION__, download);
+	}
+	// the offset in the coded body is not known, the decoded file starts again
+	if (transfer->decoder != NULL) {
+		url_download_decoder_free(transfer->decoder);
+		transfer->decoder = NULL;
+		transfer->decoded = 0;
+		url_download_writer_wait(&transfer->stream);
+		transfer->memory_length = 0;
+		if (transfer->archive != NULL)
+			errorcode = _open_archive(transfer);
+		else if (!transfer->in_memory && ftruncate(transfer->filefd, 0) < 0)
+			errorcode = URL_DOWNLOAD_ERROR_IO_ERROR;
+		transfer->segments[0].offset = 0;
+		transfer->received = 0;
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+			errorcode = _digest_reset(transfer);
+	}
+	for (i = 0; i < transfer->segment_count && errorcode == URL_DOWNLOAD_ERROR_NONE; i++) {
+		if (transfer->segments[i].state != HTTP_STATE_DONE)
+			errorcode = _open_segment(transfer, &transfer->segments[i], 1);
+	}
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+		for (i = 0; i < transfer->segment_count; i++)
+			_close_segment(&transfer->segments[i]);
+		_unlock();
+		return url_download_error(__FUNCTION__, errorcode, NULL);
+	}
+	transfer->paused = 0;
+	download->state = URL_DOWNLOAD_STATE_DOWNLOADING;
+	_wakeup();
+	_unlock();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static int _http_stop(url_download_h download)
+{
+	struct url_download_http_s *transfer = NULL;
+
+	if (download == NULL || download->requestid <= 0)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->state != URL_DOWNLOAD_STATE_DOWNLOADING
+		&& download->state != URL_DOWNLOAD_STATE_PAUSED)
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	_lock();
+	transfer = download->http;
+	if (transfer != NULL) {
+		_remove_partial(transfer, URL_DOWNLOAD_ERROR_NONE);
+		_detach(transfer);
+	}
+	download->state = URL_DOWNLOAD_STATE_READY;
+	_wakeup();
+	_unlock();
+
+	url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_NONE);
+	url_download_scheduler_dispatch();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// the state is kept up to date by the engine
+static int _http_get_state(url_download_h download)
+{
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+static void _http_destroy(url_download_h download)
+{
+	_lock();
+	if (download->http != NULL)
+		_detach(download->http);
+	_unlock();
+}
+
+// the download took over the transfer of another handle
+void url_download_http_rebind(url_download_h download)
+{
+	int i = 0;
+
+	_lock();
+	for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+		if (g_http_transfers[i] != NULL && g_http_transfers[i] == download->http)
+			g_http_transfers[i] = NULL;
+	}
+	if (download->http != NULL) {
+		download->http->download = download;
+		g_http_transfers[download->slot_index] = download->http;
+	}
+	_unlock();
+}
+
+// the probes of a destroyed handle are freed without callback
+void url_download_http_cancel_probes(url_download_h download)
+{
+	int i = 0;
+
+	_lock();
+	for (i = 0; i < URL_DOWNLOAD_HTTP_MAX_PROBES; i++) {
+		if (g_http_probes[i] != NULL && g_http_probes[i]->download == download) {
+			_free_transfer(g_http_probes[i]);
+			g_http_probes[i] = NULL;
+		}
+	}
+	_unlock();
+}
+
+int url_download_probe(url_download_h download, url_download_probed_cb callback, void *user_data)
+{
+	struct url_download_http_s *transfer = NULL;
+	struct url_download_http_probe_s *probe = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int index = 0;
+
+	if (download == NULL || download->url == NULL || callback == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+	if (url_download_url_is_local(download->url))
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "probe of a local url");
+
+	transfer = calloc(1, sizeof(struct url_download_http_s));
+	probe = calloc(1, sizeof(struct url_download_http_probe_s));
+	if (transfer == NULL || probe == NULL) {
+		if (transfer)
+			free(transfer);
+		if (probe)
+			free(probe);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	}
+	transfer->probe = probe;
+	transfer->download = download;
+	transfer->total_size = -1;
+	transfer->segment_count = 1;
+	transfer->segments[0].end = -1;
+	probe->head = 1;
+	probe->callback = callback;
+	probe->user_data = user_data;
+	probe->content_length = -1;
+	transfer->url = strdup(download->url);
+	probe->url = strdup(download->url);
+	if (transfer->url == NULL || probe->url == NULL) {
+		_free_transfer(transfer);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	}
+
+	_lock();
+	for (index = 0; index < URL_DOWNLOAD_HTTP_MAX_PROBES && g_http_probes[index] != NULL; index++)
+		;
+	if (index >= URL_DOWNLOAD_HTTP_MAX_PROBES)
+		errorcode = URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS;
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _open_target(transfer);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _open_segment(transfer, &transfer->segments[0], 1);
+	if (errorcode == URL_DOWNLOAD_ERROR_NONE)
+		errorcode = _start_engine();
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+		_free_transfer(transfer);
+		_unlock();
+		return url_download_error(__FUNCTION__, errorcode, NULL);
+	}
+
+	transfer->serial = ++g_http_serial;
+	g_http_probes[index] = transfer;
+	LOGI("[%s] slot[%d] probe[%d] url[%s]",__FUNCTION__, download->slot_index, index, download->url);
+	_wakeup();
+	_unlock();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_segment_count(url_download_h download, int count)
+{
+	if (download == NULL || count < 0 || count > URL_DOWNLOAD_HTTP_MAX_SEGMENTS)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->segment_count = count;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_segment_count(url_download_h download, int *count)
+{
+	if (download == NULL || count == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*count = download->segment_count;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_content_decoding(url_download_h download, bool enable)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->content_decoding = (enable ? 1 : 0);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_content_decoding(url_download_h download, bool *enable)
+{
+	if (download == NULL || enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*enable = (download->content_decoding ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_wire_size(url_download_h download, unsigned long long *received, unsigned long long *total)
+{
+	if (download == NULL || received == NULL || total == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	_lock();
+	if (download->backend == &url_download_http_backend) {
+		*received = download->wire_received;
+		*total = download->wire_size;
+	} else {
+		// download-provider stores the body as it is received
+		*received = download->received_size;
+		*total = download->file_size;
+	}
+	_unlock();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+const struct url_download_backend_s url_download_http_backend = {
+	_http_start,
+	_http_pause,
+	_http_resume,
+	_http_stop,
+	_http_get_state,
+	_http_destroy,
+};
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// loff_t
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The sources of the file:// and data: urls, copied by the in-process
+// backend without download-provider.
+
+#define BASE64_SKIP 0xfe /* white space and padding */
+#define BASE64_INVALID 0xff
+
+static unsigned char g_base64_table[256];
+static pthread_once_t g_base64_once = PTHREAD_ONCE_INIT;
+
+static void _base64_init()
+{
+	const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	int i = 0;
+
+	memset(g_base64_table, BASE64_INVALID, sizeof(g_base64_table));
+	for (i = 0; i < 64; i++)
+		g_base64_table[(unsigned char)alphabet[i]] = i;
+	// the url-safe alphabet
+	g_base64_table['-'] = 62;
+	g_base64_table['_'] = 63;
+	g_base64_table['='] = BASE64_SKIP;
+	g_base64_table[' '] = BASE64_SKIP;
+	g_base64_table['\t'] = BASE64_SKIP;
+	g_base64_table['\r'] = BASE64_SKIP;
+	g_base64_table['\n'] = BASE64_SKIP;
+}
+
+// returns the length of the decoded data, -1 if it is not base64
+long long url_download_base64_length(const char *data, size_t length)
+{
+	long long count = 0;
+	size_t i = 0;
+
+	pthread_once(&g_base64_once, _base64_init);
+	for (i = 0; i < length; i++) {
+		unsigned char value = g_base64_table[(unsigned char)data[i]];
+		if (value == BASE64_INVALID)
+			return -1;
+		if (value != BASE64_SKIP)
+			count++;
+	}
+	if (count % 4 == 1)
+		return -1;
+	return (count / 4) * 3 + (count % 4 == 0 ? 0 : count % 4 - 1);
+}
+
+// decodes a part of the data, the characters of an incomplete quantum are
+// kept in the state for the next part. returns the bytes written to out.
+size_t url_download_base64_decode(struct url_download_base64_s *state,
+		const char *data, size_t length, unsigned char *out)
+{
+	const unsigned char *src = (const unsigned char *)data;
+	const unsigned char *end = src + length;
+	unsigned char *dst = out;
+	unsigned char a = 0;
+	unsigned char b = 0;
+	unsigned char c = 0;
+	unsigned char d = 0;
+	unsigned char value = 0;
+
+	pthread_once(&g_base64_once, _base64_init);
+	while (src < end) {
+		// four characters at a time without branch while the input is clean
+		while (state->count == 0 && end - src >= 4) {
+			a = g_base64_table[src[0]];
+			b = g_base64_table[src[1]];
+			c = g_base64_table[src[2]];
+			d = g_base64_table[src[3]];
+			if ((a | b | c | d) & 0xc0)
+				break;
+			dst[0] = (a << 2) | (b >> 4);
+			dst[1] = (b << 4) | (c >> 2);
+			dst[2] = (c << 6) | d;
+			dst += 3;
+			src += 4;
+		}
+		if (src >= end)
+			break;
+
+		value = g_base64_table[*src++];
+		if (value & 0xc0)
+			continue;
+		state->bits = (state->bits << 6) | value;
+		if (++state->count == 4) {
+			dst[0] = state->bits >> 16;
+			dst[1] = state->bits >> 8;
+			dst[2] = state->bits;
+			dst += 3;
+			state->bits = 0;
+			state->count = 0;
+		}
+	}
+	return dst - out;
+}
+
+// the end of the data, returns the bytes of the last quantum written to out
+size_t url_download_base64_finish(struct url_download_base64_s *state, unsigned char *out)
+{
+	size_t length = 0;
+
+	if (state->count == 2) {
+		out[0] = state->bits >> 4;
+		length = 1;
+	} else if (state->count == 3) {
+		out[0] = state->bits >> 10;
+		out[1] = state->bits >> 2;
+		length = 2;
+	}
+	state->bits = 0;
+	state->count = 0;
+	return length;
+}
+
+// shares the blocks of the source file with the destination when the
+// file system supports it (btrfs, xfs).
+int url_download_local_clone(int in, int out)
+{
+#ifdef FICLONE
+	if (ioctl(out, FICLONE, in) == 0)
+		return URL_DOWNLOAD_ERROR_NONE;
+#endif
+	return URL_DOWNLOAD_ERROR_IO_ERROR;
+}
+
+// copies up to length bytes at in_offset of the source to out_offset of the
+// destination in the kernel. copied is 0 at the end of the source.
+int url_download_local_copy_range(int in, long long in_offset, int out, long long out_offset,
+		size_t length, size_t *copied)
+{
+	loff_t source_offset = in_offset;
+	ssize_t count = -1;
+	static char buffer[URL_DOWNLOAD_HTTP_BUFFER_SIZE];
+
+	*copied = 0;
+#ifdef __NR_copy_file_range
+	{
+		loff_t target_offset = out_offset;
+		do {
+			count = syscall(__NR_copy_file_range, in, &source_offset, out, &target_offset, length, 0);
+		} while (count < 0 && errno == EINTR);
+		if (count >= 0) {
+			*copied = count;
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+		// an old kernel or two file systems
+		if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP)
+			goto error;
+		source_offset = in_offset;
+	}
+#endif
+
+	// sendfile() writes at the position of the destination
+	if (lseek(out, out_offset, SEEK_SET) == out_offset) {
+		do {
+			count = sendfile(out, in, &source_offset, length);
+		} while (count < 0 && errno == EINTR);
+		if (count >= 0) {
+			*copied = count;
+			return URL_DOWNLOAD_ERROR_NONE;
+		}
+		if (errno != EINVAL && errno != ENOSYS)
+			goto error;
+	}
+
+	if (length > sizeof(buffer))
+		length = sizeof(buffer);
+	do {
+		count = pread(in, buffer, length, in_offset);
+	} while (count < 0 && errno == EINTR);
+	if (count < 0)
+		goto error;
+	length = count;
+	while (*copied < length) {
+		count = pwrite(out, buffer + *copied, length - *copied, out_offset + *copied);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			goto error;
+		*copied += count;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+
+error:
+	LOGE("[%s] copy : %s",__FUNCTION__, strerror(errno));
+	return (errno == ENOSPC ? URL_DOWNLOAD_ERROR_NO_SPACE : URL_DOWNLOAD_ERROR_IO_ERROR);
+}
+
+// copies up to length bytes at the offset of the source to the same offset of the destination
+int url_download_local_copy(int in, int out, long long offset, size_t length, size_t *copied)
+{
+	return url_download_local_copy_range(in, offset, out, offset, length, copied);
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
@@ -24,17 +25,26 @@
 
 #define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
 
-#define STATE_IS_RUNNING(_download_) \
-	 (_download_->state == URL_DOWNLOAD_STATE_DOWNLOADING \
-	 || _download_->state == URL_DOWNLOAD_STATE_PAUSED)
-
-
 #define STRING_IS_INVALID(_string_) \
 	(_string_ == NULL || _string_[0] == '\0')
 
+// progress is used by the rate limit and the adaptive concurrency
+#define NEEDS_PROGRESS_INFO(_download_) \
+	(url_download_rate_limit_enabled(_download_) \
+	 || url_download_scheduler_adaptive_enabled())
+
+// the event thread is needed for callbacks, for the progress info and to start
+// the queued downloads when one ends, the events are chosen at the start for
+// the handle and the ones attached to it
+#define HAS_EVENT_LISTENER(_download_) \
+	(_download_->provider_events & (URL_DOWNLOAD_EVENT_COMPLETED \
+		| URL_DOWNLOAD_EVENT_STOPPED | URL_DOWNLOAD_EVENT_PROGRESS | URL_DOWNLOAD_EVENT_PAUSED))
+
 static int url_download_resume(url_download_h download);
-static int url_download_get_all_http_header_fields(
-		url_download_h download, char ***fields, int *fields_length);
+
+// the handles created by id are managed by download-provider
+#define BACKEND_OF(_download_) \
+	(_download_->backend ? _download_->backend : &url_download_provider_backend)
 
 // one event thread model.
 int g_download_maxfd = 0;
@@ -161,6 +171,15 @@ const char* url_download_error_to_string(int error_code)
 		case URL_DOWNLOAD_ERROR_ALREADY_COMPLETED:
 			error_name = "ALREADY_COMPLETED";
 			break;
+		case URL_DOWNLOAD_ERROR_NO_DATA:
+			error_name = "NO_DATA";
+			break;
+		case URL_DOWNLOAD_ERROR_DIGEST_MISMATCH:
+			error_name = "DIGEST_MISMATCH";
+			break;
+		case URL_DOWNLOAD_ERROR_INVALID_ARCHIVE:
+			error_name = "INVALID_ARCHIVE";
+			break;
 		default:
 			error_name = "UNKNOWN";
 			break;
@@ -197,6 +216,9 @@ const char* url_download_state_to_string(url_download_state_e state)
 	case URL_DOWNLOAD_STATE_COMPLETED:
 		return "COMPLETED";
 
+	case URL_DOWNLOAD_STATE_QUEUED:
+		return "QUEUED";
+
 	default:
 		return "INVALID";
 	}
@@ -300,6 +322,88 @@ void _terminate_event_server_if_no_download()
 	}
 }
 
+// the download is finished from the point of view of this client
+static void _detach_download(url_download_h download)
+{
+	_clear_socket(download->sockfd);
+	download->sockfd = 0;
+	url_download_scheduler_release(download);
+}
+
+// pause the download at the provider until its rate budget is refilled
+static void _throttle_download(url_download_h download, long delay_ms)
+{
+	struct timespec now;
+
+	if (ipc_send_download_control(download->sockfd, DOWNLOAD_CONTROL_PAUSE)
+		!= DOWNLOAD_CONTROL_PAUSE)
+		return;
+
+	LOGI("[%s] slot[%d] throttled for %ld ms",__FUNCTION__, download->slot_index, delay_ms);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	download->resume_time.tv_sec = now.tv_sec + delay_ms / 1000;
+	download->resume_time.tv_nsec = now.tv_nsec + (delay_ms % 1000) * 1000000L;
+	if (download->resume_time.tv_nsec >= 1000000000L) {
+		download->resume_time.tv_sec++;
+		download->resume_time.tv_nsec -= 1000000000L;
+	}
+	download->throttled = 1;
+}
+
+// resume the throttled downloads which are due.
+// returns the time in ms until the next one should be resumed.
+static long _resume_throttled_downloads()
+{
+	struct timespec now;
+	long next_ms = 1000;
+	long remaining_ms;
+	int i = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (i = 0; i < MAX_DOWNLOAD_HANDLE_COUNT; i++) {
+		url_download_h download = g_download_handle_list[i];
+		if (!download || !download->throttled || download->sockfd <= 0)
+			continue;
+		remaining_ms = (download->resume_time.tv_sec - now.tv_sec) * 1000L
+			+ (download->resume_time.tv_nsec - now.tv_nsec) / 1000000L;
+		if (remaining_ms <= 0) {
+			LOGI("[%s] slot[%d] resume throttled download",__FUNCTION__, i);
+			download->throttled = 0;
+			ipc_send_download_control(download->sockfd, DOWNLOAD_CONTROL_RESUME);
+		} else if (remaining_ms < next_ms) {
+			next_ms = remaining_ms;
+		}
+	}
+	return next_ms;
+}
+
+// download-provider reports the sizes in an unsigned long, 32 bits on the
+// 32-bit targets. The size of a file over 4 GB is the expected size if it
+// gives the same low bits.
+static unsigned long long _provider_file_size(url_download_h download, unsigned long reported)
+{
+	if (sizeof(reported) < sizeof(unsigned long long)
+		&& (download->expected_size & 0xffffffffULL) == reported)
+		return download->expected_size;
+	return reported;
+}
+
+// the received bytes over 4 GB are counted from the previous report, the
+// counter went back by more than 2 GB if it wrapped around.
+static unsigned long long _provider_received_size(url_download_h download, unsigned long reported)
+{
+	unsigned long long previous = download->received_size;
+	unsigned long long received = reported;
+
+	if (sizeof(reported) >= sizeof(unsigned long long))
+		return received;
+	received |= (previous & ~0xffffffffULL);
+	if (received + 0x80000000ULL < previous
+		&& (download->file_size == 0 || received + 0x100000000ULL <= download->file_size))
+		received += 0x100000000ULL;
+	return received;
+}
+
 void *run_event_server(void *args)
 {
 	LOGE("[%s][%d]",__FUNCTION__, __LINE__);
@@ -311,14 +415,20 @@ void *run_event_server(void *args)
 	download_request_state_info requeststateinfo;
 	unsigned i;
 	unsigned is_timeout = 1;
+	long timeout_ms = 1000;
+	unsigned long long received_bytes = 0;
+	unsigned long long received_size = 0;
 
 	LOGI("[%s][%d] g_download_maxfd [%d]",__FUNCTION__, __LINE__, g_download_maxfd);
 	while(g_download_maxfd > 0) {
 
+		timeout_ms = _resume_throttled_downloads();
+
 		readset = g_download_socket_readset;
 		exceptset = g_download_socket_exceptset;
 		memset(&timeout, 0x00, sizeof(struct timeval));
-		timeout.tv_sec = 1;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_usec = (timeout_ms % 1000) * 1000;
 		is_timeout = 1;
 
 		if (select((g_download_maxfd+1), &readset, 0, &exceptset, &timeout) < 0) {
@@ -341,16 +451,11 @@ void *run_event_server(void *args)
 						|| read(download->sockfd, &requeststateinfo,
 							sizeof(download_request_state_info)) < 0) {
 						url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
-						url_download_stop(download);
-						if (download->callback.stopped) {
-							download->state = URL_DOWNLOAD_STATE_FAILED;
-							download->callback.stopped(download,
-							URL_DOWNLOAD_ERROR_IO_ERROR,
-							download->callback.stopped_user_data);
-						}
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 						if (download) {
-							_clear_socket(download->sockfd);
-							download->sockfd = 0;
+							_detach_download(download);
 						}
 					}
 					if (requeststateinfo.requestid > 0) {
@@ -358,31 +463,21 @@ void *run_event_server(void *args)
 							break;
 						download->requestid = requeststateinfo.requestid;
 						if (requeststateinfo.stateinfo.state == DOWNLOAD_STATE_FAILED) {
-							url_download_stop(download);
-							if (download->callback.stopped) {
-								download->state = URL_DOWNLOAD_STATE_FAILED;
-								download->callback.stopped(download,
-								URL_DOWNLOAD_ERROR_IO_ERROR,
-								download->callback.stopped_user_data);
-							}
+							url_download_provider_stop(download);
+							download->state = URL_DOWNLOAD_STATE_FAILED;
+							url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 							if (download) {
-								_clear_socket(download->sockfd);
-								download->sockfd = 0;
+								_detach_download(download);
 							}
 						} else
 							download->state = URL_DOWNLOAD_STATE_DOWNLOADING;
 					} else {
 						LOGE("[%s]Not Found request id (Wrong message)", __FUNCTION__);
-						url_download_stop(download);
-						if (download->callback.stopped) {
-							download->state = URL_DOWNLOAD_STATE_FAILED;
-							download->callback.stopped(download,
-							URL_DOWNLOAD_ERROR_IO_ERROR,
-							download->callback.stopped_user_data);
-						}
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 						if (download) {
-							_clear_socket(download->sockfd);
-							download->sockfd = 0;
+							_detach_download(download);
 						}
 					}
 					break;
@@ -391,80 +486,77 @@ void *run_event_server(void *args)
 					if (download->sockfd <= 0
 						|| read(download->sockfd, &downloadinfo, sizeof(download_content_info)) < 0) {
 						url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
-						url_download_stop(download);
-						if (download->callback.stopped) {
-							download->state = URL_DOWNLOAD_STATE_FAILED;
-							download->callback.stopped(download,
-							URL_DOWNLOAD_ERROR_IO_ERROR,
-							download->callback.stopped_user_data);
-						}
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 						if (download) {
-							_clear_socket(download->sockfd);
-							download->sockfd = 0;
+							_detach_download(download);
 						}
 						break;
 					}
-					LOGI("[%s] DOWNLOAD_CONTROL_GET_DOWNLOAD_INFO [%d]%",__FUNCTION__, downloadinfo.file_size);
 					download->state = URL_DOWNLOAD_STATE_DOWNLOADING;
-					download->file_size = downloadinfo.file_size;
+					download->file_size = _provider_file_size(download, downloadinfo.file_size);
+					LOGI("[%s] DOWNLOAD_CONTROL_GET_DOWNLOAD_INFO [%llu]",__FUNCTION__, download->file_size);
+					if (download->file_size > 0)
+						url_download_scheduler_record_size(download->url, download->file_size);
+					// download-provider writes the file, its size is reserved
+					if (url_download_scheduler_reserve(download, download->file_size) != URL_DOWNLOAD_ERROR_NONE) {
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_NO_SPACE);
+						if (download) {
+							_detach_download(download);
+						}
+						break;
+					}
 					if (strlen(downloadinfo.mime_type) > 0)
 						download->mime_type = strdup(downloadinfo.mime_type);
 					if (strlen(downloadinfo.content_name) > 0) {
 						download->content_name = strdup(downloadinfo.content_name);
 						LOGI("content_name[%s] %", downloadinfo.content_name);
 					}
-					if (download->callback.started) {
-						download->callback.started(
-						download, download->content_name, download->mime_type,
-						download->callback.started_user_data);
-					}
+					url_download_notify_started(download);
 					break;
 				case DOWNLOAD_CONTROL_GET_DOWNLOADING_INFO :
 					memset(&downloadinginfo, 0x00, sizeof(downloading_state_info));
 					if (download->sockfd <= 0
 						|| read(download->sockfd, &downloadinginfo, sizeof(downloading_state_info)) < 0) {
 						url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
-						url_download_stop(download);
-						if (download->callback.stopped) {
-							download->state = URL_DOWNLOAD_STATE_FAILED;
-							download->callback.stopped(download,
-							URL_DOWNLOAD_ERROR_IO_ERROR,
-							download->callback.stopped_user_data);
-						}
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 						if (download) {
-							_clear_socket(download->sockfd);
-							download->sockfd = 0;
+							_detach_download(download);
 						}
 						break;
 					}
 					// call the function by download-callbacks table.
-					LOGI("[%s] DOWNLOAD_CONTROL_GET_DOWNLOADING_INFO [%d]%",__FUNCTION__, downloadinginfo.received_size);
-					if (download->callback.progress) {
-						download->callback.progress(
-						download,
-						downloadinginfo.received_size, download->file_size,
-						download->callback.progress_user_data);
-					}
+					received_size = _provider_received_size(download, downloadinginfo.received_size);
+					LOGI("[%s] DOWNLOAD_CONTROL_GET_DOWNLOADING_INFO [%llu]",__FUNCTION__, received_size);
+					url_download_notify_progress(download, received_size, download->file_size);
 					if (strlen(downloadinginfo.saved_path) > 0) {
 						LOGI("[%s] saved path [%s]",__FUNCTION__, downloadinginfo.saved_path);
 						download->completed_path = strdup(downloadinginfo.saved_path);
 					}
+					received_bytes = url_download_update_received_size(download, received_size);
+					url_download_scheduler_report_progress(received_bytes);
+					if (url_download_rate_limit_enabled(download)) {
+						long delay_ms = url_download_rate_limit_consume(download,
+							received_bytes);
+						if (delay_ms >= URL_DOWNLOAD_THROTTLE_MIN_MS && !download->throttled)
+							_throttle_download(download, delay_ms);
+					}
 					break;
 				case DOWNLOAD_CONTROL_GET_STATE_INFO :
 					memset(&stateinfo, 0x00, sizeof(download_state_info));
 					if (download->sockfd <= 0
 						|| read(download->sockfd, &stateinfo, sizeof(download_state_info)) < 0) {
 						url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
-						url_download_stop(download);
-						if (download->callback.stopped) {
-							download->state = URL_DOWNLOAD_STATE_FAILED;
-							download->callback.stopped(download,
-							URL_DOWNLOAD_ERROR_IO_ERROR,
-							download->callback.stopped_user_data);
-						}
+						url_download_provider_stop(download);
+						download->state = URL_DOWNLOAD_STATE_FAILED;
+						url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 						if (download) {
-							_clear_socket(download->sockfd);
-							download->sockfd = 0;
+							_detach_download(download);
 						}
 					}
 					// call the function by download-callbacks table.
@@ -473,11 +565,7 @@ void *run_event_server(void *args)
 						case DOWNLOAD_STATE_STOPPED:
 							LOGI("DOWNLOAD_STATE_STOPPED");
 							download->state = URL_DOWNLOAD_STATE_READY;
-							if (download->callback.stopped) {
-								download->callback.stopped(download,
-								url_download_provider_error(stateinfo.err),
-								download->callback.stopped_user_data);
-							}
+							url_download_notify_stopped(download, url_download_provider_error(stateinfo.err));
 							// check state again,
 							// some client may change the state in callback
 							if (download
@@ -485,8 +573,7 @@ void *run_event_server(void *args)
 									|| download->state == URL_DOWNLOAD_STATE_FAILED
 									|| download->state == URL_DOWNLOAD_STATE_READY)) {
 								_clear_download_provider(download->sockfd);
-								_clear_socket(download->sockfd);
-								download->sockfd = 0;
+								_detach_download(download);
 							}
 							break;
 
@@ -499,24 +586,24 @@ void *run_event_server(void *args)
 							break;
 						case DOWNLOAD_STATE_PAUSED:
 							LOGI("DOWNLOAD_STATE_PAUSED");
+							// paused by the rate limit, it is not visible to the client
+							if (download->throttled)
+								break;
 							download->state = URL_DOWNLOAD_STATE_PAUSED;
-							if (download->callback.paused)
-								download->callback.paused(download, download->callback.paused_user_data);
+							url_download_notify_paused(download);
 							break;
 
 						case DOWNLOAD_STATE_FINISHED:
 							LOGI("DOWNLOAD_STATE_FINISHED");
 							download->state = URL_DOWNLOAD_STATE_COMPLETED;
-							if (download->callback.completed)
-								download->callback.completed(download, download->completed_path, download->callback.completed_user_data);
+							url_download_notify_completed(download);
 							// check state again,
 							// some client may change the state in callback
 							if (download
 								&& (download->state == URL_DOWNLOAD_STATE_COMPLETED
 									|| download->state == URL_DOWNLOAD_STATE_FAILED)) {
 								_clear_download_provider(download->sockfd);
-								_clear_socket(download->sockfd);
-								download->sockfd = 0;
+								_detach_download(download);
 							}
 							break;
 						case DOWNLOAD_STATE_READY:
@@ -528,34 +615,24 @@ void *run_event_server(void *args)
 						case DOWNLOAD_STATE_FAILED:
 							LOGI("DOWNLOAD_STATE_FAILED");
 							download->state = URL_DOWNLOAD_STATE_FAILED;
-							if (download->callback.stopped) {
-								download->callback.stopped(download,
-								url_download_provider_error(stateinfo.err),
-								download->callback.stopped_user_data);
-							}
+							url_download_notify_stopped(download, url_download_provider_error(stateinfo.err));
 							// check state again,
 							// some client may change the state in callback
 							if (download
 								&& (download->state == URL_DOWNLOAD_STATE_COMPLETED
 									|| download->state == URL_DOWNLOAD_STATE_FAILED)) {
 								_clear_download_provider(download->sockfd);
-								_clear_socket(download->sockfd);
-								download->sockfd = 0;
+								_detach_download(download);
 							}
 							break;
 						default:
 							url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, "invalid state change event");
-							url_download_stop(download);
-							if (download->callback.stopped) {
-								download->state = URL_DOWNLOAD_STATE_FAILED;
-								download->callback.stopped(download,
-								URL_DOWNLOAD_ERROR_IO_ERROR,
-								download->callback.stopped_user_data);
-							}
+							url_download_provider_stop(download);
+							download->state = URL_DOWNLOAD_STATE_FAILED;
+							url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_IO_ERROR);
 							if (download) {
 								_clear_download_provider(download->sockfd);
-								_clear_socket(download->sockfd);
-								download->sockfd = 0;
+								_detach_download(download);
 							}
 							break;
 					}
@@ -568,28 +645,23 @@ void *run_event_server(void *args)
 					LOGI("[%s]download[%p] slot[%d]",__FUNCTION__, download, download->slot_index);
 					// download-provider closed socket, just clear it from fd_set
 					if (download) {
-						_clear_socket(download->sockfd);
-						download->sockfd = 0;
+						_detach_download(download);
 					}
 					break;
 				} // switch
 			} else if (FD_ISSET(g_download_handle_list[i]->sockfd, &exceptset) > 0) {
 				is_timeout = 0;
 				url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, "IO Exception");
-				url_download_stop(g_download_handle_list[i]);
-				if (g_download_handle_list[i]->callback.stopped) {
-					g_download_handle_list[i]->state = URL_DOWNLOAD_STATE_FAILED;
-					g_download_handle_list[i]->callback.stopped(
-					g_download_handle_list[i],
-					URL_DOWNLOAD_ERROR_IO_ERROR,
-					g_download_handle_list[i]->callback.stopped_user_data);
-				}
+				url_download_provider_stop(g_download_handle_list[i]);
+				g_download_handle_list[i]->state = URL_DOWNLOAD_STATE_FAILED;
+				url_download_notify_stopped(g_download_handle_list[i], URL_DOWNLOAD_ERROR_IO_ERROR);
 				if (g_download_handle_list[i] != NULL) {
-					_clear_socket(g_download_handle_list[i]->sockfd);
-					g_download_handle_list[i]->sockfd = 0;
+					_detach_download(g_download_handle_list[i]);
 				}
 			}
 		} // MAX_CLIENT
+		// start the queued downloads if some finished
+		url_download_scheduler_dispatch();
 		if (is_timeout) // timeout with no event
 			_terminate_event_server_if_no_download();
 	}
@@ -664,11 +736,11 @@ int url_download_destroy(url_download_h download)
 	if (STATE_IS_RUNNING(download))
 		url_download_stop(download);
 
-	if (download->sockfd > 0)
-		_clear_download_provider(download->sockfd);
-
-	_clear_socket(download->sockfd);
-	download->sockfd = 0;
+	BACKEND_OF(download)->destroy(download);
+	url_download_http_cancel_probes(download);
+	url_download_scheduler_release(download);
+	url_download_coalesce_detach(download);
+	url_download_coalesce_clear_started(download);
 
 	g_download_handle_list[download->slot_index] = NULL;
 	download->slot_index = -1;
@@ -683,8 +755,24 @@ int url_download_destroy(url_download_h download)
 		free(download->mime_type);
 	if (download->content_name)
 		free(download->content_name);
+	if (download->file_name)
+		free(download->file_name);
 	if (download->completed_path)
 		free(download->completed_path);
+	if (download->host)
+		free(download->host);
+	if (download->expected_digest)
+		free(download->expected_digest);
+	if (download->digest)
+		free(download->digest);
+	if (download->delta_source)
+		free(download->delta_source);
+	if (download->delta_manifest)
+		free(download->delta_manifest);
+	if (download->memory)
+		free(download->memory);
+	if (download->memory_fd > 0)
+		close(download->memory_fd);
 	if (download->service_data)
 		bundle_free_encoded_rawdata(&(download->service_data));
 	memset(&(download->callback), 0x00, sizeof(struct url_download_cb_s));
@@ -696,16 +784,40 @@ int url_download_destroy(url_download_h download)
 }
 
 extern int service_export_as_bundle(service_h service, bundle **data);
-// connect to download-provider. then send request info.
+
+static const struct url_download_backend_s *_select_backend(url_download_h download)
+{
+	url_download_backend_e type = download->backend_type;
+
+	// the local urls are copied without IPC whatever the backend,
+	// download-provider does not know the ranges, the digests, the delta downloads,
+	// the checkpoints, the atomic completions, the archive extraction nor the memory
+	// destinations. the content store and the revalidation are global, they are used
+	// by the downloads of the in-process backend only.
+	if (type == URL_DOWNLOAD_BACKEND_IN_PROCESS || url_download_url_is_local(download->url)
+		|| download->range_offset != 0 || download->range_length != 0
+		|| download->digest_type != URL_DOWNLOAD_DIGEST_NONE || download->delta_source != NULL
+		|| download->checkpoint || download->atomic_completion || download->archive_extraction
+		|| download->destination_type != URL_DOWNLOAD_DESTINATION_FILE)
+		return &url_download_http_backend;
+	// download-provider is not running in the headless environments
+	if (type == URL_DOWNLOAD_BACKEND_AUTO && access(DOWNLOAD_PROVIDER_IPC, F_OK) != 0) {
+		LOGI("[%s] download-provider is not available, use the in-process backend",__FUNCTION__);
+		return &url_download_http_backend;
+	}
+	return &url_download_provider_backend;
+}
+
 int url_download_start(url_download_h download, int *id)
 {
-	char **headers = NULL;
-	int header_length = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int admitted = 0;
 
 	if (!download || !download->url)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
 
-	if (download->state == URL_DOWNLOAD_STATE_DOWNLOADING)
+	if (download->state == URL_DOWNLOAD_STATE_DOWNLOADING
+		|| download->state == URL_DOWNLOAD_STATE_QUEUED)
 		return url_download_error_invalid_state(__FUNCTION__, download);
 
 	if (download->state == URL_DOWNLOAD_STATE_COMPLETED)
@@ -714,21 +826,65 @@ int url_download_start(url_download_h download, int *id)
 	if (download->state == URL_DOWNLOAD_STATE_PAUSED)
 		return url_download_resume(download);
 
+	download->backend = _select_backend(download);
+	url_download_coalesce_clear_started(download);
+	if (url_download_coalesce_attach(download)) {
+		if (id)
+			*id = download->requestid;
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	admitted = url_download_scheduler_admit(download);
+	if (admitted < 0)
+		return url_download_error(__FUNCTION__, admitted, NULL);
+	if (!admitted) {
+		if (id)
+			*id = download->requestid;
+		// the limit may have been raised in the meantime
+		url_download_scheduler_dispatch();
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	errorcode = download->backend->start(download, id);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		url_download_scheduler_release(download);
+	return errorcode;
+}
+
+// connect to download-provider. then send request info.
+int url_download_provider_start(url_download_h download, int *id)
+{
+	char **headers = NULL;
+	int header_length = 0;
+
 	_clear_socket(download->sockfd);
+	url_download_rate_limit_reset(download);
 
 	download->sockfd = _connect_download_provider();
 	if (download->sockfd < 0) {
 		LOGE("[%s]socket system error : %s",__FUNCTION__,strerror(errno));
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
 	}
+	// the event thread waits on the sockets with select()
+	if (download->sockfd >= FD_SETSIZE) {
+		LOGE("[%s] socket[%d] over FD_SETSIZE",__FUNCTION__, download->sockfd);
+		close(download->sockfd);
+		download->sockfd = 0;
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS, "Too many running downloads");
+	}
 
 	download_request_info requestMsg;
 	memset(&requestMsg, 0x00, sizeof(download_request_info));
-	requestMsg.callbackinfo.started = (download->callback.started ? 1 : 0);
-	requestMsg.callbackinfo.paused = (download->callback.paused ? 1 : 0);
-	requestMsg.callbackinfo.completed = (download->callback.completed ? 1 : 0);
-	requestMsg.callbackinfo.stopped = (download->callback.stopped ? 1 : 0);
-	requestMsg.callbackinfo.progress = (download->callback.progress ? 1 : 0);
+	download->provider_events = url_download_coalesce_events(download);
+	if (NEEDS_PROGRESS_INFO(download))
+		download->provider_events |= URL_DOWNLOAD_EVENT_PROGRESS;
+	// the end of the download frees its place in the scheduler, with or without callbacks
+	download->provider_events |= URL_DOWNLOAD_EVENT_COMPLETED | URL_DOWNLOAD_EVENT_STOPPED;
+	requestMsg.callbackinfo.started = (download->provider_events & URL_DOWNLOAD_EVENT_STARTED ? 1 : 0);
+	requestMsg.callbackinfo.paused = (download->provider_events & URL_DOWNLOAD_EVENT_PAUSED ? 1 : 0);
+	requestMsg.callbackinfo.completed = (download->provider_events & URL_DOWNLOAD_EVENT_COMPLETED ? 1 : 0);
+	requestMsg.callbackinfo.stopped = (download->provider_events & URL_DOWNLOAD_EVENT_STOPPED ? 1 : 0);
+	requestMsg.callbackinfo.progress = (download->provider_events & URL_DOWNLOAD_EVENT_PROGRESS ? 1 : 0);
 	requestMsg.notification = download->enable_notification;
 
 	if (download->requestid > 0)
@@ -871,7 +1027,8 @@ int url_download_start(url_download_h download, int *id)
 		}
 		if (requeststateinfo.requestid > 0) {
 			download->requestid = requeststateinfo.requestid;
-			(*id) = requeststateinfo.requestid;
+			if (id)
+				(*id) = requeststateinfo.requestid;
 		}
 		if (requeststateinfo.stateinfo.state == DOWNLOAD_STATE_DOWNLOADING) {
 			// started download normally.
@@ -886,16 +1043,13 @@ int url_download_start(url_download_h download, int *id)
 	} else {
 		LOGE("[%s]receive header :error",__FUNCTION__);
 		url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
-		url_download_stop(download);
+		url_download_provider_stop(download);
 
 		return URL_DOWNLOAD_ERROR_IO_ERROR;
 	}
 
 	// capi need the thread for listening message from download-provider; this will deal the callbacks.
-	if (download->callback.completed
-		|| download->callback.stopped
-		|| download->callback.progress
-		|| download->callback.paused) {
+	if (HAS_EVENT_LISTENER(download)) {
 		if (g_download_maxfd <= 0) {
 			pthread_attr_t thread_attr;
 			LOGI("[%s][%d] initialize fd_set",__FUNCTION__, __LINE__);
@@ -939,8 +1093,20 @@ int url_download_start(url_download_h download, int *id)
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
-// send pause message
 int url_download_pause(url_download_h download)
+{
+	// the transfer is shared with the handles attached to it
+	if (download != NULL && download->coalesce_leader != NULL)
+		return url_download_pause(download->coalesce_leader);
+
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	return BACKEND_OF(download)->pause(download);
+}
+
+// send pause message
+static int _provider_pause(url_download_h download)
 {
 	if (download == NULL || download->requestid <= 0)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
@@ -948,16 +1114,16 @@ int url_download_pause(url_download_h download)
 	if (download->state != URL_DOWNLOAD_STATE_DOWNLOADING)
 		return url_download_error_invalid_state(__FUNCTION__, download);
 
+	// an explicit pause overrides the pending resume of the rate limit
+	download->throttled = 0;
+
 	if (download->sockfd > 0) {
 		if (ipc_send_download_control(download->sockfd, DOWNLOAD_CONTROL_PAUSE)
 			!= DOWNLOAD_CONTROL_PAUSE) {
 			LOGE("[%s] [%d] URL_DOWNLOAD_ERROR_IO_ERROR", __FUNCTION__, __LINE__);
 			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
 		}
-		if (!(download->callback.completed
-			|| download->callback.stopped
-			|| download->callback.progress
-			|| download->callback.paused)) {  // if no callback
+		if (!HAS_EVENT_LISTENER(download)) {  // if no callback
 			// Sync style
 			if (ipc_receive_header(download->sockfd) == DOWNLOAD_CONTROL_GET_STATE_INFO) {
 				download_state_info stateinfo;
@@ -1009,7 +1175,19 @@ int url_download_pause(url_download_h download)
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
-int url_download_resume(url_download_h download)
+static int url_download_resume(url_download_h download)
+{
+	if (download != NULL && download->coalesce_leader != NULL)
+		return url_download_resume(download->coalesce_leader);
+
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	return BACKEND_OF(download)->resume(download);
+}
+
+// send resume message
+static int _provider_resume(url_download_h download)
 {
 	if (download == NULL || download->requestid <= 0)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
@@ -1023,10 +1201,7 @@ int url_download_resume(url_download_h download)
 			LOGE("[%s] [%d] URL_DOWNLOAD_ERROR_IO_ERROR", __FUNCTION__, __LINE__);
 			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
 		}
-		if (!(download->callback.completed
-			|| download->callback.stopped
-			|| download->callback.progress
-			|| download->callback.paused)) {  // if no callback
+		if (!HAS_EVENT_LISTENER(download)) {  // if no callback
 			// Sync style
 			if (ipc_receive_header(download->sockfd) == DOWNLOAD_CONTROL_GET_STATE_INFO) {
 				download_state_info stateinfo;
@@ -1079,8 +1254,34 @@ int url_download_resume(url_download_h download)
 }
 
 
-// send stop message
 int url_download_stop(url_download_h download)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	// leave the shared transfer, it goes on for the other handles
+	if (download->coalesce_leader != NULL
+		|| (download->followers != NULL && STATE_IS_RUNNING(download)
+			&& url_download_coalesce_handover(download) != NULL)) {
+		url_download_coalesce_detach(download);
+		download->state = URL_DOWNLOAD_STATE_READY;
+		url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_NONE);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	if (download->state == URL_DOWNLOAD_STATE_QUEUED) {
+		// not sent to download-provider yet
+		url_download_scheduler_release(download);
+		download->state = URL_DOWNLOAD_STATE_READY;
+		url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_NONE);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+
+	return BACKEND_OF(download)->stop(download);
+}
+
+// send stop message
+int url_download_provider_stop(url_download_h download)
 {
 	if (download == NULL || download->requestid <= 0)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
@@ -1089,16 +1290,15 @@ int url_download_stop(url_download_h download)
 		&& download->state != URL_DOWNLOAD_STATE_PAUSED)
 		return url_download_error_invalid_state(__FUNCTION__, download);
 
+	download->throttled = 0;
+
 	if (download->sockfd > 0) {
 		if (ipc_send_download_control(download->sockfd, DOWNLOAD_CONTROL_STOP)
 			!= DOWNLOAD_CONTROL_STOP) {
 			LOGE("[%s] [%d] URL_DOWNLOAD_ERROR_IO_ERROR", __FUNCTION__, __LINE__);
 			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_IO_ERROR, NULL);
 		}
-		if (!(download->callback.completed
-			|| download->callback.stopped
-			|| download->callback.progress
-			|| download->callback.paused)) {  // if no callback
+		if (!HAS_EVENT_LISTENER(download)) {  // if no callback
 			// Sync style
 			if (ipc_receive_header(download->sockfd) == DOWNLOAD_CONTROL_GET_STATE_INFO) {
 				download_state_info stateinfo;
@@ -1147,24 +1347,47 @@ int url_download_stop(url_download_h download)
 			_clear_socket(sockfd);
 		}
 	}
+	// no stopped event will come without socket or callback
+	if (download->sockfd <= 0 || !HAS_EVENT_LISTENER(download)) {
+		url_download_scheduler_release(download);
+		url_download_scheduler_dispatch();
+	}
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
 int url_download_get_state(url_download_h download, url_download_state_e *state)
 {
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
 	if (download == NULL || state == NULL)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
 
-	if (download->requestid <= 0) {
+	if (download->coalesce_leader != NULL)
+		download->state = download->coalesce_leader->state;
+
+	if (download->requestid <= 0 || download->state == URL_DOWNLOAD_STATE_QUEUED
+		|| download->coalesce_leader != NULL) {
 		*state = download->state;
 		return URL_DOWNLOAD_ERROR_NONE;
 	}
 
+	errorcode = BACKEND_OF(download)->get_state(download);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+
+	if (download->state == URL_DOWNLOAD_STATE_COMPLETED
+		|| download->state == URL_DOWNLOAD_STATE_FAILED)
+		url_download_scheduler_release(download);
+	*state = download->state;
+
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// get the state from download-provider when no event tells it
+static int _provider_get_state(url_download_h download)
+{
 	if (download->sockfd > 0) {
-		if (!(download->callback.completed
-			|| download->callback.stopped
-			|| download->callback.progress
-			|| download->callback.paused)) {// only when does not use the callback.
+		if (!HAS_EVENT_LISTENER(download)) {// only when does not use the callback.
 
 			if (ipc_send_download_control(download->sockfd, DOWNLOAD_CONTROL_GET_STATE_INFO)
 				== DOWNLOAD_CONTROL_GET_STATE_INFO) {
@@ -1220,11 +1443,27 @@ int url_download_get_state(url_download_h download, url_download_state_e *state)
 			_clear_socket(sockfd);
 		}
 	}
-	*state = download->state;
-
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
+static void _provider_destroy(url_download_h download)
+{
+	if (download->sockfd > 0)
+		_clear_download_provider(download->sockfd);
+
+	_clear_socket(download->sockfd);
+	download->sockfd = 0;
+}
+
+const struct url_download_backend_s url_download_provider_backend = {
+	url_download_provider_start,
+	_provider_pause,
+	_provider_resume,
+	url_download_provider_stop,
+	_provider_get_state,
+	_provider_destroy,
+};
+
 int url_download_set_url(url_download_h download, const char *url)
 {
 	char *url_dup = NULL;
@@ -1272,6 +1511,28 @@ int url_download_get_url(url_download_h download, char **url)
 }
 
 
+int url_download_set_backend(url_download_h download, url_download_backend_e backend)
+{
+	if (download == NULL
+		|| backend < URL_DOWNLOAD_BACKEND_PROVIDER || backend > URL_DOWNLOAD_BACKEND_AUTO)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->backend_type = backend;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_backend(url_download_h download, url_download_backend_e *backend)
+{
+	if (download == NULL || backend == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*backend = download->backend_type;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
 int url_download_set_destination(url_download_h download, const char *path)
 {
 	char *path_dup = NULL;
@@ -1298,6 +1559,14 @@ int url_download_set_destination(url_download_h download, const char *path)
 }
 
 
+// the directory of the file, the default one if the destination is not set
+const char *url_download_destination_directory(url_download_h download)
+{
+	if (download->destination == NULL || download->destination[0] == '\0')
+		return URL_DOWNLOAD_DEFAULT_DESTINATION;
+	return download->destination;
+}
+
 int url_download_get_destination(url_download_h download, char **path)
 {
 	char *path_dup = NULL;
@@ -1325,8 +1594,11 @@ int url_download_set_file_name(url_download_h download, const char *file_name)
 
 	if (download->content_name)
 		free(download->content_name);
+	if (download->file_name)
+		free(download->file_name);
 	download->content_name = strdup(file_name);
-	if (download->content_name == NULL)
+	download->file_name = strdup(file_name);
+	if (download->content_name == NULL || download->file_name == NULL)
 		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
 	return URL_DOWNLOAD_ERROR_NONE;
 }
@@ -1350,6 +1622,271 @@ int url_download_get_file_name(url_download_h download, char **file_name)
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
+int url_download_set_range(url_download_h download, long long offset, long long length)
+{
+	if (download == NULL || length < 0 || (offset < 0 && length != 0))
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->range_offset = offset;
+	download->range_length = length;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_range(url_download_h download, long long *offset, long long *length)
+{
+	if (download == NULL || offset == NULL || length == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*offset = download->range_offset;
+	*length = download->range_length;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_expected_digest(url_download_h download, url_download_digest_e type, const char *expected)
+{
+	char *expected_dup = NULL;
+	size_t i = 0;
+
+	if (download == NULL || type < URL_DOWNLOAD_DIGEST_NONE || type > URL_DOWNLOAD_DIGEST_XXH64
+		|| (type == URL_DOWNLOAD_DIGEST_NONE && expected != NULL))
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	if (expected != NULL) {
+		expected_dup = strdup(expected);
+		if (expected_dup == NULL)
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+		for (i = 0; expected_dup[i] != '\0'; i++)
+			expected_dup[i] = tolower((unsigned char)expected_dup[i]);
+	}
+	if (download->expected_digest)
+		free(download->expected_digest);
+	download->expected_digest = expected_dup;
+	download->digest_type = type;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_digest(url_download_h download, url_download_digest_e *type, char **digest)
+{
+	char *digest_dup = NULL;
+
+	if (download == NULL || type == NULL || digest == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->digest == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_STATE, NULL);
+
+	digest_dup = strdup(download->digest);
+	if (digest_dup == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+
+	*type = download->digest_type;
+	*digest = digest_dup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_is_not_modified(url_download_h download, bool *not_modified)
+{
+	if (download == NULL || not_modified == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->state != URL_DOWNLOAD_STATE_COMPLETED)
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	*not_modified = (download->not_modified ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_range_at_offset(url_download_h download, bool enable)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->range_at_offset = (enable ? 1 : 0);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_range_at_offset(url_download_h download, bool *enable)
+{
+	if (download == NULL || enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*enable = (download->range_at_offset ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_checkpoint(url_download_h download, bool enable)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->checkpoint = (enable ? 1 : 0);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_checkpoint(url_download_h download, bool *enable)
+{
+	if (download == NULL || enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*enable = (download->checkpoint ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_atomic_completion(url_download_h download, bool enable)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->atomic_completion = (enable ? 1 : 0);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_atomic_completion(url_download_h download, bool *enable)
+{
+	if (download == NULL || enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*enable = (download->atomic_completion ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_archive_extraction(url_download_h download, bool enable)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->archive_extraction = (enable ? 1 : 0);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_archive_extraction(url_download_h download, bool *enable)
+{
+	if (download == NULL || enable == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*enable = (download->archive_extraction ? true : false);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_destination_type(url_download_h download, url_download_destination_type_e type)
+{
+	if (download == NULL || type < URL_DOWNLOAD_DESTINATION_FILE || type > URL_DOWNLOAD_DESTINATION_MEMFD)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->destination_type = type;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_destination_type(url_download_h download, url_download_destination_type_e *type)
+{
+	if (download == NULL || type == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*type = download->destination_type;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_memory(url_download_h download, const void **data, size_t *length)
+{
+	if (download == NULL || data == NULL || length == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->state != URL_DOWNLOAD_STATE_COMPLETED
+		|| download->destination_type != URL_DOWNLOAD_DESTINATION_MEMORY)
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	*data = download->memory;
+	*length = download->memory_length;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_memory_fd(url_download_h download, int *fd)
+{
+	if (download == NULL || fd == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->state != URL_DOWNLOAD_STATE_COMPLETED || download->memory_fd <= 0)
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	*fd = download->memory_fd;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_delta_source(url_download_h download, const char *path, const char *manifest_url)
+{
+	char *path_dup = NULL;
+	char *manifest_dup = NULL;
+
+	if (download == NULL || (path == NULL && manifest_url != NULL))
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	if (path != NULL) {
+		path_dup = strdup(path);
+		if (manifest_url != NULL)
+			manifest_dup = strdup(manifest_url);
+		if (path_dup == NULL || (manifest_url != NULL && manifest_dup == NULL)) {
+			if (path_dup)
+				free(path_dup);
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+		}
+	}
+	if (download->delta_source)
+		free(download->delta_source);
+	if (download->delta_manifest)
+		free(download->delta_manifest);
+	download->delta_source = path_dup;
+	download->delta_manifest = manifest_dup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_delta_source(url_download_h download, char **path, char **manifest_url)
+{
+	char *path_dup = NULL;
+	char *manifest_dup = NULL;
+
+	if (download == NULL || path == NULL || manifest_url == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (download->delta_source == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_NO_DATA, NULL);
+
+	path_dup = strdup(download->delta_source);
+	if (download->delta_manifest != NULL)
+		manifest_dup = strdup(download->delta_manifest);
+	if (path_dup == NULL || (download->delta_manifest != NULL && manifest_dup == NULL)) {
+		if (path_dup)
+			free(path_dup);
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	}
+	*path = path_dup;
+	*manifest_url = manifest_dup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
 int url_download_set_notification(url_download_h download, service_h service)
 {
 	if (download == NULL)
@@ -1647,6 +2184,37 @@ int url_download_unset_progress_cb(url_download_h download)
 	return URL_DOWNLOAD_ERROR_NONE;
 }
 
+
+int url_download_set_extracted_cb(url_download_h download, url_download_extracted_cb callback, void *user_data)
+{
+	if (download == NULL || callback == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->callback.extracted = callback;
+	download->callback.extracted_user_data = user_data;
+
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+
+int url_download_unset_extracted_cb(url_download_h download)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	if (STATE_IS_RUNNING(download))
+//		return url_download_error_invalid_state(__FUNCTION__, download);
+		url_download_error_invalid_state(__FUNCTION__, download);
+
+	download->callback.extracted = NULL;
+	download->callback.extracted_user_data = NULL;
+
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
 typedef struct http_field_array_s{
 	char **array;
 	int array_length;
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// budget shared by all downloads of the process
+static struct url_download_token_bucket_s g_download_global_bucket = {0,};
+static pthread_mutex_t g_download_rate_limit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define NSEC_PER_SEC 1000000000LL
+
+void url_download_token_bucket_init(struct url_download_token_bucket_s *bucket, unsigned long long rate)
+{
+	if (bucket == NULL)
+		return;
+	bucket->rate = rate;
+	// start with a full bucket, one second worth of data
+	bucket->tokens = (long long)rate;
+	bucket->fill_remainder = 0;
+	clock_gettime(CLOCK_MONOTONIC, &bucket->last_fill);
+}
+
+static void _token_bucket_fill(struct url_download_token_bucket_s *bucket)
+{
+	struct timespec now;
+	long long elapsed_ns;
+	long long part;
+	long long add;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_ns = (now.tv_sec - bucket->last_fill.tv_sec) * NSEC_PER_SEC
+		+ (now.tv_nsec - bucket->last_fill.tv_nsec);
+	if (elapsed_ns <= 0)
+		return;
+	bucket->last_fill = now;
+
+	if (elapsed_ns >= NSEC_PER_SEC) {
+		add = (long long)bucket->rate;
+		bucket->fill_remainder = 0;
+	} else {
+		// the fraction of a token is carried to the next fill, split not to overflow
+		part = (long long)(bucket->rate % NSEC_PER_SEC) * elapsed_ns + bucket->fill_remainder;
+		add = (long long)(bucket->rate / NSEC_PER_SEC) * elapsed_ns + part / NSEC_PER_SEC;
+		bucket->fill_remainder = part % NSEC_PER_SEC;
+	}
+	// the bucket holds at most one second worth of data, compared not to overflow
+	if (bucket->tokens >= 0 && add >= (long long)bucket->rate - bucket->tokens) {
+		bucket->tokens = (long long)bucket->rate;
+		bucket->fill_remainder = 0;
+	} else {
+		bucket->tokens += add;
+	}
+}
+
+// returns the time in ms to wait until the bucket is not in debt anymore.
+long url_download_token_bucket_consume(struct url_download_token_bucket_s *bucket, unsigned long long bytes)
+{
+	if (bucket == NULL || bucket->rate == 0)
+		return 0;
+
+	_token_bucket_fill(bucket);
+	bucket->tokens -= (long long)bytes;
+	if (bucket->tokens >= 0)
+		return 0;
+	return (long)((-bucket->tokens) * 1000 / (long long)bucket->rate) + 1;
+}
+
+int url_download_rate_limit_enabled(url_download_h download)
+{
+	int enabled = 0;
+
+	if (download != NULL && download->rate_bucket.rate > 0)
+		return 1;
+
+	pthread_mutex_lock(&g_download_rate_limit_mutex);
+	enabled = (g_download_global_bucket.rate > 0);
+	pthread_mutex_unlock(&g_download_rate_limit_mutex);
+	return enabled;
+}
+
+void url_download_rate_limit_reset(url_download_h download)
+{
+	if (download == NULL)
+		return;
+	download->received_size = 0;
+	download->throttled = 0;
+	url_download_token_bucket_init(&download->rate_bucket, download->rate_bucket.rate);
+}
+
+// returns the number of bytes received since the previous progress report.
+unsigned long long url_download_update_received_size(url_download_h download, unsigned long long received)
+{
+	unsigned long long bytes = 0;
+
+	if (download == NULL)
+		return 0;
+
+	// the provider restarted the transfer from the beginning
+	if (received < download->received_size)
+		bytes = received;
+	else
+		bytes = received - download->received_size;
+	download->received_size = received;
+	return bytes;
+}
+
+// account the received bytes against both budgets.
+long url_download_rate_limit_consume(url_download_h download, unsigned long long bytes)
+{
+	long delay = 0;
+	long global_delay = 0;
+
+	if (download == NULL)
+		return 0;
+
+	delay = url_download_token_bucket_consume(&download->rate_bucket, bytes);
+
+	pthread_mutex_lock(&g_download_rate_limit_mutex);
+	global_delay = url_download_token_bucket_consume(&g_download_global_bucket, bytes);
+	pthread_mutex_unlock(&g_download_rate_limit_mutex);
+
+	return (delay > global_delay ? delay : global_delay);
+}
+
+int url_download_set_rate_limit(url_download_h download, unsigned long long bytes_per_sec)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	// the bucket counts tokens in a signed budget
+	if (bytes_per_sec > LLONG_MAX)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "rate too large");
+
+	if (STATE_IS_RUNNING(download))
+		return url_download_error_invalid_state(__FUNCTION__, download);
+
+	LOGI("[%s] rate limit [%llu]", __FUNCTION__, bytes_per_sec);
+	url_download_token_bucket_init(&download->rate_bucket, bytes_per_sec);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_rate_limit(url_download_h download, unsigned long long *bytes_per_sec)
+{
+	if (download == NULL || bytes_per_sec == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	*bytes_per_sec = download->rate_bucket.rate;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_global_rate_limit(unsigned long long bytes_per_sec)
+{
+	if (bytes_per_sec > LLONG_MAX)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, "rate too large");
+
+	LOGI("[%s] global rate limit [%llu]", __FUNCTION__, bytes_per_sec);
+	pthread_mutex_lock(&g_download_rate_limit_mutex);
+	url_download_token_bucket_init(&g_download_global_bucket, bytes_per_sec);
+	pthread_mutex_unlock(&g_download_rate_limit_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_global_rate_limit(unsigned long long *bytes_per_sec)
+{
+	if (bytes_per_sec == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_rate_limit_mutex);
+	*bytes_per_sec = g_download_global_bucket.rate;
+	pthread_mutex_unlock(&g_download_rate_limit_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
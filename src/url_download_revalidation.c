@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The revalidation index : the validators of the files downloaded from
+// each url to each destination, one line per file, the newest last :
+//
+// <ETag> TAB <Last-Modified> TAB <size> TAB <mtime> TAB <url> TAB <destination> TAB <path>
+//
+// The index is read at each start and written again, through a temporary
+// file, at each completion. The processes sharing it may lose an entry of
+// one another, the file is then downloaded again.
+
+#define REVALIDATION_FIELD_COUNT 7
+
+struct url_download_revalidation_entry_s {
+	char *line;
+	char *fields[REVALIDATION_FIELD_COUNT];
+};
+
+static char *g_revalidation_index = NULL;
+static pthread_mutex_t g_revalidation_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// splits the line in its fields, the line is kept by the entry
+static int _parse_entry(char *line, struct url_download_revalidation_entry_s *entry)
+{
+	char *next = line;
+	int i = 0;
+
+	line[strcspn(line, "\n")] = '\0';
+	entry->line = line;
+	for (i = 0; i < REVALIDATION_FIELD_COUNT; i++) {
+		entry->fields[i] = strsep(&next, "\t");
+		if (entry->fields[i] == NULL)
+			return -1;
+	}
+	return (next == NULL ? 0 : -1);
+}
+
+// returns the number of entries read from the index, the last ones are kept in
+// entries, entry i at i modulo URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES.
+static int _read_index(const char *index, struct url_download_revalidation_entry_s *entries)
+{
+	struct url_download_revalidation_entry_s entry;
+	FILE *file = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	int count = 0;
+
+	file = fopen(index, "re");
+	if (file == NULL)
+		return 0;
+	while (getline(&line, &size, file) >= 0) {
+		if (_parse_entry(line, &entry) < 0)
+			continue;
+		// the oldest entries beyond the limit are dropped
+		if (count >= URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES)
+			free(entries[count % URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES].line);
+		entries[count % URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES] = entry;
+		count++;
+		line = NULL;
+		size = 0;
+	}
+	if (line)
+		free(line);
+	fclose(file);
+	return count;
+}
+
+static void _free_entries(struct url_download_revalidation_entry_s *entries, int count)
+{
+	int i = 0;
+
+	for (i = 0; i < count && i < URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES; i++)
+		free(entries[i].line);
+	free(entries);
+}
+
+static int _same_key(struct url_download_revalidation_entry_s *entry, const char *url, const char *destination)
+{
+	return (strcmp(entry->fields[4], url) == 0 && strcmp(entry->fields[5], destination) == 0);
+}
+
+// a value of the index does not contain the separators
+static int _valid_field(const char *value)
+{
+	return (value == NULL || strpbrk(value, "\t\n") == NULL);
+}
+
+int url_download_revalidation_enabled()
+{
+	int enabled = 0;
+
+	pthread_mutex_lock(&g_revalidation_mutex);
+	enabled = (g_revalidation_index != NULL);
+	pthread_mutex_unlock(&g_revalidation_mutex);
+	return enabled;
+}
+
+// gets the file downloaded from the url to the destination and its validators,
+// if the file was not changed since.
+int url_download_revalidation_find(const char *url, const char *destination,
+		char **path, char **etag, char **last_modified)
+{
+	struct url_download_revalidation_entry_s *entries = NULL;
+	struct url_download_revalidation_entry_s *entry = NULL;
+	struct stat st;
+	char mtime[64] = {0,};
+	int count = 0;
+	int i = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NO_DATA;
+
+	entries = calloc(URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES, sizeof(struct url_download_revalidation_entry_s));
+	if (entries == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	pthread_mutex_lock(&g_revalidation_mutex);
+	if (g_revalidation_index != NULL)
+		count = _read_index(g_revalidation_index, entries);
+	pthread_mutex_unlock(&g_revalidation_mutex);
+
+	// the newest entry of the url and the destination
+	for (i = count - 1; i >= 0 && i >= count - URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES && entry == NULL; i--) {
+		if (_same_key(&entries[i % URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES], url, destination))
+			entry = &entries[i % URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES];
+	}
+	if (entry != NULL && stat(entry->fields[6], &st) == 0) {
+		snprintf(mtime, sizeof(mtime), "%lld.%09ld", (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+		// the file was changed or replaced since it was downloaded
+		if (strtoll(entry->fields[2], NULL, 10) != (long long)st.st_size || strcmp(entry->fields[3], mtime) != 0) {
+			LOGI("[%s] [%s] changed since its download",__FUNCTION__, entry->fields[6]);
+		} else {
+			*path = strdup(entry->fields[6]);
+			*etag = (entry->fields[0][0] ? strdup(entry->fields[0]) : NULL);
+			*last_modified = (entry->fields[1][0] ? strdup(entry->fields[1]) : NULL);
+			errorcode = URL_DOWNLOAD_ERROR_NONE;
+			if (*path == NULL || (entry->fields[0][0] && *etag == NULL)
+				|| (entry->fields[1][0] && *last_modified == NULL)) {
+				free(*path);
+				free(*etag);
+				free(*last_modified);
+				errorcode = URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+			}
+		}
+	}
+	_free_entries(entries, count);
+	return errorcode;
+}
+
+// the validators of the completed file replace the ones of the same url and destination
+void url_download_revalidation_record(const char *url, const char *destination,
+		const char *path, const char *etag, const char *last_modified)
+{
+	struct url_download_revalidation_entry_s *entries = NULL;
+	struct stat st;
+	FILE *file = NULL;
+	char *temporary = NULL;
+	size_t size = 0;
+	int count = 0;
+	int first = 0;
+	int written = 0;
+	int i = 0;
+	int j = 0;
+
+	if (!_valid_field(url) || !_valid_field(destination) || !_valid_field(path)
+		|| !_valid_field(etag) || !_valid_field(last_modified) || stat(path, &st) < 0)
+		return;
+	entries = calloc(URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES, sizeof(struct url_download_revalidation_entry_s));
+	if (entries == NULL)
+		return;
+
+	pthread_mutex_lock(&g_revalidation_mutex);
+	if (g_revalidation_index == NULL) {
+		pthread_mutex_unlock(&g_revalidation_mutex);
+		free(entries);
+		return;
+	}
+	size = strlen(g_revalidation_index) + 32;
+	temporary = calloc(size, sizeof(char));
+	if (temporary != NULL) {
+		snprintf(temporary, size, "%s.%d.tmp", g_revalidation_index, getpid());
+		count = _read_index(g_revalidation_index, entries);
+		file = fopen(temporary, "we");
+	}
+	if (file != NULL) {
+		// the oldest entry gives its place to the new one
+		first = (count >= URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES ? count - URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES + 1 : 0);
+		for (i = first; i < count; i++) {
+			j = i % URL_DOWNLOAD_REVALIDATION_MAX_ENTRIES;
+			if (_same_key(&entries[j], url, destination))
+				continue;
+			fprintf(file, "%s\t%s\t%s\t%s\t%s\t%s\t%s\n", entries[j].fields[0], entries[j].fields[1],
+				entries[j].fields[2], entries[j].fields[3], entries[j].fields[4],
+				entries[j].fields[5], entries[j].fields[6]);
+		}
+		fprintf(file, "%s\t%s\t%lld\t%lld.%09ld\t%s\t%s\t%s\n", etag ? etag : "",
+			last_modified ? last_modified : "", (long long)st.st_size,
+			(long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec, url, destination, path);
+		written = (fclose(file) == 0 && rename(temporary, g_revalidation_index) == 0);
+		if (!written) {
+			LOGE("[%s] write [%s] : %s",__FUNCTION__, g_revalidation_index, strerror(errno));
+			unlink(temporary);
+		}
+	}
+	pthread_mutex_unlock(&g_revalidation_mutex);
+
+	if (temporary)
+		free(temporary);
+	_free_entries(entries, count);
+}
+
+int url_download_set_revalidation_index(const char *path)
+{
+	char *path_dup = NULL;
+
+	if (path != NULL) {
+		if (path[0] != '/')
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, path);
+		path_dup = strdup(path);
+		if (path_dup == NULL)
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+	}
+
+	pthread_mutex_lock(&g_revalidation_mutex);
+	if (g_revalidation_index)
+		free(g_revalidation_index);
+	g_revalidation_index = path_dup;
+	pthread_mutex_unlock(&g_revalidation_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_revalidation_index(char **path)
+{
+	char *path_dup = NULL;
+
+	if (path == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_revalidation_mutex);
+	if (g_revalidation_index != NULL)
+		path_dup = strdup(g_revalidation_index);
+	pthread_mutex_unlock(&g_revalidation_mutex);
+	if (path_dup == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_NO_DATA, NULL);
+
+	*path = path_dup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
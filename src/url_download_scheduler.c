@@ -0,0 +1,809 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The scheduler admits the started downloads into the active list.
+// When a limit is reached, the download waits in the pending list and
+// it is admitted later, round-robin across the hosts of the pending downloads,
+// or the shortest first with URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST.
+static pthread_mutex_t g_download_scheduler_mutex = PTHREAD_MUTEX_INITIALIZER;
+// The lists are linked through scheduler_next, a download is in one of them
+// at most. The pending list is in the order of the requests.
+static url_download_h g_download_active_list = NULL;
+static url_download_h g_download_pending_list = NULL;
+static int g_download_max_active = 0;
+static int g_download_max_per_host = 0;
+static unsigned long g_download_sequence = 0;
+static url_download_scheduling_policy_e g_download_policy = URL_DOWNLOAD_SCHEDULING_FIFO;
+
+// the sizes reported by the latest downloads, by URL, for the shortest first policy
+struct url_download_size_entry_s {
+	char *url;
+	unsigned long long size;
+};
+static struct url_download_size_entry_s g_download_size_cache[URL_DOWNLOAD_SIZE_CACHE_COUNT] = {{0,},};
+static int g_download_size_cache_next = 0;
+
+// The space reservations : an active download whose size is known reserves
+// it on the file system of its destination, until it leaves the active list
+// or its file is preallocated. A download which does not fit in the free
+// space minus the space reserved by the others waits in the pending list,
+// it fails with URL_DOWNLOAD_ERROR_NO_SPACE if it does not fit in the free space.
+typedef enum {
+	SPACE_FITS,
+	SPACE_WAIT,
+	SPACE_NEVER,
+} space_e;
+
+// the free space of the destinations, looked up once per pass over the pending list.
+// A pass starts anew after each admission, the started download may have taken space.
+struct url_download_space_entry_s {
+	char *directory;
+	dev_t dev;
+	unsigned long long available;
+	int error;
+};
+static struct url_download_space_entry_s g_download_space_cache[URL_DOWNLOAD_SPACE_CACHE_COUNT] = {{0,},};
+static int g_download_space_cache_count = 0;
+
+typedef enum {
+	ADAPTIVE_HOLD,
+	ADAPTIVE_INCREASE,
+	ADAPTIVE_DECREASE,
+} adaptive_action_e;
+
+// The adaptive concurrency climbs the throughput curve : one more download
+// is admitted while it raises the aggregate throughput, the step is undone
+// when it does not help, and the limit is halved when the throughput collapses.
+static int g_download_adaptive = 0;
+static int g_download_adaptive_limit = 1;
+static adaptive_action_e g_download_adaptive_action = ADAPTIVE_HOLD;
+static int g_download_adaptive_stable = 0;
+static unsigned long long g_download_adaptive_bytes = 0;
+static unsigned long long g_download_adaptive_throughput = 0;
+static struct timespec g_download_adaptive_window;
+
+static int _list_remove(url_download_h *list, url_download_h download)
+{
+	url_download_h *link = NULL;
+	for (link = list; *link != NULL; link = &(*link)->scheduler_next) {
+		if (*link == download) {
+			*link = download->scheduler_next;
+			download->scheduler_next = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// appended at the end of the list
+static void _list_add(url_download_h *list, url_download_h download)
+{
+	url_download_h *link = NULL;
+	for (link = list; *link != NULL; link = &(*link)->scheduler_next) {
+		if (*link == download)
+			return;
+	}
+	download->scheduler_next = NULL;
+	*link = download;
+}
+
+static int _host_equals(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a == b);
+	return (strcmp(a, b) == 0);
+}
+
+static int _count_active(const char *host, int any_host)
+{
+	url_download_h active = NULL;
+	int count = 0;
+	for (active = g_download_active_list; active != NULL; active = active->scheduler_next) {
+		if (any_host || _host_equals(active->host, host))
+			count++;
+	}
+	return count;
+}
+
+// the sequence number of the latest admission for the host, 0 if it is idle
+static unsigned long _host_last_admitted(const char *host)
+{
+	url_download_h active = NULL;
+	unsigned long sequence = 0;
+	for (active = g_download_active_list; active != NULL; active = active->scheduler_next) {
+		if (_host_equals(active->host, host) && active->admit_sequence > sequence)
+			sequence = active->admit_sequence;
+	}
+	return sequence;
+}
+
+static unsigned long long _cached_size(const char *url)
+{
+	int i = 0;
+	if (url == NULL)
+		return 0;
+	for (i = 0; i < URL_DOWNLOAD_SIZE_CACHE_COUNT; i++) {
+		if (g_download_size_cache[i].url && strcmp(g_download_size_cache[i].url, url) == 0)
+			return g_download_size_cache[i].size;
+	}
+	return 0;
+}
+
+// the size of the file to write, 0 if it is unknown
+static unsigned long long _known_size(url_download_h download)
+{
+	if (download->range_offset != 0 || download->range_length != 0)
+		return (download->range_length > 0 ? download->range_length : 0);
+	if (download->expected_size > 0)
+		return download->expected_size;
+	return _cached_size(download->url);
+}
+
+static void _space_pass_begin()
+{
+	int i = 0;
+	for (i = 0; i < g_download_space_cache_count; i++) {
+		free(g_download_space_cache[i].directory);
+		g_download_space_cache[i].directory = NULL;
+	}
+	g_download_space_cache_count = 0;
+}
+
+// the file system of the destination and its space available to the user
+static int _free_space(url_download_h download, dev_t *dev, unsigned long long *available)
+{
+	const char *directory = url_download_destination_directory(download);
+	struct url_download_space_entry_s *entry = NULL;
+	struct stat st;
+	struct statvfs vfs;
+	int i = 0;
+
+	for (i = 0; i < g_download_space_cache_count; i++) {
+		entry = &g_download_space_cache[i];
+		if (strcmp(entry->directory, directory) == 0) {
+			*dev = entry->dev;
+			*available = entry->available;
+			return entry->error;
+		}
+	}
+
+	entry = NULL;
+	if (g_download_space_cache_count < URL_DOWNLOAD_SPACE_CACHE_COUNT) {
+		entry = &g_download_space_cache[g_download_space_cache_count];
+		entry->directory = strdup(directory);
+		if (entry->directory != NULL)
+			g_download_space_cache_count++;
+		else
+			entry = NULL;
+	}
+
+	if (stat(directory, &st) < 0 || statvfs(directory, &vfs) < 0) {
+		if (entry != NULL)
+			entry->error = -1;
+		return -1;
+	}
+	*dev = st.st_dev;
+	*available = (unsigned long long)vfs.f_bavail * vfs.f_frsize;
+	if (entry != NULL) {
+		entry->dev = *dev;
+		entry->available = *available;
+		entry->error = 0;
+	}
+	return 0;
+}
+
+static unsigned long long _reserved_space(url_download_h download, dev_t dev)
+{
+	url_download_h active = NULL;
+	unsigned long long reserved = 0;
+
+	for (active = g_download_active_list; active != NULL; active = active->scheduler_next) {
+		if (active != download && active->reserved_dev == dev)
+			reserved += active->reserved_size;
+	}
+	return reserved;
+}
+
+// an unknown destination is reported when the file is opened
+static space_e _check_space(url_download_h download, unsigned long long size, dev_t *dev)
+{
+	unsigned long long available = 0;
+
+	if (size == 0 || _free_space(download, dev, &available) < 0)
+		return SPACE_FITS;
+	if (size > available)
+		return SPACE_NEVER;
+	if (size + _reserved_space(download, *dev) > available)
+		return SPACE_WAIT;
+	return SPACE_FITS;
+}
+
+static void _reserve(url_download_h download, unsigned long long size)
+{
+	unsigned long long available = 0;
+	dev_t dev = 0;
+
+	download->reserved_size = 0;
+	if (size > 0 && _free_space(download, &dev, &available) == 0) {
+		download->reserved_size = size;
+		download->reserved_dev = dev;
+	}
+}
+
+static int _adaptive_ceiling()
+{
+	if (g_download_max_active > 0)
+		return g_download_max_active;
+	return URL_DOWNLOAD_ADAPTIVE_MAX_LIMIT;
+}
+
+static int _max_active()
+{
+	if (g_download_adaptive)
+		return g_download_adaptive_limit;
+	return g_download_max_active;
+}
+
+static int _can_admit(url_download_h download)
+{
+	int max_active = _max_active();
+	dev_t dev = 0;
+
+	if (max_active > 0
+		&& _count_active(NULL, 1) >= max_active)
+		return 0;
+	if (g_download_max_per_host > 0
+		&& _count_active(download->host, 0) >= g_download_max_per_host)
+		return 0;
+	// the space which does not fit at all is reported when the download is picked
+	if (_check_space(download, _known_size(download), &dev) == SPACE_WAIT)
+		return 0;
+	return 1;
+}
+
+static void _admit(url_download_h download)
+{
+	_list_remove(&g_download_pending_list, download);
+	_list_add(&g_download_active_list, download);
+	download->admit_sequence = ++g_download_sequence;
+	_reserve(download, _known_size(download));
+}
+
+// pick the pending download of the host which was served least recently,
+// the oldest request first within the same host.
+static url_download_h _pick_next_fifo()
+{
+	url_download_h download = NULL;
+	url_download_h next = NULL;
+	unsigned long next_host_sequence = 0;
+	unsigned long host_sequence = 0;
+
+	for (download = g_download_pending_list; download != NULL; download = download->scheduler_next) {
+		if (!_can_admit(download))
+			continue;
+		host_sequence = _host_last_admitted(download->host);
+		if (next == NULL
+			|| host_sequence < next_host_sequence
+			|| (host_sequence == next_host_sequence
+				&& download->queue_sequence < next->queue_sequence)) {
+			next = download;
+			next_host_sequence = host_sequence;
+		}
+	}
+	return next;
+}
+
+// the remaining bytes of the download, halved for each aging period it has waited.
+// A download which waited URL_DOWNLOAD_AGING_MAX_WAIT_MS counts as 0 bytes, it
+// only waits for the older ones, so no download starves behind shorter ones.
+static unsigned long long _aged_remaining(url_download_h download, const struct timespec *now)
+{
+	unsigned long long size = download->expected_size;
+	unsigned long long remaining = 0;
+	long long waited_ms = 0;
+	long long periods = 0;
+
+	if (size == 0)
+		size = _cached_size(download->url);
+	if (size == 0)
+		size = URL_DOWNLOAD_UNKNOWN_SIZE_ESTIMATE;
+	if (size > download->received_size)
+		remaining = size - download->received_size;
+
+	waited_ms = (now->tv_sec - download->queue_time.tv_sec) * 1000LL
+		+ (now->tv_nsec - download->queue_time.tv_nsec) / 1000000LL;
+	if (waited_ms >= URL_DOWNLOAD_AGING_MAX_WAIT_MS)
+		return 0;
+	periods = waited_ms / URL_DOWNLOAD_AGING_PERIOD_MS;
+	if (periods > 0)
+		remaining >>= periods;
+	return remaining;
+}
+
+// pick the pending download with the fewest remaining bytes, the oldest request first on a tie.
+static url_download_h _pick_next_shortest()
+{
+	url_download_h download = NULL;
+	url_download_h next = NULL;
+	unsigned long long next_remaining = 0;
+	unsigned long long remaining = 0;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (download = g_download_pending_list; download != NULL; download = download->scheduler_next) {
+		if (!_can_admit(download))
+			continue;
+		remaining = _aged_remaining(download, &now);
+		if (next == NULL
+			|| remaining < next_remaining
+			|| (remaining == next_remaining
+				&& download->queue_sequence < next->queue_sequence)) {
+			next = download;
+			next_remaining = remaining;
+		}
+	}
+	return next;
+}
+
+static url_download_h _pick_next()
+{
+	int max_active = _max_active();
+
+	// nothing is admitted before a download finishes, however long the queue is
+	if (max_active > 0 && _count_active(NULL, 1) >= max_active)
+		return NULL;
+	if (g_download_policy == URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST)
+		return _pick_next_shortest();
+	return _pick_next_fifo();
+}
+
+static int _has_pending()
+{
+	return (g_download_pending_list != NULL);
+}
+
+static void _adaptive_reset()
+{
+	g_download_adaptive_action = ADAPTIVE_HOLD;
+	g_download_adaptive_stable = 0;
+	g_download_adaptive_bytes = 0;
+	g_download_adaptive_throughput = 0;
+	clock_gettime(CLOCK_MONOTONIC, &g_download_adaptive_window);
+}
+
+// evaluate the throughput of the finished sample and move the limit.
+static void _adaptive_update()
+{
+	struct timespec now;
+	long long elapsed_ms = 0;
+	unsigned long long throughput = 0;
+	unsigned long long previous = g_download_adaptive_throughput;
+	int limit = g_download_adaptive_limit;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_ms = (now.tv_sec - g_download_adaptive_window.tv_sec) * 1000LL
+		+ (now.tv_nsec - g_download_adaptive_window.tv_nsec) / 1000000LL;
+	if (elapsed_ms < URL_DOWNLOAD_ADAPTIVE_WINDOW_MS)
+		return;
+
+	throughput = g_download_adaptive_bytes * 1000 / elapsed_ms;
+	g_download_adaptive_bytes = 0;
+	g_download_adaptive_window = now;
+
+	// the sample tells nothing about the limit if the limit was not reached
+	if (!_has_pending() && _count_active(NULL, 1) < limit) {
+		g_download_adaptive_action = ADAPTIVE_HOLD;
+		return;
+	}
+
+	if (previous == 0) {
+		// the first sample probes one step up without waiting for stable samples
+		limit++;
+		g_download_adaptive_action = ADAPTIVE_INCREASE;
+		g_download_adaptive_stable = 0;
+	} else if (g_download_adaptive_action == ADAPTIVE_INCREASE
+		&& throughput * 100 < previous * (100 + URL_DOWNLOAD_ADAPTIVE_GAIN)) {
+		// one more download did not pay off
+		limit--;
+		g_download_adaptive_action = ADAPTIVE_HOLD;
+		g_download_adaptive_stable = 0;
+	} else if (throughput * 100 < previous * (100 - URL_DOWNLOAD_ADAPTIVE_LOSS)) {
+		limit = limit / 2;
+		g_download_adaptive_action = ADAPTIVE_DECREASE;
+		g_download_adaptive_stable = 0;
+	} else if (throughput * 100 >= previous * (100 + URL_DOWNLOAD_ADAPTIVE_GAIN)
+		|| ++g_download_adaptive_stable >= URL_DOWNLOAD_ADAPTIVE_PROBE_WINDOWS) {
+		limit++;
+		g_download_adaptive_action = ADAPTIVE_INCREASE;
+		g_download_adaptive_stable = 0;
+	} else {
+		g_download_adaptive_action = ADAPTIVE_HOLD;
+	}
+
+	if (limit < 1)
+		limit = 1;
+	if (limit > _adaptive_ceiling())
+		limit = _adaptive_ceiling();
+	if (limit == g_download_adaptive_limit && g_download_adaptive_action == ADAPTIVE_INCREASE)
+		g_download_adaptive_action = ADAPTIVE_HOLD;
+
+	if (limit != g_download_adaptive_limit)
+		LOGI("[%s] throughput [%llu] -> [%llu] bytes/sec, limit [%d] -> [%d]",__FUNCTION__,
+			previous, throughput, g_download_adaptive_limit, limit);
+	g_download_adaptive_limit = limit;
+	g_download_adaptive_throughput = throughput;
+}
+
+int url_download_scheduler_adaptive_enabled()
+{
+	int enabled = 0;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	enabled = g_download_adaptive;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return enabled;
+}
+
+void url_download_scheduler_report_progress(unsigned long long bytes)
+{
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	if (g_download_adaptive)
+		g_download_adaptive_bytes += bytes;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+}
+
+// returns 1 if the download can be started now, 0 if it was queued,
+// URL_DOWNLOAD_ERROR_NO_SPACE if its file does not fit in the free space.
+int url_download_scheduler_admit(url_download_h download)
+{
+	int admitted = 0;
+	dev_t dev = 0;
+
+	if (download == NULL)
+		return 0;
+
+	if (download->host)
+		free(download->host);
+	download->host = url_download_url_get_host(download->url);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	// a download is in one list at most, even if it was not released
+	_list_remove(&g_download_active_list, download);
+	_space_pass_begin();
+	if (_check_space(download, _known_size(download), &dev) == SPACE_NEVER) {
+		pthread_mutex_unlock(&g_download_scheduler_mutex);
+		LOGE("[%s] slot[%d] [%llu] bytes do not fit in the destination",__FUNCTION__,
+			download->slot_index, _known_size(download));
+		return URL_DOWNLOAD_ERROR_NO_SPACE;
+	}
+	if (!_has_pending() && _can_admit(download)) {
+		_admit(download);
+		admitted = 1;
+	} else {
+		download->queue_sequence = ++g_download_sequence;
+		clock_gettime(CLOCK_MONOTONIC, &download->queue_time);
+		_list_add(&g_download_pending_list, download);
+		download->state = URL_DOWNLOAD_STATE_QUEUED;
+		LOGI("[%s] slot[%d] queued host[%s]",__FUNCTION__, download->slot_index, download->host);
+	}
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return admitted;
+}
+
+void url_download_scheduler_release(url_download_h download)
+{
+	if (download == NULL)
+		return;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	_list_remove(&g_download_active_list, download);
+	download->reserved_size = 0;
+	if (_list_remove(&g_download_pending_list, download)
+		&& download->state == URL_DOWNLOAD_STATE_QUEUED)
+		download->state = URL_DOWNLOAD_STATE_READY;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+}
+
+void url_download_scheduler_record_size(const char *url, unsigned long long size)
+{
+	int i = 0;
+	struct url_download_size_entry_s *entry = NULL;
+
+	if (url == NULL || size == 0)
+		return;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	for (i = 0; i < URL_DOWNLOAD_SIZE_CACHE_COUNT; i++) {
+		if (g_download_size_cache[i].url && strcmp(g_download_size_cache[i].url, url) == 0) {
+			entry = &g_download_size_cache[i];
+			break;
+		}
+	}
+	if (entry == NULL) {
+		// replace the oldest entry
+		entry = &g_download_size_cache[g_download_size_cache_next];
+		g_download_size_cache_next = (g_download_size_cache_next + 1) % URL_DOWNLOAD_SIZE_CACHE_COUNT;
+		if (entry->url)
+			free(entry->url);
+		entry->url = strdup(url);
+		if (entry->url == NULL) {
+			pthread_mutex_unlock(&g_download_scheduler_mutex);
+			return;
+		}
+	}
+	entry->size = size;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+}
+
+// the size of the file is known, the download reserves it on the file system of its destination.
+// The space preallocated for the file is not reserved any more with a size of 0.
+int url_download_scheduler_reserve(url_download_h download, unsigned long long size)
+{
+	dev_t dev = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	_space_pass_begin();
+	if (_check_space(download, size, &dev) == SPACE_NEVER) {
+		download->reserved_size = 0;
+		errorcode = URL_DOWNLOAD_ERROR_NO_SPACE;
+	} else {
+		_reserve(download, size);
+	}
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		LOGE("[%s] slot[%d] [%llu] bytes do not fit in the destination",__FUNCTION__,
+			download->slot_index, size);
+	return errorcode;
+}
+
+// the handle takes over the place of the download in the lists
+void url_download_scheduler_replace(url_download_h download, url_download_h heir)
+{
+	url_download_h *link = NULL;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	for (link = &g_download_active_list; *link != NULL && *link != download; link = &(*link)->scheduler_next)
+		;
+	if (*link == NULL) {
+		for (link = &g_download_pending_list; *link != NULL && *link != download;
+			link = &(*link)->scheduler_next)
+			;
+	}
+	if (*link != NULL) {
+		*link = heir;
+		heir->scheduler_next = download->scheduler_next;
+		download->scheduler_next = NULL;
+	}
+	heir->admit_sequence = download->admit_sequence;
+	heir->reserved_size = download->reserved_size;
+	heir->reserved_dev = download->reserved_dev;
+	heir->queue_sequence = download->queue_sequence;
+	heir->queue_time = download->queue_time;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+}
+
+// returns the first download in flight, running or queued, accepted by the match function
+url_download_h url_download_scheduler_find(
+		int (*match)(url_download_h candidate, url_download_h download),
+		url_download_h download)
+{
+	url_download_h candidate = NULL;
+	url_download_h found = NULL;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	for (candidate = g_download_active_list; candidate != NULL && found == NULL; candidate = candidate->scheduler_next) {
+		if (match(candidate, download))
+			found = candidate;
+	}
+	for (candidate = g_download_pending_list; candidate != NULL && found == NULL; candidate = candidate->scheduler_next) {
+		if (match(candidate, download))
+			found = candidate;
+	}
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return found;
+}
+
+// start the pending downloads as long as the limits allow it.
+void url_download_scheduler_dispatch()
+{
+	url_download_h download = NULL;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+	int id = 0;
+	dev_t dev = 0;
+	space_e space = SPACE_FITS;
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	if (g_download_adaptive)
+		_adaptive_update();
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+
+	while (1) {
+		pthread_mutex_lock(&g_download_scheduler_mutex);
+		_space_pass_begin();
+		download = _pick_next();
+		if (download != NULL) {
+			// the free space went down while the download was waiting
+			space = _check_space(download, _known_size(download), &dev);
+			if (space == SPACE_NEVER)
+				_list_remove(&g_download_pending_list, download);
+			else
+				_admit(download);
+			download->state = URL_DOWNLOAD_STATE_READY;
+		}
+		pthread_mutex_unlock(&g_download_scheduler_mutex);
+
+		if (download == NULL)
+			break;
+
+		if (space == SPACE_NEVER) {
+			LOGE("[%s] slot[%d] [%llu] bytes do not fit in the destination",__FUNCTION__,
+				download->slot_index, _known_size(download));
+			download->state = URL_DOWNLOAD_STATE_FAILED;
+			url_download_notify_stopped(download, URL_DOWNLOAD_ERROR_NO_SPACE);
+			continue;
+		}
+
+		LOGI("[%s] slot[%d] admitted host[%s]",__FUNCTION__, download->slot_index, download->host);
+		errorcode = download->backend->start(download, &id);
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE) {
+			url_download_scheduler_release(download);
+			download->state = URL_DOWNLOAD_STATE_FAILED;
+			url_download_notify_stopped(download, errorcode);
+		}
+	}
+}
+
+int url_download_set_max_active_downloads(int count)
+{
+	if (count < 0)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	g_download_max_active = count;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+
+	url_download_scheduler_dispatch();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_max_active_downloads(int *count)
+{
+	if (count == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	*count = g_download_max_active;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_max_downloads_per_host(int count)
+{
+	if (count < 0)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	g_download_max_per_host = count;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+
+	url_download_scheduler_dispatch();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_max_downloads_per_host(int *count)
+{
+	if (count == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	*count = g_download_max_per_host;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_adaptive_concurrency(bool enable)
+{
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	if (enable && !g_download_adaptive) {
+		// start from the current parallelism
+		g_download_adaptive_limit = _count_active(NULL, 1);
+		if (g_download_adaptive_limit < 1)
+			g_download_adaptive_limit = 1;
+		if (g_download_adaptive_limit > _adaptive_ceiling())
+			g_download_adaptive_limit = _adaptive_ceiling();
+		_adaptive_reset();
+	}
+	g_download_adaptive = (enable ? 1 : 0);
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+
+	url_download_scheduler_dispatch();
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_adaptive_concurrency(bool *enable, int *count)
+{
+	if (enable == NULL || count == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	*enable = (g_download_adaptive ? true : false);
+	*count = _max_active();
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_scheduling_policy(url_download_scheduling_policy_e policy)
+{
+	if (policy != URL_DOWNLOAD_SCHEDULING_FIFO && policy != URL_DOWNLOAD_SCHEDULING_SHORTEST_FIRST)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	g_download_policy = policy;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_scheduling_policy(url_download_scheduling_policy_e *policy)
+{
+	if (policy == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	*policy = g_download_policy;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_set_expected_size(url_download_h download, unsigned long long size)
+{
+	if (download == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	download->expected_size = size;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_expected_size(url_download_h download, unsigned long long *size)
+{
+	if (download == NULL || size == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_download_scheduler_mutex);
+	*size = download->expected_size;
+	pthread_mutex_unlock(&g_download_scheduler_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The content store : the downloaded files kept under their digest, and
+// linked to the next downloads of the same content without transfer.
+//
+// <store>/objects/<algorithm>-<digest> : the files, read-only
+// <store>/etags/<sha256 of the url and the ETag> : symbolic links to the
+// objects downloaded from the url with the strong ETag
+
+static char *g_store_directory = NULL;
+static pthread_mutex_t g_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *_algorithm_name(url_download_digest_e type)
+{
+	switch (type) {
+	case URL_DOWNLOAD_DIGEST_SHA256:
+		return "sha256";
+	case URL_DOWNLOAD_DIGEST_SHA1:
+		return "sha1";
+	case URL_DOWNLOAD_DIGEST_CRC32C:
+		return "crc32c";
+	case URL_DOWNLOAD_DIGEST_XXH64:
+		return "xxh64";
+	default:
+		return NULL;
+	}
+}
+
+// returns the path of the entry of the store, NULL if the store is disabled
+static char *_store_path(const char *directory, const char *name)
+{
+	char *path = NULL;
+	size_t size = 0;
+
+	pthread_mutex_lock(&g_store_mutex);
+	if (g_store_directory != NULL) {
+		size = strlen(g_store_directory) + strlen(directory) + strlen(name) + 3;
+		path = calloc(size, sizeof(char));
+		if (path != NULL)
+			snprintf(path, size, "%s/%s/%s", g_store_directory, directory, name);
+	}
+	pthread_mutex_unlock(&g_store_mutex);
+	return path;
+}
+
+static char *_object_path(url_download_digest_e type, const char *digest)
+{
+	char name[256] = {0,};
+
+	if (_algorithm_name(type) == NULL || digest == NULL || strlen(digest) > 200
+		|| strchr(digest, '/') != NULL)
+		return NULL;
+	snprintf(name, sizeof(name), "%s-%s", _algorithm_name(type), digest);
+	return _store_path("objects", name);
+}
+
+// the name of the link of the url and the ETag
+static char *_etag_path(const char *url, const char *etag)
+{
+	struct url_download_digest_s *digest = NULL;
+	char *name = NULL;
+	char *path = NULL;
+
+	digest = url_download_digest_new(URL_DOWNLOAD_DIGEST_SHA256);
+	if (digest == NULL)
+		return NULL;
+	url_download_digest_update(digest, url, strlen(url));
+	url_download_digest_update(digest, "\n", 1);
+	url_download_digest_update(digest, etag, strlen(etag));
+	name = url_download_digest_final(digest);
+	url_download_digest_free(digest);
+	if (name == NULL)
+		return NULL;
+	path = _store_path("etags", name);
+	free(name);
+	return path;
+}
+
+int url_download_store_enabled()
+{
+	int enabled = 0;
+
+	pthread_mutex_lock(&g_store_mutex);
+	enabled = (g_store_directory != NULL);
+	pthread_mutex_unlock(&g_store_mutex);
+	return enabled;
+}
+
+// returns the path of the object of the digest, NULL if it is not in the store
+char *url_download_store_find(url_download_digest_e type, const char *digest)
+{
+	char *path = _object_path(type, digest);
+
+	if (path != NULL && access(path, R_OK) != 0) {
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+// returns the path of the object downloaded from the url with the ETag, NULL if there is none
+char *url_download_store_find_etag(const char *url, const char *etag)
+{
+	char *path = _etag_path(url, etag);
+	char *object = NULL;
+
+	// the link remains if the object was removed
+	if (path != NULL) {
+		object = realpath(path, NULL);
+		free(path);
+	}
+	return object;
+}
+
+// the object replaces the file at path, which becomes read-only like the object
+int url_download_store_link(const char *object, const char *path)
+{
+	char *temporary = NULL;
+	size_t size = strlen(path) + 32;
+
+	temporary = calloc(size, sizeof(char));
+	if (temporary == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	snprintf(temporary, size, "%s.%d.link", path, getpid());
+	if (link(object, temporary) < 0 || rename(temporary, path) < 0) {
+		// another file system
+		LOGI("[%s] link [%s] : %s",__FUNCTION__, path, strerror(errno));
+		unlink(temporary);
+		free(temporary);
+		return URL_DOWNLOAD_ERROR_IO_ERROR;
+	}
+	free(temporary);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// copies the file to the store on another file system
+static int _copy_object(int in, int out)
+{
+	long long offset = 0;
+	size_t copied = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	do {
+		errorcode = url_download_local_copy(in, out, offset, URL_DOWNLOAD_LOCAL_SLICE_SIZE, &copied);
+		offset += copied;
+	} while (errorcode == URL_DOWNLOAD_ERROR_NONE && copied > 0);
+	return errorcode;
+}
+
+// the object is a copy of the blocks of the file if the file system shares them,
+// the file itself otherwise, a copy of the file on another file system.
+static int _add_object(const char *path, const char *object)
+{
+	char *temporary = NULL;
+	size_t size = strlen(object) + 32;
+	int in = -1;
+	int out = -1;
+	int linked = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_IO_ERROR;
+
+	if (access(object, F_OK) == 0)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	temporary = calloc(size, sizeof(char));
+	if (temporary == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	snprintf(temporary, size, "%s.%d.tmp", object, getpid());
+	in = open(path, O_RDONLY | O_CLOEXEC);
+	if (in >= 0)
+		out = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0444);
+	if (out >= 0 && url_download_local_clone(in, out) == URL_DOWNLOAD_ERROR_NONE) {
+		errorcode = URL_DOWNLOAD_ERROR_NONE;
+	} else if (link(path, object) == 0 || errno == EEXIST) {
+		chmod(object, 0444);
+		linked = 1;
+		errorcode = URL_DOWNLOAD_ERROR_NONE;
+	} else if (errno == EXDEV && out >= 0) {
+		errorcode = _copy_object(in, out);
+	} else {
+		LOGE("[%s] link [%s] : %s",__FUNCTION__, object, strerror(errno));
+	}
+	if (out >= 0) {
+		if (errorcode == URL_DOWNLOAD_ERROR_NONE && !linked && rename(temporary, object) < 0)
+			errorcode = URL_DOWNLOAD_ERROR_IO_ERROR;
+		if (errorcode != URL_DOWNLOAD_ERROR_NONE || linked)
+			unlink(temporary);
+		close(out);
+	}
+	if (in >= 0)
+		close(in);
+	free(temporary);
+	return errorcode;
+}
+
+// the completed file is added to the store, with the link of its url and its ETag if it is known
+void url_download_store_add(const char *path, url_download_digest_e type, const char *digest,
+		const char *url, const char *etag)
+{
+	char *object = NULL;
+	char *link_path = NULL;
+	char *temporary = NULL;
+	char target[256] = {0,};
+	size_t size = 0;
+
+	object = _object_path(type, digest);
+	if (object == NULL)
+		return;
+	if (_add_object(path, object) != URL_DOWNLOAD_ERROR_NONE) {
+		free(object);
+		return;
+	}
+	LOGI("[%s] [%s] stored as [%s]",__FUNCTION__, path, object);
+
+	if (url != NULL && etag != NULL)
+		link_path = _etag_path(url, etag);
+	if (link_path != NULL) {
+		size = strlen(link_path) + 32;
+		temporary = calloc(size, sizeof(char));
+	}
+	if (temporary != NULL) {
+		// relative, the store may be moved
+		snprintf(target, sizeof(target), "../objects/%s", strrchr(object, '/') + 1);
+		snprintf(temporary, size, "%s.%d.tmp", link_path, getpid());
+		unlink(temporary);
+		if (symlink(target, temporary) < 0 || rename(temporary, link_path) < 0) {
+			LOGE("[%s] symlink [%s] : %s",__FUNCTION__, link_path, strerror(errno));
+			unlink(temporary);
+		}
+		free(temporary);
+	}
+	if (link_path)
+		free(link_path);
+	free(object);
+}
+
+int url_download_set_content_store(const char *directory)
+{
+	static const char *subdirectories[] = {"", "/objects", "/etags"};
+	char *directory_dup = NULL;
+	char *path = NULL;
+	size_t size = 0;
+	int i = 0;
+
+	if (directory != NULL) {
+		if (directory[0] != '/')
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, directory);
+		directory_dup = strdup(directory);
+		size = strlen(directory) + 16;
+		path = calloc(size, sizeof(char));
+		if (directory_dup == NULL || path == NULL) {
+			if (directory_dup)
+				free(directory_dup);
+			if (path)
+				free(path);
+			return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_OUT_OF_MEMORY, NULL);
+		}
+		for (i = 0; i < 3; i++) {
+			snprintf(path, size, "%s%s", directory, subdirectories[i]);
+			if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+				LOGE("[%s] mkdir [%s] : %s",__FUNCTION__, path, strerror(errno));
+				free(directory_dup);
+				free(path);
+				return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_DESTINATION, directory);
+			}
+		}
+		free(path);
+	}
+
+	pthread_mutex_lock(&g_store_mutex);
+	if (g_store_directory)
+		free(g_store_directory);
+	g_store_directory = directory_dup;
+	pthread_mutex_unlock(&g_store_mutex);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+int url_download_get_content_store(char **directory)
+{
+	char *directory_dup = NULL;
+
+	if (directory == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_INVALID_PARAMETER, NULL);
+
+	pthread_mutex_lock(&g_store_mutex);
+	if (g_store_directory != NULL)
+		directory_dup = strdup(g_store_directory);
+	pthread_mutex_unlock(&g_store_mutex);
+	if (directory_dup == NULL)
+		return url_download_error(__FUNCTION__, URL_DOWNLOAD_ERROR_NO_DATA, NULL);
+
+	*directory = directory_dup;
+	return URL_DOWNLOAD_ERROR_NONE;
+}
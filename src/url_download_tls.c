@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The TLS connections of the in-process backend, on the non-blocking
+// sockets of the engine. The operations return like recv() and send(),
+// with EAGAIN until the socket is ready for url_download_tls_events().
+//
+// The sessions given by the servers are kept per host and port, so the
+// next connections to the same host, from any download of the process,
+// resume them with an abbreviated handshake.
+
+struct url_download_tls_s {
+	SSL *ssl;
+	char *host;
+	int port;
+	short events; /* the socket events the last operation waits for */
+	int failed; /* the connection is not closed with close_notify */
+	struct timespec start;
+};
+
+// a session ticket or id of a host, until its lifetime ends
+struct url_download_tls_session_s {
+	char *host;
+	int port;
+	SSL_SESSION *session;
+	struct timespec expiry;
+};
+
+static SSL_CTX *g_tls_context = NULL;
+static BIO_METHOD *g_tls_socket = NULL;
+static pthread_once_t g_tls_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_tls_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct url_download_tls_session_s g_tls_sessions[URL_DOWNLOAD_TLS_SESSION_CACHE_COUNT] = {{0,},};
+
+static void _log_errors(const char *function, const char *host)
+{
+	char message[256];
+	unsigned long error = 0;
+
+	while ((error = ERR_get_error()) != 0) {
+		ERR_error_string_n(error, message, sizeof(message));
+		LOGE("[%s] %s : %s", function, host, message);
+	}
+}
+
+static void _session_clear(struct url_download_tls_session_s *entry)
+{
+	if (entry->session)
+		SSL_SESSION_free(entry->session);
+	if (entry->host)
+		free(entry->host);
+	memset(entry, 0x00, sizeof(struct url_download_tls_session_s));
+}
+
+static int _session_expired(struct url_download_tls_session_s *entry, const struct timespec *now)
+{
+	return (now->tv_sec > entry->expiry.tv_sec
+		|| (now->tv_sec == entry->expiry.tv_sec && now->tv_nsec >= entry->expiry.tv_nsec));
+}
+
+// the server gave a session, it replaces the one of the host or the oldest one.
+// called in the handshake, or in a read for the tickets of TLS 1.3.
+static int _session_new(SSL *ssl, SSL_SESSION *session)
+{
+	struct url_download_tls_s *tls = SSL_get_app_data(ssl);
+	struct url_download_tls_session_s *entry = NULL;
+	struct timespec now;
+	long lifetime = 0;
+	char *host = NULL;
+	int i = 0;
+
+	if (tls == NULL || !SSL_SESSION_is_resumable(session))
+		return 0;
+	host = strdup(tls->host);
+	if (host == NULL)
+		return 0;
+
+	// no longer than the server keeps it
+	lifetime = SSL_SESSION_get_timeout(session);
+	if (lifetime <= 0 || lifetime * 1000 > URL_DOWNLOAD_TLS_SESSION_LIFETIME_MS)
+		lifetime = URL_DOWNLOAD_TLS_SESSION_LIFETIME_MS / 1000;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&g_tls_mutex);
+	for (i = 0; i < URL_DOWNLOAD_TLS_SESSION_CACHE_COUNT; i++) {
+		struct url_download_tls_session_s *candidate = &g_tls_sessions[i];
+		if (candidate->session != NULL && candidate->port == tls->port
+			&& strcmp(candidate->host, tls->host) == 0) {
+			entry = candidate;
+			break;
+		}
+		if (entry == NULL || candidate->session == NULL
+			|| (entry->session != NULL && (candidate->expiry.tv_sec < entry->expiry.tv_sec)))
+			entry = candidate;
+	}
+	_session_clear(entry);
+	entry->host = host;
+	entry->port = tls->port;
+	entry->session = session;
+	entry->expiry = now;
+	entry->expiry.tv_sec += lifetime;
+	pthread_mutex_unlock(&g_tls_mutex);
+	// the cache keeps the reference
+	return 1;
+}
+
+// the session to resume with the host, with a new reference
+static SSL_SESSION *_session_get(const char *host, int port)
+{
+	SSL_SESSION *session = NULL;
+	struct timespec now;
+	int i = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&g_tls_mutex);
+	for (i = 0; i < URL_DOWNLOAD_TLS_SESSION_CACHE_COUNT; i++) {
+		struct url_download_tls_session_s *entry = &g_tls_sessions[i];
+		if (entry->session == NULL)
+			continue;
+		if (_session_expired(entry, &now)) {
+			_session_clear(entry);
+			continue;
+		}
+		// a ticket of TLS 1.3 is used again until the server sends the next one
+		if (entry->port == port && strcmp(entry->host, host) == 0) {
+			session = entry->session;
+			SSL_SESSION_up_ref(session);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_tls_mutex);
+	return session;
+}
+
+// the session failed, it is not proposed again
+static void _session_remove(const char *host, int port)
+{
+	int i = 0;
+
+	pthread_mutex_lock(&g_tls_mutex);
+	for (i = 0; i < URL_DOWNLOAD_TLS_SESSION_CACHE_COUNT; i++) {
+		struct url_download_tls_session_s *entry = &g_tls_sessions[i];
+		if (entry->session != NULL && entry->port == port && strcmp(entry->host, host) == 0)
+			_session_clear(entry);
+	}
+	pthread_mutex_unlock(&g_tls_mutex);
+}
+
+// a socket BIO sending with MSG_NOSIGNAL, a closed connection does not raise SIGPIPE in the application
+static int _socket_write(BIO *bio, const char *data, int length)
+{
+	int sockfd = (int)(intptr_t)BIO_get_data(bio);
+	ssize_t sent = send(sockfd, data, length, MSG_NOSIGNAL);
+
+	BIO_clear_retry_flags(bio);
+	if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		BIO_set_retry_write(bio);
+	return (int)sent;
+}
+
+static int _socket_read(BIO *bio, char *data, int length)
+{
+	int sockfd = (int)(intptr_t)BIO_get_data(bio);
+	ssize_t received = recv(sockfd, data, length, 0);
+
+	BIO_clear_retry_flags(bio);
+	if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		BIO_set_retry_read(bio);
+	return (int)received;
+}
+
+static long _socket_ctrl(BIO *bio, int command, long number, void *pointer)
+{
+	return (command == BIO_CTRL_FLUSH ? 1 : 0);
+}
+
+static void _tls_init()
+{
+	SSL_CTX *context = NULL;
+
+	g_tls_socket = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "url_download socket");
+	if (g_tls_socket == NULL) {
+		_log_errors(__FUNCTION__, "BIO_meth_new");
+		return;
+	}
+	BIO_meth_set_write(g_tls_socket, _socket_write);
+	BIO_meth_set_read(g_tls_socket, _socket_read);
+	BIO_meth_set_ctrl(g_tls_socket, _socket_ctrl);
+
+	context = SSL_CTX_new(TLS_client_method());
+	if (context == NULL) {
+		_log_errors(__FUNCTION__, "SSL_CTX_new");
+		return;
+	}
+	SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+	SSL_CTX_set_verify(context, SSL_VERIFY_PEER, NULL);
+	if (SSL_CTX_set_default_verify_paths(context) != 1)
+		_log_errors(__FUNCTION__, "SSL_CTX_set_default_verify_paths");
+	SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	// a body without length ends with the connection, the length of the others is checked
+	SSL_CTX_set_options(context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+	// the sessions are kept by _session_new(), not by the context
+	SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(context, _session_new);
+	g_tls_context = context;
+}
+
+struct url_download_tls_s *url_download_tls_new(int sockfd, const char *host, int port)
+{
+	struct url_download_tls_s *tls = NULL;
+	SSL_SESSION *session = NULL;
+	BIO *bio = NULL;
+	unsigned char address[16];
+	int is_address = 0;
+
+	pthread_once(&g_tls_once, _tls_init);
+	if (g_tls_context == NULL)
+		return NULL;
+
+	tls = calloc(1, sizeof(struct url_download_tls_s));
+	if (tls == NULL)
+		return NULL;
+	tls->host = strdup(host);
+	tls->port = port;
+	tls->ssl = SSL_new(g_tls_context);
+	if (tls->host == NULL || tls->ssl == NULL)
+		goto error;
+	bio = BIO_new(g_tls_socket);
+	if (bio == NULL)
+		goto error;
+	BIO_set_data(bio, (void *)(intptr_t)sockfd);
+	BIO_set_init(bio, 1);
+	SSL_set_bio(tls->ssl, bio, bio);
+	SSL_set_app_data(tls->ssl, tls);
+	SSL_set_connect_state(tls->ssl);
+
+	is_address = (inet_pton(AF_INET, host, address) == 1 || inet_pton(AF_INET6, host, address) == 1);
+	if (is_address) {
+		if (X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(tls->ssl), host) != 1)
+			goto error;
+	} else {
+		if (SSL_set_tlsext_host_name(tls->ssl, host) != 1 || SSL_set1_host(tls->ssl, host) != 1)
+			goto error;
+	}
+
+	session = _session_get(host, port);
+	if (session != NULL) {
+		SSL_set_session(tls->ssl, session);
+		SSL_SESSION_free(session);
+	}
+	tls->events = POLLOUT;
+	clock_gettime(CLOCK_MONOTONIC, &tls->start);
+	return tls;
+
+error:
+	_log_errors(__FUNCTION__, host);
+	url_download_tls_free(tls);
+	return NULL;
+}
+
+// the socket is closed by the caller
+void url_download_tls_free(struct url_download_tls_s *tls)
+{
+	if (tls == NULL)
+		return;
+	if (tls->ssl) {
+		// close_notify, without it the session would not be resumed
+		if (!tls->failed && SSL_is_init_finished(tls->ssl)) {
+			ERR_clear_error();
+			SSL_shutdown(tls->ssl);
+		}
+		SSL_free(tls->ssl);
+	}
+	if (tls->host)
+		free(tls->host);
+	free(tls);
+}
+
+// maps the result of an operation, with errno EAGAIN if it waits for the socket
+static ssize_t _result(struct url_download_tls_s *tls, int ret, const char *function)
+{
+	int error = SSL_get_error(tls->ssl, ret);
+
+	switch (error) {
+	case SSL_ERROR_WANT_READ:
+		tls->events = POLLIN;
+		errno = EAGAIN;
+		return -1;
+	case SSL_ERROR_WANT_WRITE:
+		tls->events = POLLOUT;
+		errno = EAGAIN;
+		return -1;
+	case SSL_ERROR_ZERO_RETURN:
+		return 0;
+	case SSL_ERROR_SYSCALL:
+		if (ERR_peek_error() == 0) {
+			// the connection ended without close_notify
+			tls->failed = 1;
+			if (ret == 0 || errno == 0)
+				return 0;
+			return -1;
+		}
+		break;
+	default:
+		break;
+	}
+	_log_errors(function, tls->host);
+	tls->failed = 1;
+	errno = EPROTO;
+	return -1;
+}
+
+int url_download_tls_handshake(struct url_download_tls_s *tls, int *done)
+{
+	struct timespec now;
+	long verify = X509_V_OK;
+	int resumed = 0;
+	int ret = 0;
+
+	*done = 0;
+	ERR_clear_error();
+	ret = SSL_do_handshake(tls->ssl);
+	if (ret == 1) {
+		*done = 1;
+		tls->events = 0;
+		resumed = SSL_session_reused(tls->ssl);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		LOGI("[%s] %s:%d %s, %s handshake in %lld us",__FUNCTION__, tls->host, tls->port,
+			SSL_get_version(tls->ssl), (resumed ? "resumed" : "full"),
+			(now.tv_sec - tls->start.tv_sec) * 1000000LL
+			+ (now.tv_nsec - tls->start.tv_nsec) / 1000);
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+	if (_result(tls, ret, __FUNCTION__) < 0 && errno == EAGAIN)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	verify = SSL_get_verify_result(tls->ssl);
+	if (verify != X509_V_OK)
+		LOGE("[%s] %s : certificate verification failed : %s",__FUNCTION__, tls->host,
+			X509_verify_cert_error_string(verify));
+	_session_remove(tls->host, tls->port);
+	return URL_DOWNLOAD_ERROR_SSL_FAILED;
+}
+
+// POLLIN or POLLOUT if the last operation waits for the socket, 0 otherwise
+short url_download_tls_events(struct url_download_tls_s *tls)
+{
+	return tls->events;
+}
+
+// reads the records available up to length, like recv() on the socket
+ssize_t url_download_tls_read(struct url_download_tls_s *tls, char *buffer, size_t length)
+{
+	size_t received = 0;
+	int ret = 0;
+
+	tls->events = 0;
+	while (received < length) {
+		ERR_clear_error();
+		ret = SSL_read(tls->ssl, buffer + received, length - received);
+		if (ret <= 0) {
+			if (received > 0) {
+				// the error is met again at the next read
+				if (SSL_get_error(tls->ssl, ret) == SSL_ERROR_WANT_WRITE)
+					tls->events = POLLOUT;
+				break;
+			}
+			return _result(tls, ret, __FUNCTION__);
+		}
+		received += ret;
+	}
+	return received;
+}
+
+ssize_t url_download_tls_write(struct url_download_tls_s *tls, const char *buffer, size_t length)
+{
+	int ret = 0;
+
+	tls->events = 0;
+	ERR_clear_error();
+	ret = SSL_write(tls->ssl, buffer, length);
+	if (ret > 0)
+		return ret;
+	return _result(tls, ret, __FUNCTION__);
+}
+
+// the bytes decrypted and not read, poll() does not see them
+size_t url_download_tls_pending(struct url_download_tls_s *tls)
+{
+	return SSL_pending(tls->ssl);
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+static int _default_port(const char *scheme)
+{
+	if (strcmp(scheme, "http") == 0)
+		return 80;
+	if (strcmp(scheme, "https") == 0)
+		return 443;
+	if (strcmp(scheme, "ftp") == 0)
+		return 21;
+	return 0;
+}
+
+static char *_strndup_lower(const char *str, size_t len)
+{
+	size_t i = 0;
+	char *dup = calloc(len + 1, sizeof(char));
+
+	if (dup == NULL)
+		return NULL;
+	for (i = 0; i < len; i++)
+		dup[i] = tolower((unsigned char)str[i]);
+	return dup;
+}
+
+// REF : http://tools.ietf.org/html/rfc3986#section-3
+// scheme://[userinfo@]host[:port][/path][?query][#fragment]
+int url_download_url_parse(const char *url, struct url_download_url_s *parsed)
+{
+	const char *scheme_end = NULL;
+	const char *authority = NULL;
+	const char *authority_end = NULL;
+	const char *host = NULL;
+	const char *host_end = NULL;
+	const char *port = NULL;
+	const char *at = NULL;
+	size_t path_len = 0;
+
+	if (url == NULL || parsed == NULL)
+		return URL_DOWNLOAD_ERROR_INVALID_PARAMETER;
+
+	memset(parsed, 0x00, sizeof(struct url_download_url_s));
+
+	scheme_end = strstr(url, "://");
+	if (scheme_end == NULL || scheme_end == url)
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+
+	authority = scheme_end + 3;
+	authority_end = authority + strcspn(authority, "/?#");
+
+	// skip userinfo
+	for (at = authority; at < authority_end; at++) {
+		if (*at == '@')
+			authority = at + 1;
+	}
+
+	host = authority;
+	if (*host == '[') { // IPv6 literal
+		host_end = memchr(host, ']', authority_end - host);
+		if (host_end == NULL)
+			return URL_DOWNLOAD_ERROR_INVALID_URL;
+		host++;
+		port = host_end + 1;
+	} else {
+		host_end = memchr(host, ':', authority_end - host);
+		if (host_end == NULL)
+			host_end = authority_end;
+		port = host_end;
+	}
+
+	parsed->scheme = _strndup_lower(url, scheme_end - url);
+	parsed->host = _strndup_lower(host, host_end - host);
+	if (parsed->scheme == NULL || parsed->host == NULL) {
+		url_download_url_clear(parsed);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	if (port < authority_end && *port == ':' && port + 1 < authority_end)
+		parsed->port = atoi(port + 1);
+	else
+		parsed->port = _default_port(parsed->scheme);
+
+	// the fragment is never sent to the server
+	path_len = strcspn(authority_end, "#");
+	if (path_len == 0 || authority_end[0] != '/') {
+		parsed->path = calloc(path_len + 2, sizeof(char));
+		if (parsed->path != NULL) {
+			parsed->path[0] = '/';
+			memcpy(parsed->path + 1, authority_end, path_len);
+		}
+	} else {
+		parsed->path = strndup(authority_end, path_len);
+	}
+	if (parsed->path == NULL) {
+		url_download_url_clear(parsed);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+
+	if (parsed->host[0] == '\0' && strcmp(parsed->scheme, "file") != 0) {
+		url_download_url_clear(parsed);
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	}
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+void url_download_url_clear(struct url_download_url_s *parsed)
+{
+	if (parsed == NULL)
+		return;
+	if (parsed->scheme)
+		free(parsed->scheme);
+	if (parsed->host)
+		free(parsed->host);
+	if (parsed->path)
+		free(parsed->path);
+	memset(parsed, 0x00, sizeof(struct url_download_url_s));
+}
+
+// returns the lower-cased host of the url, it must be released with free()
+char *url_download_url_get_host(const char *url)
+{
+	struct url_download_url_s parsed;
+	char *host = NULL;
+
+	if (url_download_url_parse(url, &parsed) != URL_DOWNLOAD_ERROR_NONE)
+		return NULL;
+	host = parsed.host;
+	parsed.host = NULL;
+	url_download_url_clear(&parsed);
+	return host;
+}
+
+// returns 1 for the urls copied locally : file:// and data:
+int url_download_url_is_local(const char *url)
+{
+	if (url == NULL)
+		return 0;
+	return (strncasecmp(url, "file:", 5) == 0 || strncasecmp(url, "data:", 5) == 0);
+}
+
+static int _hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// decodes the %XX escapes, out may be in, returns the length decoded
+static size_t _percent_decode(const char *in, size_t length, char *out)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	for (i = 0; i < length; i++, j++) {
+		if (in[i] == '%' && i + 2 < length
+			&& _hex_value(in[i + 1]) >= 0 && _hex_value(in[i + 2]) >= 0) {
+			out[j] = (char)(_hex_value(in[i + 1]) * 16 + _hex_value(in[i + 2]));
+			i += 2;
+		} else {
+			out[j] = in[i];
+		}
+	}
+	return j;
+}
+
+// REF : http://tools.ietf.org/html/rfc8089
+// returns the decoded path of a file:// url, it must be released with free()
+int url_download_url_get_file_path(const char *url, char **path)
+{
+	struct url_download_url_s parsed;
+	size_t length = 0;
+	int errorcode = URL_DOWNLOAD_ERROR_NONE;
+
+	errorcode = url_download_url_parse(url, &parsed);
+	if (errorcode != URL_DOWNLOAD_ERROR_NONE)
+		return errorcode;
+	if (strcmp(parsed.scheme, "file") != 0
+		|| (parsed.host[0] != '\0' && strcmp(parsed.host, "localhost") != 0)) {
+		url_download_url_clear(&parsed);
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	}
+
+	// the query is not a part of the path
+	length = strcspn(parsed.path, "?");
+	length = _percent_decode(parsed.path, length, parsed.path);
+	parsed.path[length] = '\0';
+	if (strlen(parsed.path) != length) {
+		url_download_url_clear(&parsed);
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	}
+	*path = parsed.path;
+	parsed.path = NULL;
+	url_download_url_clear(&parsed);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// REF : http://tools.ietf.org/html/rfc2397
+// data:[<mediatype>][;base64],<data>
+// the data is percent-decoded, the mime type and the data must be released with free()
+int url_download_url_parse_data(const char *url, char **mime_type, int *base64,
+		char **data, size_t *length)
+{
+	const char *comma = NULL;
+	size_t type_length = 0;
+
+	if (url == NULL || strncasecmp(url, "data:", 5) != 0)
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+	comma = strchr(url + 5, ',');
+	if (comma == NULL)
+		return URL_DOWNLOAD_ERROR_INVALID_URL;
+
+	*base64 = (comma - url >= 12 && strncasecmp(comma - 7, ";base64", 7) == 0);
+	type_length = strcspn(url + 5, ";,");
+	if (type_length == 0)
+		*mime_type = strdup("text/plain");
+	else
+		*mime_type = _strndup_lower(url + 5, type_length);
+	if (*mime_type == NULL)
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+
+	comma++;
+	*data = malloc(strlen(comma) + 1);
+	if (*data == NULL) {
+		free(*mime_type);
+		*mime_type = NULL;
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	*length = _percent_decode(comma, strlen(comma), *data);
+	(*data)[*length] = '\0';
+	LOGI("[%s] mime[%s] base64[%d] length[%lu]",__FUNCTION__, *mime_type,
+		*base64, (unsigned long)*length);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
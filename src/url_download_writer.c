@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2011 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// splice()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#ifdef URL_DOWNLOAD_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#ifndef __NR_io_uring_setup
+#undef URL_DOWNLOAD_IO_URING
+#endif
+#endif
+
+#include <dlog.h>
+#include <url_download.h>
+#include <url_download_private.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+
+#define LOG_TAG "TIZEN_N_URL_DOWNLOAD"
+
+// The data received by the in-process backend is written to the files
+// asynchronously, so a slow storage does not stall the network reads.
+// The writes are submitted to io_uring with registered buffers when the
+// kernel supports it, or to a pool of writer threads. The bytes in flight
+// are bounded by the number of buffers : the engine stops reading the
+// sockets when all of them are in use.
+//
+// Except the writer threads, the functions are called with the lock of
+// the in-process backend held.
+
+#define WRITER_BUFFER_COUNT (URL_DOWNLOAD_WRITER_MAX_IN_FLIGHT / URL_DOWNLOAD_HTTP_BUFFER_SIZE)
+
+typedef enum {
+	WRITER_SYNC, /* no thread, the writes are done at the submission */
+	WRITER_THREAD,
+	WRITER_IO_URING,
+} writer_mode_e;
+
+static writer_mode_e g_writer_mode = WRITER_SYNC;
+static struct url_download_writer_buffer_s g_writer_buffers[WRITER_BUFFER_COUNT];
+static struct url_download_writer_buffer_s *g_writer_free = NULL;
+static char *g_writer_memory = NULL;
+static int g_writer_in_flight = 0;
+
+// writer threads
+static pthread_mutex_t g_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_writer_done_cond = PTHREAD_COND_INITIALIZER;
+static struct url_download_writer_buffer_s *g_writer_queue = NULL;
+static struct url_download_writer_buffer_s *g_writer_queue_tail = NULL;
+static struct url_download_writer_buffer_s *g_writer_done = NULL;
+static int g_writer_notify[2] = {-1, -1};
+
+#ifdef URL_DOWNLOAD_IO_URING
+static int g_ring = -1;
+static int g_ring_fixed = 0; /* the buffers are registered */
+static unsigned g_ring_to_submit = 0;
+static unsigned *g_ring_sq_tail = NULL;
+static unsigned *g_ring_sq_mask = NULL;
+static unsigned *g_ring_sq_array = NULL;
+static struct io_uring_sqe *g_ring_sqes = NULL;
+static unsigned *g_ring_cq_head = NULL;
+static unsigned *g_ring_cq_tail = NULL;
+static unsigned *g_ring_cq_mask = NULL;
+static struct io_uring_cqe *g_ring_cqes = NULL;
+static struct iovec g_ring_iovecs[WRITER_BUFFER_COUNT];
+#endif
+
+static int _write_error(const char *function, int error)
+{
+	LOGE("[%s] write : %s",function, strerror(error));
+	return (error == ENOSPC ? URL_DOWNLOAD_ERROR_NO_SPACE : URL_DOWNLOAD_ERROR_IO_ERROR);
+}
+
+static void _close_pipe(struct url_download_writer_buffer_s *buffer)
+{
+	if (buffer->pipe[0] >= 0)
+		close(buffer->pipe[0]);
+	if (buffer->pipe[1] >= 0)
+		close(buffer->pipe[1]);
+	buffer->pipe[0] = -1;
+	buffer->pipe[1] = -1;
+}
+
+// the bytes left in the pipe are read to the memory of the buffer
+static int _copy_pipe(struct url_download_writer_buffer_s *buffer)
+{
+	size_t copied = buffer->written;
+	ssize_t count = 0;
+
+	while (copied < buffer->length) {
+		count = read(buffer->pipe[0], buffer->data + copied, buffer->length - copied);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return -1;
+		copied += count;
+	}
+	buffer->use_pipe = 0;
+	return 0;
+}
+
+// writes the rest of the buffer, returns the error code
+static int _write_sync(struct url_download_writer_buffer_s *buffer)
+{
+	loff_t offset = 0;
+	ssize_t count = 0;
+	int error = 0;
+
+	while (buffer->written < buffer->length) {
+		offset = buffer->offset + buffer->written;
+		if (buffer->use_pipe) {
+			count = splice(buffer->pipe[0], NULL, buffer->fd, &offset,
+				buffer->length - buffer->written, SPLICE_F_MOVE);
+			if (count < 0 && errno == EINVAL) {
+				// the file system does not support splice()
+				buffer->spliced = 0;
+				if (_copy_pipe(buffer) < 0)
+					break;
+				continue;
+			}
+		} else {
+			count = pwrite(buffer->fd, buffer->data + buffer->written,
+				buffer->length - buffer->written, offset);
+		}
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (count == 0) {
+			errno = EIO;
+			break;
+		}
+		buffer->written += count;
+	}
+	if (buffer->written >= buffer->length)
+		return URL_DOWNLOAD_ERROR_NONE;
+
+	error = errno;
+	// the bytes left in the pipe must not go to another file
+	if (buffer->use_pipe)
+		_close_pipe(buffer);
+	return _write_error(__FUNCTION__, error);
+}
+
+static void _finish(struct url_download_writer_buffer_s *buffer)
+{
+	struct url_download_writer_stream_s *stream = buffer->stream;
+
+	stream->pending--;
+	if (!buffer->spliced)
+		stream->buffered = 1;
+	if (buffer->error != URL_DOWNLOAD_ERROR_NONE && stream->error == URL_DOWNLOAD_ERROR_NONE)
+		stream->error = buffer->error;
+	url_download_writer_release(buffer);
+}
+
+static void *_run_writer(void *args)
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+
+	pthread_mutex_lock(&g_writer_mutex);
+	while (1) {
+		while (g_writer_queue == NULL)
+			pthread_cond_wait(&g_writer_cond, &g_writer_mutex);
+		buffer = g_writer_queue;
+		g_writer_queue = buffer->next;
+		if (g_writer_queue == NULL)
+			g_writer_queue_tail = NULL;
+		pthread_mutex_unlock(&g_writer_mutex);
+
+		buffer->error = _write_sync(buffer);
+
+		pthread_mutex_lock(&g_writer_mutex);
+		buffer->next = g_writer_done;
+		g_writer_done = buffer;
+		pthread_cond_broadcast(&g_writer_done_cond);
+		if (write(g_writer_notify[1], "w", 1) < 0 && errno != EAGAIN)
+			LOGE("[%s] notify : %s",__FUNCTION__, strerror(errno));
+	}
+	return 0;
+}
+
+static int _thread_setup()
+{
+	pthread_attr_t thread_attr;
+	pthread_t thread_pid;
+	int count = 0;
+
+	if (pipe(g_writer_notify) < 0) {
+		LOGE("[%s]pipe system error : %s",__FUNCTION__,strerror(errno));
+		g_writer_notify[0] = g_writer_notify[1] = -1;
+		return -1;
+	}
+	fcntl(g_writer_notify[0], F_SETFL, O_NONBLOCK);
+	fcntl(g_writer_notify[1], F_SETFL, O_NONBLOCK);
+	fcntl(g_writer_notify[0], F_SETFD, FD_CLOEXEC);
+	fcntl(g_writer_notify[1], F_SETFD, FD_CLOEXEC);
+
+	if (pthread_attr_init(&thread_attr) != 0)
+		return -1;
+	pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+	for (count = 0; count < URL_DOWNLOAD_WRITER_THREAD_COUNT; count++) {
+		if (pthread_create(&thread_pid, &thread_attr, _run_writer, NULL) != 0) {
+			LOGE("[%s][%d] pthread_create : %s",__FUNCTION__, __LINE__,strerror(errno));
+			break;
+		}
+	}
+	pthread_attr_destroy(&thread_attr);
+	return (count > 0 ? 0 : -1);
+}
+
+#ifdef URL_DOWNLOAD_IO_URING
+static int _ring_setup()
+{
+	struct io_uring_params params;
+	struct iovec iovecs[WRITER_BUFFER_COUNT];
+	size_t sq_size = 0;
+	size_t cq_size = 0;
+	char *sq = NULL;
+	char *cq = NULL;
+	int i = 0;
+
+	memset(&params, 0x00, sizeof(params));
+	g_ring = syscall(__NR_io_uring_setup, WRITER_BUFFER_COUNT, &params);
+	if (g_ring < 0) {
+		LOGI("[%s] io_uring not available : %s",__FUNCTION__, strerror(errno));
+		return -1;
+	}
+	fcntl(g_ring, F_SETFD, FD_CLOEXEC);
+
+	sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) && cq_size > sq_size)
+		sq_size = cq_size;
+#endif
+	sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		g_ring, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto error;
+	cq = sq;
+#ifdef IORING_FEAT_SINGLE_MMAP
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+#endif
+		cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			g_ring, IORING_OFF_CQ_RING);
+	if (cq == MAP_FAILED)
+		goto error;
+	g_ring_sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, g_ring, IORING_OFF_SQES);
+	if (g_ring_sqes == MAP_FAILED)
+		goto error;
+
+	g_ring_sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	g_ring_sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+	g_ring_sq_array = (unsigned *)(sq + params.sq_off.array);
+	g_ring_cq_head = (unsigned *)(cq + params.cq_off.head);
+	g_ring_cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	g_ring_cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+	g_ring_cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// the registration may fail with a low RLIMIT_MEMLOCK, the writes are not fixed then
+	for (i = 0; i < WRITER_BUFFER_COUNT; i++) {
+		iovecs[i].iov_base = g_writer_buffers[i].data;
+		iovecs[i].iov_len = URL_DOWNLOAD_HTTP_BUFFER_SIZE;
+	}
+	g_ring_fixed = (syscall(__NR_io_uring_register, g_ring, IORING_REGISTER_BUFFERS,
+		iovecs, WRITER_BUFFER_COUNT) == 0);
+	LOGI("[%s] io_uring writer, registered buffers[%d]",__FUNCTION__, g_ring_fixed);
+	return 0;
+
+error:
+	// the mappings are released with the ring
+	LOGE("[%s]mmap system error : %s",__FUNCTION__,strerror(errno));
+	close(g_ring);
+	g_ring = -1;
+	return -1;
+}
+
+static void _ring_submit(struct url_download_writer_buffer_s *buffer)
+{
+	unsigned tail = *g_ring_sq_tail;
+	unsigned index = tail & *g_ring_sq_mask;
+	struct io_uring_sqe *sqe = &g_ring_sqes[index];
+
+	memset(sqe, 0x00, sizeof(struct io_uring_sqe));
+	sqe->fd = buffer->fd;
+	sqe->off = buffer->offset;
+	sqe->len = buffer->length;
+	sqe->user_data = (unsigned long long)(uintptr_t)buffer;
+	if (buffer->use_pipe) {
+#ifdef IORING_FEAT_FAST_POLL
+		// IORING_OP_SPLICE comes with the same kernel
+		sqe->opcode = IORING_OP_SPLICE;
+		sqe->splice_fd_in = buffer->pipe[0];
+		sqe->splice_off_in = (unsigned long long)-1;
+		sqe->splice_flags = SPLICE_F_MOVE;
+#else
+		buffer->error = _write_sync(buffer);
+		_finish(buffer);
+		return;
+#endif
+	} else if (g_ring_fixed) {
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->addr = (unsigned long long)(uintptr_t)buffer->data;
+		sqe->buf_index = buffer->index;
+	} else {
+		sqe->opcode = IORING_OP_WRITEV;
+		g_ring_iovecs[buffer->index].iov_base = buffer->data;
+		g_ring_iovecs[buffer->index].iov_len = buffer->length;
+		sqe->addr = (unsigned long long)(uintptr_t)&g_ring_iovecs[buffer->index];
+		sqe->len = 1;
+	}
+	g_ring_sq_array[index] = index;
+	__atomic_store_n(g_ring_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	g_ring_to_submit++;
+}
+
+static void _ring_reap()
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	unsigned head = *g_ring_cq_head;
+	int res = 0;
+
+	while (head != __atomic_load_n(g_ring_cq_tail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe *cqe = &g_ring_cqes[head & *g_ring_cq_mask];
+		buffer = (struct url_download_writer_buffer_s *)(uintptr_t)cqe->user_data;
+		res = cqe->res;
+		head++;
+		__atomic_store_n(g_ring_cq_head, head, __ATOMIC_RELEASE);
+
+		if (res >= 0) {
+			buffer->written += res;
+			// a short write, the rest is written here
+			if (buffer->written < buffer->length)
+				buffer->error = _write_sync(buffer);
+		} else if (res == -EINVAL || res == -EAGAIN || res == -EINTR || res == -EOPNOTSUPP) {
+			// the operation is not supported for the file, or by the kernel
+			buffer->error = _write_sync(buffer);
+		} else {
+			if (buffer->use_pipe)
+				_close_pipe(buffer);
+			buffer->error = _write_error(__FUNCTION__, -res);
+		}
+		_finish(buffer);
+	}
+}
+#endif
+
+int url_download_writer_init()
+{
+	int i = 0;
+
+	g_writer_memory = malloc(WRITER_BUFFER_COUNT * URL_DOWNLOAD_HTTP_BUFFER_SIZE);
+	if (g_writer_memory == NULL) {
+		LOGE("[%s] out of memory",__FUNCTION__);
+		return URL_DOWNLOAD_ERROR_OUT_OF_MEMORY;
+	}
+	for (i = WRITER_BUFFER_COUNT - 1; i >= 0; i--) {
+		struct url_download_writer_buffer_s *buffer = &g_writer_buffers[i];
+		memset(buffer, 0x00, sizeof(struct url_download_writer_buffer_s));
+		buffer->index = i;
+		buffer->data = g_writer_memory + i * URL_DOWNLOAD_HTTP_BUFFER_SIZE;
+		buffer->pipe[0] = buffer->pipe[1] = -1;
+		buffer->next = g_writer_free;
+		g_writer_free = buffer;
+	}
+
+#ifdef URL_DOWNLOAD_IO_URING
+	if (_ring_setup() == 0) {
+		g_writer_mode = WRITER_IO_URING;
+		return URL_DOWNLOAD_ERROR_NONE;
+	}
+#endif
+	if (_thread_setup() == 0)
+		g_writer_mode = WRITER_THREAD;
+	else
+		LOGE("[%s] no writer thread, the writes are synchronous",__FUNCTION__);
+	return URL_DOWNLOAD_ERROR_NONE;
+}
+
+// readable when writes completed
+int url_download_writer_fd()
+{
+#ifdef URL_DOWNLOAD_IO_URING
+	if (g_writer_mode == WRITER_IO_URING)
+		return g_ring;
+#endif
+	if (g_writer_mode == WRITER_THREAD)
+		return g_writer_notify[0];
+	return -1;
+}
+
+// returns the number of free buffers
+int url_download_writer_available()
+{
+	return WRITER_BUFFER_COUNT - g_writer_in_flight;
+}
+
+// returns NULL if the bytes in flight are at the bound
+struct url_download_writer_buffer_s *url_download_writer_get(int use_pipe)
+{
+	struct url_download_writer_buffer_s *buffer = g_writer_free;
+
+	if (buffer == NULL)
+		return NULL;
+	if (use_pipe && buffer->pipe[0] < 0) {
+		if (pipe(buffer->pipe) < 0) {
+			LOGE("[%s]pipe system error : %s",__FUNCTION__,strerror(errno));
+			buffer->pipe[0] = buffer->pipe[1] = -1;
+			return NULL;
+		}
+		fcntl(buffer->pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl(buffer->pipe[1], F_SETFD, FD_CLOEXEC);
+	}
+	g_writer_free = buffer->next;
+	buffer->next = NULL;
+	buffer->use_pipe = use_pipe;
+	buffer->spliced = use_pipe;
+	buffer->stream = NULL;
+	g_writer_in_flight++;
+	return buffer;
+}
+
+void url_download_writer_release(struct url_download_writer_buffer_s *buffer)
+{
+	buffer->stream = NULL;
+	buffer->next = g_writer_free;
+	g_writer_free = buffer;
+	g_writer_in_flight--;
+}
+
+// the write of length bytes of the buffer at the offset of the file
+void url_download_writer_submit(struct url_download_writer_buffer_s *buffer,
+		struct url_download_writer_stream_s *stream, int fd, long long offset, size_t length)
+{
+	buffer->stream = stream;
+	buffer->fd = fd;
+	buffer->offset = offset;
+	buffer->length = length;
+	buffer->written = 0;
+	buffer->error = URL_DOWNLOAD_ERROR_NONE;
+	buffer->next = NULL;
+	stream->pending++;
+
+	switch (g_writer_mode) {
+#ifdef URL_DOWNLOAD_IO_URING
+	case WRITER_IO_URING:
+		_ring_submit(buffer);
+		break;
+#endif
+	case WRITER_THREAD:
+		pthread_mutex_lock(&g_writer_mutex);
+		if (g_writer_queue_tail)
+			g_writer_queue_tail->next = buffer;
+		else
+			g_writer_queue = buffer;
+		g_writer_queue_tail = buffer;
+		pthread_cond_signal(&g_writer_cond);
+		pthread_mutex_unlock(&g_writer_mutex);
+		break;
+	default:
+		buffer->error = _write_sync(buffer);
+		_finish(buffer);
+		break;
+	}
+}
+
+// the writes submitted since the last flush are passed to the kernel at once
+void url_download_writer_flush()
+{
+#ifdef URL_DOWNLOAD_IO_URING
+	int submitted = 0;
+
+	if (g_writer_mode != WRITER_IO_URING || g_ring_to_submit == 0)
+		return;
+	submitted = syscall(__NR_io_uring_enter, g_ring, g_ring_to_submit, 0, 0, NULL, 0);
+	if (submitted < 0) {
+		if (errno != EAGAIN && errno != EBUSY && errno != EINTR)
+			LOGE("[%s]io_uring_enter system error : %s",__FUNCTION__,strerror(errno));
+		return;
+	}
+	g_ring_to_submit -= submitted;
+#endif
+}
+
+// the completed writes are accounted to their stream
+void url_download_writer_reap()
+{
+	struct url_download_writer_buffer_s *buffer = NULL;
+	struct url_download_writer_buffer_s *next = NULL;
+	char drain[64];
+
+#ifdef URL_DOWNLOAD_IO_URING
+	if (g_writer_mode == WRITER_IO_URING) {
+		_ring_reap();
+		return;
+	}
+#endif
+	if (g_writer_mode != WRITER_THREAD)
+		return;
+
+	while (read(g_writer_notify[0], drain, sizeof(drain)) > 0)
+		;
+	pthread_mutex_lock(&g_writer_mutex);
+	buffer = g_writer_done;
+	g_writer_done = NULL;
+	pthread_mutex_unlock(&g_writer_mutex);
+	for (; buffer != NULL; buffer = next) {
+		next = buffer->next;
+		_finish(buffer);
+	}
+}
+
+// blocks until a write completes
+void url_download_writer_wait_any()
+{
+	if (g_writer_in_flight == 0 || g_writer_mode == WRITER_SYNC)
+		return;
+
+#ifdef URL_DOWNLOAD_IO_URING
+	if (g_writer_mode == WRITER_IO_URING) {
+		int submitted = 0;
+		if (*g_ring_cq_head == __atomic_load_n(g_ring_cq_tail, __ATOMIC_ACQUIRE)) {
+			// submits what the flush could not and waits for one completion
+			submitted = syscall(__NR_io_uring_enter, g_ring, g_ring_to_submit, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+			if (submitted >= 0)
+				g_ring_to_submit -= submitted;
+			else if (errno != EINTR)
+				LOGE("[%s]io_uring_enter system error : %s",__FUNCTION__,strerror(errno));
+		}
+		_ring_reap();
+		return;
+	}
+#endif
+	pthread_mutex_lock(&g_writer_mutex);
+	while (g_writer_done == NULL)
+		pthread_cond_wait(&g_writer_done_cond, &g_writer_mutex);
+	pthread_mutex_unlock(&g_writer_mutex);
+	url_download_writer_reap();
+}
+
+// blocks until the writes of the stream are done, before its file is closed or truncated
+void url_download_writer_wait(struct url_download_writer_stream_s *stream)
+{
+	while (stream->pending > 0)
+		url_download_writer_wait_any();
+}